@@ -0,0 +1,139 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Small helpers shared by the benchmark programs in this directory.
+//
+// Every benchmark prints one JSON object per line to stdout so results can be collected and
+// compared between releases:
+//
+//     {"bench":"allocator","case":"freelist_growth","free_blocks":1024,"ns_per_op":21.4}
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64* so that benchmarks don't depend on the quality or locking of rand()
+//
+static inline uint64_t
+bench_random(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// keeps the compiler from optimizing away work whose result is otherwise unused
+//
+static inline void
+bench_do_not_optimize(void* ptr)
+{
+    static void* volatile sink;
+    sink = ptr;
+    (void)sink;
+}
+
+// Latency is sampled over small batches of operations, timing every operation on its own would
+// mostly measure the clock. Percentiles are taken over the per operation mean of each batch.
+//
+#define BENCH_BATCH_SIZE 32
+
+struct bench_samples {
+    double*  ns_per_op;
+    size_t   count;
+    size_t   capacity;
+    uint64_t total_ns;
+    uint64_t op_count;
+};
+
+static inline void
+bench_samples_push(struct bench_samples* samples, double ns_per_op)
+{
+    if (samples->count == samples->capacity) {
+        samples->capacity  = (samples->capacity) ? samples->capacity * 2 : 1024;
+        samples->ns_per_op = realloc(samples->ns_per_op, sizeof(double) * samples->capacity);
+        if (!samples->ns_per_op) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+    }
+    samples->ns_per_op[samples->count++] = ns_per_op;
+}
+
+static inline void
+bench_samples_add(struct bench_samples* samples, uint64_t elapsed_ns, size_t op_count)
+{
+    if (!op_count) {
+        return;
+    }
+    bench_samples_push(samples, (double)elapsed_ns / (double)op_count);
+    samples->total_ns += elapsed_ns;
+    samples->op_count += op_count;
+}
+
+// combines samples of threads which ran at the same time, so the elapsed time is the longest
+// of the two rather than the sum
+//
+static inline void
+bench_samples_merge(struct bench_samples* into, const struct bench_samples* from)
+{
+    for (size_t i = 0; i < from->count; i++) {
+        bench_samples_push(into, from->ns_per_op[i]);
+    }
+    into->op_count += from->op_count;
+    into->total_ns = (into->total_ns > from->total_ns) ? into->total_ns : from->total_ns;
+}
+
+static inline int
+bench_compare_doubles(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// sorts the samples in place
+//
+static inline double
+bench_samples_percentile(struct bench_samples* samples, double percentile)
+{
+    if (!samples->count) {
+        return 0.0;
+    }
+    qsort(samples->ns_per_op, samples->count, sizeof *samples->ns_per_op, bench_compare_doubles);
+    size_t index = (size_t)(percentile / 100.0 * (double)samples->count);
+    if (index >= samples->count) {
+        index = samples->count - 1;
+    }
+    return samples->ns_per_op[index];
+}
+
+static inline double
+bench_samples_ops_per_sec(const struct bench_samples* samples)
+{
+    if (!samples->total_ns) {
+        return 0.0;
+    }
+    return (double)samples->op_count * 1e9 / (double)samples->total_ns;
+}
+
+static inline void
+bench_samples_free(struct bench_samples* samples)
+{
+    free(samples->ns_per_op);
+    *samples = (struct bench_samples){0};
+}
+
+#endif  // BENCH_H
@@ -0,0 +1,567 @@
+#include "../src/allocator.h"
+#include "bench.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <threads.h>
+
+// Fragments a single arena page so that its freelist holds `free_block_count` entries which
+// cannot be joined, then times malloc/free pairs against it. The time per operation should not
+// depend on the number of free blocks.
+//
+static void
+bench_freelist_growth(size_t free_block_count)
+{
+    static const size_t sizes[]        = {16, 24, 40, 64, 96, 128};
+    const size_t        sizes_count    = sizeof sizes / sizeof *sizes;
+    const size_t        live_count     = 2 * free_block_count;
+    const size_t        iterations     = 200000;
+    uint64_t            random_state   = 0x9E3779B97F4A7C15ull;
+    void**              live           = malloc(sizeof *live * live_count);
+    struct allocator    alloc;
+    ARENA_ALLOCATOR(alloc, 64 * 1024 * 1024);
+
+    if (!live) {
+        ALLOCATOR_ABORT("out of memory");
+    }
+    for (size_t i = 0; i < live_count; i++) {
+        MALLOC(&alloc, live[i], sizes[bench_random(&random_state) % sizes_count]);
+    }
+    for (size_t i = 0; i < live_count; i += 2) {
+        FREE(&alloc, live[i]);
+    }
+
+    const uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        void* ptr;
+        MALLOC(&alloc, ptr, sizes[bench_random(&random_state) % sizes_count]);
+        bench_do_not_optimize(ptr);
+        allocator_free(&alloc, ptr);
+    }
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    printf(
+        "{\"bench\":\"allocator\",\"case\":\"freelist_growth\",\"free_blocks\":%zu,"
+        "\"ns_per_op\":%.2f}\n",
+        free_block_count,
+        (double)elapsed / (double)(2 * iterations)
+    );
+
+    allocator_destroy(&alloc);
+    free(live);
+}
+
+// Spreads live allocations over `page_count` small arena pages then times freeing and
+// replacing random allocations. Finding the owning page should not depend on the page count.
+//
+static void
+bench_free_across_pages(size_t page_count)
+{
+    const size_t     page_size      = 4096;
+    const size_t     per_page       = page_size / (64 + sizeof(struct allocation)) - 1;
+    const size_t     live_count     = page_count * per_page;
+    const size_t     iterations     = 200000;
+    uint64_t         random_state   = 0x9E3779B97F4A7C15ull;
+    void**           live           = malloc(sizeof *live * live_count);
+    struct allocator alloc;
+    ARENA_ALLOCATOR(alloc, page_size);
+
+    if (!live) {
+        ALLOCATOR_ABORT("out of memory");
+    }
+    for (size_t i = 0; i < live_count; i++) {
+        MALLOC(&alloc, live[i], 64);
+    }
+
+    const uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        const size_t index = bench_random(&random_state) % live_count;
+        allocator_free(&alloc, live[index]);
+        MALLOC(&alloc, live[index], 64);
+    }
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    printf(
+        "{\"bench\":\"allocator\",\"case\":\"free_across_pages\",\"pages\":%zu,"
+        "\"ns_per_op\":%.2f}\n",
+        alloc.arena.page_count,
+        (double)elapsed / (double)(2 * iterations)
+    );
+
+    allocator_destroy(&alloc);
+    free(live);
+}
+
+// Simulates per-request scratch memory: every request makes `allocation_count` small
+// allocations which are all released together when the request ends.
+//
+static void
+bench_request_cycle(const char* strategy, size_t allocation_count)
+{
+    static const size_t sizes[]      = {16, 24, 40, 64, 96, 128};
+    const size_t        sizes_count  = sizeof sizes / sizeof *sizes;
+    const size_t        page_size    = 64 * 1024;
+    const size_t        requests     = 2000;
+    uint64_t            random_state = 0x9E3779B97F4A7C15ull;
+    const bool          use_scratch  = strcmp(strategy, "scratch_reset") == 0;
+    struct allocator    alloc;
+    if (use_scratch) {
+        SCRATCH_ALLOCATOR(alloc, page_size);
+    }
+    else {
+        ARENA_ALLOCATOR(alloc, page_size);
+    }
+
+    const uint64_t start = bench_now_ns();
+    for (size_t r = 0; r < requests; r++) {
+        for (size_t i = 0; i < allocation_count; i++) {
+            void* ptr;
+            MALLOC(&alloc, ptr, sizes[bench_random(&random_state) % sizes_count]);
+            bench_do_not_optimize(ptr);
+        }
+        if (use_scratch) {
+            allocator_reset(&alloc);
+        }
+        else {
+            allocator_destroy(&alloc);
+            ARENA_ALLOCATOR(alloc, page_size);
+        }
+    }
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    printf(
+        "{\"bench\":\"allocator\",\"case\":\"request_cycle\",\"strategy\":\"%s\","
+        "\"allocations\":%zu,\"ns_per_op\":%.2f}\n",
+        strategy,
+        allocation_count,
+        (double)elapsed / (double)(requests * allocation_count)
+    );
+
+    allocator_destroy(&alloc);
+}
+
+// Frees and replaces random fixed size nodes, as a list or tree would.
+//
+static void
+bench_fixed_size_nodes(const char* strategy)
+{
+    const size_t     node_size    = 48;
+    const size_t     live_count   = 4096;
+    const size_t     iterations   = 200000;
+    uint64_t         random_state = 0x9E3779B97F4A7C15ull;
+    void**           live         = malloc(sizeof *live * live_count);
+    struct allocator alloc;
+    if (strcmp(strategy, "pool") == 0) {
+        POOL_ALLOCATOR(alloc, node_size, 64 * 1024);
+    }
+    else {
+        ARENA_ALLOCATOR(alloc, 64 * 1024);
+    }
+
+    if (!live) {
+        ALLOCATOR_ABORT("out of memory");
+    }
+    for (size_t i = 0; i < live_count; i++) {
+        MALLOC(&alloc, live[i], node_size);
+    }
+
+    const uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        const size_t index = bench_random(&random_state) % live_count;
+        allocator_free(&alloc, live[index]);
+        MALLOC(&alloc, live[index], node_size);
+    }
+    const uint64_t elapsed = bench_now_ns() - start;
+
+    printf(
+        "{\"bench\":\"allocator\",\"case\":\"fixed_size_nodes\",\"strategy\":\"%s\","
+        "\"ns_per_op\":%.2f}\n",
+        strategy,
+        (double)elapsed / (double)(2 * iterations)
+    );
+
+    allocator_destroy(&alloc);
+    free(live);
+}
+
+// The pattern suite runs the same malloc/free/realloc patterns against every allocator type
+// and against the system allocator called directly.
+//
+struct bench_target {
+    const char*      name;
+    bool             system;  // call malloc/free/realloc directly
+    bool             thread_safe;
+    struct allocator allocator;
+    struct allocator fallback;  // catches what a bounded allocator can't take
+    void*            memory;    // backing memory for the static arena
+};
+
+static const char* bench_target_names[] = {
+    "system_malloc",
+    "default",
+    "default_plus",
+    "static_arena",
+    "arena",
+    "concurrent_arena",
+    "scratch",
+    "pool",
+};
+
+#define BENCH_PATTERN_MAX_SIZE 256
+#define BENCH_STATIC_ARENA_SIZE (64 * 1024 * 1024)
+
+static void
+bench_target_init(struct bench_target* target, const char* name)
+{
+    *target = (struct bench_target){.name = name};
+
+    if (strcmp(name, "system_malloc") == 0) {
+        target->system      = true;
+        target->thread_safe = true;
+    }
+    else if (strcmp(name, "default") == 0) {
+        target->thread_safe = true;
+    }
+    else if (strcmp(name, "default_plus") == 0) {
+        DEFAULT_PLUS_ALLOCATOR(target->allocator);
+    }
+    else if (strcmp(name, "static_arena") == 0) {
+        target->memory = malloc(BENCH_STATIC_ARENA_SIZE);
+        if (!target->memory) {
+            ALLOCATOR_ABORT("out of memory");
+        }
+        target->allocator = (struct allocator){
+            .type        = ALLOCATOR_STATIC_ARENA,
+            .static_page = arena_page_create_from_memory(
+                target->memory, BENCH_STATIC_ARENA_SIZE, false
+            ),
+        };
+    }
+    else if (strcmp(name, "arena") == 0) {
+        ARENA_ALLOCATOR(target->allocator, 1024 * 1024);
+    }
+    else if (strcmp(name, "concurrent_arena") == 0) {
+        CONCURRENT_ARENA_ALLOCATOR(target->allocator, 1024 * 1024);
+        target->thread_safe = true;
+    }
+    else if (strcmp(name, "scratch") == 0) {
+        SCRATCH_ALLOCATOR(target->allocator, 1024 * 1024);
+    }
+    else if (strcmp(name, "pool") == 0) {
+        POOL_ALLOCATOR(target->allocator, BENCH_PATTERN_MAX_SIZE, 64 * 1024);
+    }
+    target->allocator.fallback = &target->fallback;
+}
+
+static struct allocator*
+bench_target_allocator(struct bench_target* target)
+{
+    return (strcmp(target->name, "default") == 0) ? NULL : &target->allocator;
+}
+
+static void
+bench_target_destroy(struct bench_target* target)
+{
+    if (!target->system && bench_target_allocator(target)) {
+        target->allocator.fallback = NULL;
+        allocator_destroy(&target->allocator);
+    }
+    free(target->memory);
+}
+
+static inline void*
+bench_target_malloc(struct bench_target* target, size_t size)
+{
+    void* ptr = (target->system) ? malloc(size)
+                                 : allocator_malloc(bench_target_allocator(target), size);
+    if (!ptr) {
+        ALLOCATOR_ABORT("out of memory");
+    }
+    return ptr;
+}
+
+static inline void*
+bench_target_realloc(struct bench_target* target, void* ptr, size_t size)
+{
+    ptr = (target->system) ? realloc(ptr, size)
+                           : allocator_realloc(bench_target_allocator(target), ptr, size);
+    if (!ptr) {
+        ALLOCATOR_ABORT("out of memory");
+    }
+    return ptr;
+}
+
+static inline void
+bench_target_free(struct bench_target* target, void* ptr)
+{
+    if (target->system) {
+        free(ptr);
+    }
+    else {
+        allocator_free(bench_target_allocator(target), ptr);
+    }
+}
+
+static size_t
+bench_pattern_size(uint64_t* random_state)
+{
+    static const size_t sizes[] = {16, 24, 32, 48, 64, 96, 128, BENCH_PATTERN_MAX_SIZE};
+    return sizes[bench_random(random_state) % (sizeof sizes / sizeof *sizes)];
+}
+
+#define BENCH_PATTERN_LIVE_COUNT 1024
+#define BENCH_PATTERN_ROUNDS 100
+
+// allocates a batch of objects and frees them newest first (LIFO) or oldest first (FIFO)
+//
+static void
+bench_pattern_stack_or_queue(struct bench_target* target, bool lifo, struct bench_samples* samples)
+{
+    void*    ptrs[BENCH_PATTERN_LIVE_COUNT];
+    uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+    for (size_t r = 0; r < BENCH_PATTERN_ROUNDS; r++) {
+        for (size_t i = 0; i < BENCH_PATTERN_LIVE_COUNT; i += BENCH_BATCH_SIZE) {
+            size_t sizes[BENCH_BATCH_SIZE];
+            for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+                sizes[j] = bench_pattern_size(&random_state);
+            }
+            const uint64_t start = bench_now_ns();
+            for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+                ptrs[i + j] = bench_target_malloc(target, sizes[j]);
+            }
+            bench_samples_add(samples, bench_now_ns() - start, BENCH_BATCH_SIZE);
+        }
+        for (size_t i = 0; i < BENCH_PATTERN_LIVE_COUNT; i += BENCH_BATCH_SIZE) {
+            const uint64_t start = bench_now_ns();
+            for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+                const size_t index = (lifo) ? BENCH_PATTERN_LIVE_COUNT - 1 - (i + j) : i + j;
+                bench_target_free(target, ptrs[index]);
+            }
+            bench_samples_add(samples, bench_now_ns() - start, BENCH_BATCH_SIZE);
+        }
+    }
+}
+
+static void
+bench_pattern_lifo(struct bench_target* target, struct bench_samples* samples)
+{
+    bench_pattern_stack_or_queue(target, true, samples);
+}
+
+static void
+bench_pattern_fifo(struct bench_target* target, struct bench_samples* samples)
+{
+    bench_pattern_stack_or_queue(target, false, samples);
+}
+
+// keeps a fixed number of objects alive and replaces random ones (each counts as two ops)
+//
+static void
+bench_pattern_random(struct bench_target* target, struct bench_samples* samples)
+{
+    void*    ptrs[BENCH_PATTERN_LIVE_COUNT];
+    uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+    for (size_t i = 0; i < BENCH_PATTERN_LIVE_COUNT; i++) {
+        ptrs[i] = bench_target_malloc(target, bench_pattern_size(&random_state));
+    }
+    const size_t batch_count = BENCH_PATTERN_ROUNDS * BENCH_PATTERN_LIVE_COUNT / BENCH_BATCH_SIZE;
+    for (size_t b = 0; b < batch_count; b++) {
+        size_t indices[BENCH_BATCH_SIZE];
+        size_t sizes[BENCH_BATCH_SIZE];
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            indices[j] = bench_random(&random_state) % BENCH_PATTERN_LIVE_COUNT;
+            sizes[j]   = bench_pattern_size(&random_state);
+        }
+        const uint64_t start = bench_now_ns();
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            bench_target_free(target, ptrs[indices[j]]);
+            ptrs[indices[j]] = bench_target_malloc(target, sizes[j]);
+        }
+        bench_samples_add(samples, bench_now_ns() - start, 2 * BENCH_BATCH_SIZE);
+    }
+    for (size_t i = 0; i < BENCH_PATTERN_LIVE_COUNT; i++) {
+        bench_target_free(target, ptrs[i]);
+    }
+}
+
+// grows a set of buffers side by side, by half their size each step, like dynamic arrays
+//
+static void
+bench_pattern_realloc_growth(struct bench_target* target, struct bench_samples* samples)
+{
+    void*        ptrs[BENCH_BATCH_SIZE];
+    const size_t max_size = 64 * 1024;
+
+    for (size_t r = 0; r < BENCH_PATTERN_ROUNDS / 4; r++) {
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            ptrs[j] = bench_target_malloc(target, 16);
+        }
+        for (size_t size = 24; size <= max_size; size += size / 2) {
+            const uint64_t start = bench_now_ns();
+            for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+                ptrs[j] = bench_target_realloc(target, ptrs[j], size);
+            }
+            bench_samples_add(samples, bench_now_ns() - start, BENCH_BATCH_SIZE);
+        }
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            bench_target_free(target, ptrs[j]);
+        }
+    }
+}
+
+// One thread allocates and another frees, passing objects through a single producer single
+// consumer ring. Only time spent in the allocator is sampled, not time spent waiting on the
+// ring, the reported throughput uses the wall time of the whole exchange.
+//
+#define BENCH_RING_CAPACITY 1024
+#define BENCH_PRODUCER_CONSUMER_OPS (BENCH_PATTERN_ROUNDS * BENCH_PATTERN_LIVE_COUNT)
+
+struct bench_ring {
+    struct bench_target* target;
+    _Atomic(size_t)      head;
+    _Atomic(size_t)      tail;
+    void*                slots[BENCH_RING_CAPACITY];
+    struct bench_samples consumer_samples;
+};
+
+static int
+bench_consumer(void* arg)
+{
+    struct bench_ring* ring = arg;
+    void*              batch[BENCH_BATCH_SIZE];
+
+    for (size_t consumed = 0; consumed < BENCH_PRODUCER_CONSUMER_OPS;
+         consumed += BENCH_BATCH_SIZE) {
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            while (atomic_load_explicit(&ring->head, memory_order_acquire) == tail) {
+                thrd_yield();
+            }
+            batch[j] = ring->slots[tail % BENCH_RING_CAPACITY];
+            atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+        }
+        const uint64_t start = bench_now_ns();
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            bench_target_free(ring->target, batch[j]);
+        }
+        bench_samples_add(&ring->consumer_samples, bench_now_ns() - start, BENCH_BATCH_SIZE);
+    }
+    return 0;
+}
+
+static void
+bench_pattern_producer_consumer(struct bench_target* target, struct bench_samples* samples)
+{
+    static struct bench_ring ring;
+    ring = (struct bench_ring){.target = target};
+
+    uint64_t       random_state = 0x9E3779B97F4A7C15ull;
+    const uint64_t wall_start   = bench_now_ns();
+    thrd_t         consumer;
+    if (thrd_create(&consumer, bench_consumer, &ring) != thrd_success) {
+        ALLOCATOR_ABORT("failed to start consumer thread");
+    }
+
+    for (size_t produced = 0; produced < BENCH_PRODUCER_CONSUMER_OPS;
+         produced += BENCH_BATCH_SIZE) {
+        void*  batch[BENCH_BATCH_SIZE];
+        size_t sizes[BENCH_BATCH_SIZE];
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            sizes[j] = bench_pattern_size(&random_state);
+        }
+        const uint64_t start = bench_now_ns();
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            batch[j] = bench_target_malloc(target, sizes[j]);
+        }
+        bench_samples_add(samples, bench_now_ns() - start, BENCH_BATCH_SIZE);
+
+        for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) {
+            size_t head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+            while (head - atomic_load_explicit(&ring.tail, memory_order_acquire) ==
+                   BENCH_RING_CAPACITY) {
+                thrd_yield();
+            }
+            ring.slots[head % BENCH_RING_CAPACITY] = batch[j];
+            atomic_store_explicit(&ring.head, head + 1, memory_order_release);
+        }
+    }
+
+    thrd_join(consumer, NULL);
+    bench_samples_merge(samples, &ring.consumer_samples);
+    samples->total_ns = bench_now_ns() - wall_start;
+    bench_samples_free(&ring.consumer_samples);
+}
+
+struct bench_pattern {
+    const char* name;
+    bool        threaded;
+    void (*run)(struct bench_target*, struct bench_samples*);
+};
+
+static const struct bench_pattern bench_patterns[] = {
+    {"lifo", false, bench_pattern_lifo},
+    {"fifo", false, bench_pattern_fifo},
+    {"random", false, bench_pattern_random},
+    {"realloc_growth", false, bench_pattern_realloc_growth},
+    {"producer_consumer", true, bench_pattern_producer_consumer},
+};
+
+static void
+bench_pattern_suite(void)
+{
+    const size_t pattern_count = sizeof bench_patterns / sizeof *bench_patterns;
+    const size_t target_count  = sizeof bench_target_names / sizeof *bench_target_names;
+
+    for (size_t p = 0; p < pattern_count; p++) {
+        for (size_t t = 0; t < target_count; t++) {
+            struct bench_target target;
+            bench_target_init(&target, bench_target_names[t]);
+            if (bench_patterns[p].threaded && !target.thread_safe) {
+                bench_target_destroy(&target);
+                continue;
+            }
+
+            struct bench_samples samples = {0};
+            bench_patterns[p].run(&target, &samples);
+
+            const double p50 = bench_samples_percentile(&samples, 50.0);
+            const double p99 = bench_samples_percentile(&samples, 99.0);
+            printf(
+                "{\"bench\":\"allocator\",\"case\":\"pattern\",\"pattern\":\"%s\","
+                "\"target\":\"%s\",\"ops_per_sec\":%.0f,\"p50_ns\":%.2f,\"p99_ns\":%.2f}\n",
+                bench_patterns[p].name,
+                target.name,
+                bench_samples_ops_per_sec(&samples),
+                p50,
+                p99
+            );
+
+            bench_samples_free(&samples);
+            bench_target_destroy(&target);
+        }
+    }
+}
+
+int
+main(void)
+{
+    const size_t free_block_counts[] = {256, 1024, 4096, 16384, 65536};
+    for (size_t i = 0; i < sizeof free_block_counts / sizeof *free_block_counts; i++) {
+        bench_freelist_growth(free_block_counts[i]);
+    }
+    const size_t page_counts[] = {1, 16, 128, 1024};
+    for (size_t i = 0; i < sizeof page_counts / sizeof *page_counts; i++) {
+        bench_free_across_pages(page_counts[i]);
+    }
+    const size_t request_sizes[] = {100, 10000};
+    for (size_t i = 0; i < sizeof request_sizes / sizeof *request_sizes; i++) {
+        bench_request_cycle("arena_destroy", request_sizes[i]);
+        bench_request_cycle("scratch_reset", request_sizes[i]);
+    }
+    bench_fixed_size_nodes("arena");
+    bench_fixed_size_nodes("pool");
+    bench_pattern_suite();
+    return 0;
+}
@@ -0,0 +1,168 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include "../src/filesystem.h"
+#include "bench.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_FILE_SIZE (64 * 1024 * 1024)
+#define BENCH_REPETITIONS 5
+
+// Sums the content 8 bytes at a time so every strategy touches every byte it was given
+//
+static uint64_t
+bench_checksum(const void* data, size_t size)
+{
+    const unsigned char* bytes = data;
+    uint64_t             sum   = 0;
+    size_t               i     = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof word);
+        sum += word;
+    }
+    for (; i < size; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+static uint64_t
+bench_read_whole(const struct fs_path* path)
+{
+    struct fs_content content = fs_path_read_binary(path, NULL, NULL);
+    const uint64_t    sum     = bench_checksum(content.data, content.size);
+    free(content.data);
+    return sum;
+}
+
+static uint64_t
+bench_read_map(const struct fs_path* path)
+{
+    struct fs_mapping mapping = fs_path_map(path, FS_MAP_SEQUENTIAL, NULL);
+    const uint64_t    sum     = bench_checksum(mapping.data, mapping.size);
+    fs_unmap(&mapping);
+    return sum;
+}
+
+static uint64_t
+bench_read_stream(const struct fs_path* path)
+{
+    struct fs_stream   stream = fs_path_stream(path, NULL, 0, 0, NULL, NULL);
+    struct string_view chunk;
+    uint64_t           sum = 0;
+    while (fs_stream_next(&stream, &chunk, NULL)) {
+        sum += bench_checksum(chunk.data, chunk.length);
+    }
+    fs_stream_close(&stream);
+    return sum;
+}
+
+// Asks the kernel to drop the file from the page cache, the file was written with
+// FS_WRITE_SYNC so none of its pages are dirty. Returns false where that isn't possible.
+//
+static bool
+bench_drop_page_cache(const struct fs_path* path)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    (void)path;
+    return false;
+#else
+    const int fd = open(path->buffer, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#endif
+}
+
+static void
+bench_read_strategy(
+    const char* name, uint64_t (*read)(const struct fs_path*), const struct fs_path* path, bool cold
+)
+{
+    uint64_t best_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        if (cold) {
+            bench_drop_page_cache(path);
+        }
+        else {
+            bench_do_not_optimize((void*)(uintptr_t)read(path));
+        }
+
+        const uint64_t start = bench_now_ns();
+        uint64_t       sum   = read(path);
+        const uint64_t ns    = bench_now_ns() - start;
+        bench_do_not_optimize(&sum);
+        if (ns < best_ns) best_ns = ns;
+    }
+
+    printf(
+        "{\"bench\":\"filesystem\",\"case\":\"read_%s\",\"cache\":\"%s\",\"bytes\":%d,"
+        "\"ms\":%.3f,\"mb_per_sec\":%.1f}\n",
+        name,
+        (cold) ? "cold" : "hot",
+        BENCH_FILE_SIZE,
+        (double)best_ns / 1e6,
+        (double)BENCH_FILE_SIZE / (1024.0 * 1024.0) / ((double)best_ns / 1e9)
+    );
+}
+
+int
+main(void)
+{
+    struct fs_path directory = fs_path_resolve("build/bench_filesystem_data", NULL);
+    if (fs_path_exists(&directory)) {
+        fs_path_rmdir(&directory, true, NULL);
+    }
+    fs_path_mkdir(&directory, true, NULL);
+    struct fs_path file = fs_path_join(&directory, "data", NULL);
+
+    unsigned char* data         = malloc(BENCH_FILE_SIZE);
+    uint64_t       random_state = 0x9E3779B97F4A7C15ull;
+    if (!data) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_FILE_SIZE; i += sizeof(uint64_t)) {
+        const uint64_t value = bench_random(&random_state);
+        memcpy(data + i, &value, sizeof value);
+    }
+    const struct fs_iovec iov = {.data = data, .size = BENCH_FILE_SIZE};
+    fs_path_writev(&file, &iov, 1, FS_WRITE_SYNC, NULL);
+    free(data);
+
+    static const struct {
+        const char* name;
+        uint64_t (*read)(const struct fs_path*);
+    } strategies[] = {
+        {"whole", bench_read_whole},
+        {"map", bench_read_map},
+        {"stream", bench_read_stream},
+    };
+    const size_t strategy_count = sizeof strategies / sizeof *strategies;
+
+    for (size_t i = 0; i < strategy_count; i++) {
+        bench_read_strategy(strategies[i].name, strategies[i].read, &file, false);
+    }
+    if (bench_drop_page_cache(&file)) {
+        for (size_t i = 0; i < strategy_count; i++) {
+            bench_read_strategy(strategies[i].name, strategies[i].read, &file, true);
+        }
+    }
+    else {
+        fprintf(stderr, "skipping cold page cache cases, the cache can't be dropped here\n");
+    }
+
+    fs_path_rmdir(&directory, true, NULL);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "../src/pipeline.h"
+#include "bench.h"
+
+#include <string.h>
+
+#define BENCH_LARGE_FILE_COUNT 256
+#define BENCH_LARGE_FILE_SIZE (512 * 1024)
+#define BENCH_SMALL_FILE_COUNT 4096
+#define BENCH_SMALL_FILE_SIZE (4 * 1024)
+#define BENCH_REPETITIONS 5
+
+struct bench_totals {
+    uint64_t lines;
+    uint64_t line_bytes;
+    char     padding[48];  // a cache line per worker
+};
+
+static void
+bench_count_lines(const struct pipeline_batch* batch, void* user_data, struct pipeline_error* error)
+{
+    (void)error;
+    struct bench_totals* totals = (struct bench_totals*)user_data + batch->worker;
+    for (size_t i = 0; i < batch->line_count; i++) {
+        totals->line_bytes += batch->lines[i].length;
+    }
+    totals->lines += batch->line_count;
+}
+
+// Log shaped text, lines of 16 to 144 bytes
+//
+static void
+bench_write_file(const struct fs_path* path, size_t size, char* buffer, uint64_t* state)
+{
+    size_t column = 0;
+    size_t width  = 16 + bench_random(state) % 128;
+    for (size_t i = 0; i < size; i++) {
+        if (++column == width) {
+            buffer[i] = '\n';
+            column    = 0;
+            width     = 16 + bench_random(state) % 128;
+        }
+        else {
+            buffer[i] = "abcdefghijklmnopqrstuvwxyz :=0123456789"[bench_random(state) % 39];
+        }
+    }
+    fs_write_file(path->buffer, buffer, size, NULL);
+}
+
+static void
+bench_report(const char* name, size_t threads, const struct bench_totals* totals, uint64_t ns)
+{
+    const uint64_t bytes = (uint64_t)BENCH_LARGE_FILE_COUNT * BENCH_LARGE_FILE_SIZE +
+                           (uint64_t)BENCH_SMALL_FILE_COUNT * BENCH_SMALL_FILE_SIZE;
+    printf(
+        "{\"bench\":\"pipeline\",\"case\":\"%s\",\"threads\":%zu,\"files\":%d,\"bytes\":%llu,"
+        "\"lines\":%llu,\"ms\":%.3f,\"gb_per_sec\":%.3f,\"lines_per_sec\":%.0f}\n",
+        name,
+        threads,
+        BENCH_LARGE_FILE_COUNT + BENCH_SMALL_FILE_COUNT,
+        (unsigned long long)bytes,
+        (unsigned long long)totals->lines,
+        (double)ns / 1e6,
+        (double)bytes / 1e9 / ((double)ns / 1e9),
+        (double)totals->lines / ((double)ns / 1e9)
+    );
+}
+
+// What processing a directory of text took before the pipeline, one thread listing the
+// directory, reading each file whole and chopping it into lines.
+//
+static void
+bench_baseline(const struct fs_path* directory)
+{
+    struct bench_totals best    = {0};
+    uint64_t            best_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        struct bench_totals totals = {0};
+        const uint64_t      start  = bench_now_ns();
+
+        FilesystemDirectoryIterator iterator = fs_iterdir(directory, NULL, NULL);
+        struct fs_path              path;
+        while (fs_iterdir_next(iterator, &path, NULL)) {
+            struct fs_content  content = fs_read_file_text(path.buffer, NULL, NULL);
+            struct string_view view    = {.length = content.size, .data = content.data};
+            while (view.length) {
+                struct string_view line = sv_lchop_by_delim(&view, '\n');
+                if (!line.data) {
+                    line = view;
+                    view = (struct string_view){0};
+                }
+                totals.line_bytes += line.length;
+                totals.lines++;
+            }
+            free(content.data);
+        }
+        fs_iterdir_free(iterator);
+
+        const uint64_t ns = bench_now_ns() - start;
+        if (ns < best_ns) {
+            best_ns = ns;
+            best    = totals;
+        }
+    }
+    bench_report("iterdir_read_lchop", 1, &best, best_ns);
+}
+
+static void
+bench_pipeline(const struct fs_path* directory, size_t thread_count)
+{
+    struct bench_totals best    = {0};
+    uint64_t            best_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        struct bench_totals workers[PIPELINE_DEFAULT_THREAD_COUNT] = {0};
+        const struct pipeline_options options = {.thread_count = thread_count};
+
+        const uint64_t start = bench_now_ns();
+        pipeline_run(directory, bench_count_lines, workers, &options, NULL, NULL);
+        const uint64_t ns = bench_now_ns() - start;
+
+        struct bench_totals totals = {0};
+        for (size_t j = 0; j < thread_count; j++) {
+            totals.lines += workers[j].lines;
+            totals.line_bytes += workers[j].line_bytes;
+        }
+        bench_do_not_optimize(&totals);
+        if (ns < best_ns) {
+            best_ns = ns;
+            best    = totals;
+        }
+    }
+    bench_report("pipeline", thread_count, &best, best_ns);
+}
+
+int
+main(void)
+{
+    struct fs_path directory = fs_path_resolve("build/bench_pipeline_data", NULL);
+    if (fs_path_exists(&directory)) {
+        fs_path_rmdir(&directory, true, NULL);
+    }
+    fs_path_mkdir(&directory, true, NULL);
+
+    char* buffer = malloc(BENCH_LARGE_FILE_SIZE);
+    if (!buffer) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < BENCH_LARGE_FILE_COUNT + BENCH_SMALL_FILE_COUNT; i++) {
+        char name[32];
+        snprintf(name, sizeof name, "%05zu.log", i);
+        struct fs_path path = fs_path_join(&directory, name, NULL);
+        const size_t   size =
+            (i < BENCH_LARGE_FILE_COUNT) ? BENCH_LARGE_FILE_SIZE : BENCH_SMALL_FILE_SIZE;
+        bench_write_file(&path, size, buffer, &state);
+    }
+    free(buffer);
+
+    // the first round of each case warms the page cache, best of the rest is reported
+    //
+    bench_baseline(&directory);
+    bench_pipeline(&directory, 1);
+    bench_pipeline(&directory, PIPELINE_DEFAULT_THREAD_COUNT);
+
+    fs_path_rmdir(&directory, true, NULL);
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include "../src/string_view.h"
+#include "bench.h"
+
+#include <inttypes.h>
+
+// make bench builds this twice, the second time with SV_NO_SIMD to compare against the scalar
+// kernels
+//
+#ifdef SV_NO_SIMD
+#define BENCH_KERNELS "scalar"
+#else
+#define BENCH_KERNELS "simd"
+#endif
+
+#define BENCH_BUFFER_SIZE (16 * 1024 * 1024)
+#define BENCH_REPETITIONS 10
+
+static void
+bench_report(const char* name, size_t bytes, uint64_t best_ns)
+{
+    printf(
+        "{\"bench\":\"string_view\",\"case\":\"%s\",\"kernels\":\"" BENCH_KERNELS "\","
+        "\"bytes\":%zu,\"mb_per_sec\":%.1f}\n",
+        name,
+        bytes,
+        (double)bytes / (1024.0 * 1024.0) / ((double)best_ns / 1e9)
+    );
+}
+
+// A log line scanner's worst case, the needle never matches but its first byte is common.
+//
+static void
+bench_contains(struct string_view haystack)
+{
+    uint64_t best_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        const uint64_t start = bench_now_ns();
+        bool           found = sv_contains(haystack, SV_LITERAL("error: disk"));
+        const uint64_t ns    = bench_now_ns() - start;
+        bench_do_not_optimize(&found);
+        if (ns < best_ns) best_ns = ns;
+    }
+    bench_report("contains", haystack.length, best_ns);
+}
+
+static void
+bench_rchop_by_delim(struct string_view haystack)
+{
+    uint64_t best_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        struct string_view view  = haystack;
+        const uint64_t     start = bench_now_ns();
+        struct string_view right = sv_rchop_by_delim(&view, '|');
+        const uint64_t     ns    = bench_now_ns() - start;
+        bench_do_not_optimize(&right);
+        if (ns < best_ns) best_ns = ns;
+    }
+    bench_report("rchop_by_delim", haystack.length, best_ns);
+}
+
+// Lines padded with whitespace on both sides, as fixed width columns are.
+//
+static void
+bench_strip(char* buffer)
+{
+    const size_t line_length = 256;
+    const size_t line_count  = BENCH_BUFFER_SIZE / line_length;
+    for (size_t i = 0; i < BENCH_BUFFER_SIZE; i++) {
+        const size_t column = i % line_length;
+        buffer[i]           = (column < 100 || column >= 156) ? ' ' : 'x';
+    }
+
+    uint64_t best_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        size_t         total = 0;
+        const uint64_t start = bench_now_ns();
+        for (size_t line = 0; line < line_count; line++) {
+            struct string_view view = {.length = line_length, .data = buffer + line * line_length};
+            sv_strip(&view);
+            total += view.length;
+        }
+        const uint64_t ns = bench_now_ns() - start;
+        bench_do_not_optimize(&total);
+        if (ns < best_ns) best_ns = ns;
+    }
+    bench_report("strip", BENCH_BUFFER_SIZE, best_ns);
+}
+
+// TSV shaped input split into fields, a loop of sv_lchop_by_delim against a single pass of
+// sv_split_into
+//
+static void
+bench_split(char* buffer)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < BENCH_BUFFER_SIZE; i++) {
+        const uint64_t random = bench_random(&state);
+        buffer[i]             = (random % 12 == 0) ? '\t' : (random % 97 == 0) ? '\n' : 'v';
+    }
+    const struct string_view input = {.length = BENCH_BUFFER_SIZE, .data = buffer};
+
+    const size_t        capacity = sv_split_into(input, SV_LITERAL("\t\n"), NULL, 0);
+    struct string_view* fields   = malloc(capacity * sizeof *fields);
+    if (!fields) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    uint64_t best_chop_ns  = UINT64_MAX;
+    uint64_t best_split_ns = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        struct string_view view  = input;
+        size_t             total = 0;
+        uint64_t           start = bench_now_ns();
+        while (view.length) {
+            struct string_view line = sv_lchop_by_delim(&view, '\n');
+            if (!line.data) {
+                line = view;
+                view = (struct string_view){0};
+            }
+            while (line.length) {
+                struct string_view field = sv_lchop_by_delim(&line, '\t');
+                if (!field.data) {
+                    field = line;
+                    line  = (struct string_view){0};
+                }
+                fields[total++ % capacity] = field;
+            }
+        }
+        uint64_t ns = bench_now_ns() - start;
+        if (ns < best_chop_ns) best_chop_ns = ns;
+
+        start = bench_now_ns();
+        total = sv_split_into(input, SV_LITERAL("\t\n"), fields, capacity);
+        ns    = bench_now_ns() - start;
+        if (ns < best_split_ns) best_split_ns = ns;
+        bench_do_not_optimize(&total);
+        bench_do_not_optimize(fields);
+    }
+    free(fields);
+
+    bench_report("split_lchop_by_delim", BENCH_BUFFER_SIZE, best_chop_ns);
+    bench_report("split_into", BENCH_BUFFER_SIZE, best_split_ns);
+}
+
+// Filtering lines against many keywords, once per keyword with sv_contains and once with a
+// needle set. The needle set's time should stay flat as keywords are added.
+//
+static void
+bench_keywords(char* buffer, size_t keyword_count)
+{
+    const size_t line_length = 128;
+    const size_t line_count  = BENCH_BUFFER_SIZE / line_length;
+    uint64_t     state       = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < BENCH_BUFFER_SIZE; i++) {
+        buffer[i] = "abcdefghijklmnopqrstuvwxyz "[bench_random(&state) % 27];
+    }
+
+    char               keyword_data[512][8];
+    struct string_view keywords[512];
+    for (size_t i = 0; i < keyword_count; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            keyword_data[i][j] = "abcdefghijklmnopqrstuvwxyz"[bench_random(&state) % 26];
+        }
+        keywords[i] = (struct string_view){.length = 8, .data = keyword_data[i]};
+    }
+    StringViewNeedleSet set = sv_needle_set_create(keywords, keyword_count, NULL, NULL);
+
+    uint64_t best_loop_ns = UINT64_MAX;
+    uint64_t best_set_ns  = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS / 2; i++) {
+        size_t   hits  = 0;
+        uint64_t start = bench_now_ns();
+        for (size_t line = 0; line < line_count; line++) {
+            struct string_view view = {.length = line_length, .data = buffer + line * line_length};
+            for (size_t k = 0; k < keyword_count; k++) {
+                if (sv_contains(view, keywords[k])) {
+                    hits++;
+                    break;
+                }
+            }
+        }
+        uint64_t ns = bench_now_ns() - start;
+        if (ns < best_loop_ns) best_loop_ns = ns;
+
+        start = bench_now_ns();
+        for (size_t line = 0; line < line_count; line++) {
+            struct string_view view = {.length = line_length, .data = buffer + line * line_length};
+            hits += sv_needle_set_matches(set, view);
+        }
+        ns = bench_now_ns() - start;
+        if (ns < best_set_ns) best_set_ns = ns;
+        bench_do_not_optimize(&hits);
+    }
+    sv_needle_set_free(set);
+
+    char name[64];
+    snprintf(name, sizeof name, "keywords_contains_%zu", keyword_count);
+    bench_report(name, BENCH_BUFFER_SIZE, best_loop_ns);
+    snprintf(name, sizeof name, "keywords_needle_set_%zu", keyword_count);
+    bench_report(name, BENCH_BUFFER_SIZE, best_set_ns);
+}
+
+// Newline separated numbers as a CSV or log reader would see them, parsed in place against
+// strtoll and strtod which need each number null terminated first.
+//
+static void
+bench_parse_numbers(char* buffer, bool floats)
+{
+    uint64_t state  = 0x9E3779B97F4A7C15ull;
+    size_t   length = 0;
+    while (length + 32 < BENCH_BUFFER_SIZE) {
+        const uint64_t random = bench_random(&state);
+        if (floats) {
+            length += (size_t)snprintf(
+                buffer + length, 32, "%.*g\n", (int)(1 + random % 17), (double)random / 1e12
+            );
+        }
+        else {
+            length += (size_t)snprintf(
+                buffer + length, 32, "%" PRId64 "\n", (int64_t)random >> (random % 48)
+            );
+        }
+    }
+    const char* name = (floats) ? "f64" : "i64";
+
+    uint64_t best_parse_ns = UINT64_MAX;
+    uint64_t best_libc_ns  = UINT64_MAX;
+    for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+        struct string_view view  = {.length = length, .data = buffer};
+        double             total = 0;
+        uint64_t           start = bench_now_ns();
+        while (view.length) {
+            if (floats) {
+                double value;
+                sv_parse_f64(&view, &value, NULL);
+                total += value;
+            }
+            else {
+                int64_t value;
+                sv_parse_i64(&view, &value, NULL);
+                total += (double)value;
+            }
+            sv_ldiscard(&view, 1);
+        }
+        uint64_t ns = bench_now_ns() - start;
+        if (ns < best_parse_ns) best_parse_ns = ns;
+
+        // a copy per number is what a caller holding a string_view has to do for libc
+        //
+        view  = (struct string_view){.length = length, .data = buffer};
+        start = bench_now_ns();
+        while (view.length) {
+            struct string_view line = sv_lchop_by_delim(&view, '\n');
+            char               copy[32];
+            memcpy(copy, line.data, line.length);
+            copy[line.length] = '\0';
+            total += (floats) ? strtod(copy, NULL) : (double)strtoll(copy, NULL, 10);
+        }
+        ns = bench_now_ns() - start;
+        if (ns < best_libc_ns) best_libc_ns = ns;
+        bench_do_not_optimize(&total);
+    }
+
+    char case_name[64];
+    snprintf(case_name, sizeof case_name, "parse_%s", name);
+    bench_report(case_name, length, best_parse_ns);
+    snprintf(case_name, sizeof case_name, "parse_%s_libc", name);
+    bench_report(case_name, length, best_libc_ns);
+}
+
+int
+main(void)
+{
+    char* buffer = malloc(BENCH_BUFFER_SIZE);
+    if (!buffer) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz :=e";
+    uint64_t          state      = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < BENCH_BUFFER_SIZE; i++) {
+        buffer[i] = alphabet[bench_random(&state) % (sizeof alphabet - 1)];
+    }
+    buffer[0]                         = '|';
+    const struct string_view haystack = {.length = BENCH_BUFFER_SIZE, .data = buffer};
+
+    bench_contains(haystack);
+    bench_rchop_by_delim(haystack);
+    bench_strip(buffer);
+    bench_split(buffer);
+    bench_keywords(buffer, 10);
+    bench_keywords(buffer, 100);
+    bench_keywords(buffer, 500);
+    bench_parse_numbers(buffer, false);
+    bench_parse_numbers(buffer, true);
+
+    free(buffer);
+    return 0;
+}
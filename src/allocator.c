@@ -1,18 +1,46 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS and madvise
+#endif
+
 #include "allocator.h"
 
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static void* platform_map_pages(size_t size, bool huge_pages);
+static void  platform_unmap_pages(void* memory, size_t size);
+static void  platform_release_pages(void* memory, size_t size);
+
 #define ALLOCATION_HEAD_BLOCK_COUNT (sizeof(struct allocation) / sizeof(AllocatorBlock))
+#define DEFAULT_PLUS_NODE_BLOCK_COUNT                                                              \
+    ((sizeof(struct default_plus_node) + sizeof(AllocatorBlock) - 1) / sizeof(AllocatorBlock))
+
+// Headerless allocators leave this many blocks in front of their first allocation, see
+// `scratch_page_start`.
+//
+#define HEADLESS_GAP_BLOCK_COUNT (ALLOCATION_HEAD_BLOCK_COUNT + DEFAULT_PLUS_NODE_BLOCK_COUNT)
 #define MIN_BLOCKS_REQUIRED_FOR_ALLOCATION (1 + ALLOCATION_HEAD_BLOCK_COUNT)
 
 struct allocator default_allocator = {
     .type = ALLOCATOR_DEFAULT,
 };
 
+#ifdef ALLOCATOR_STATS
+#define ALLOCATOR_COUNT(allocator, counter, n)                                                     \
+    atomic_fetch_add_explicit(&(allocator)->counters.counter, (n), memory_order_relaxed)
+#else
+#define ALLOCATOR_COUNT(allocator, counter, n) ((void)0)
+#endif
+
 static size_t
 blocks_required_for_size(size_t size)
 {
-    return ((size + sizeof(AllocatorBlock) - 1) / sizeof(AllocatorBlock));
+    return size / sizeof(AllocatorBlock) + (size % sizeof(AllocatorBlock) != 0);
 }
 
 static size_t
@@ -50,142 +78,241 @@ allocation_next(const struct allocation* mem)
     return (struct allocation*)(mem->blocks + mem->block_count);
 }
 
-static bool
-allocation_array_contains(const struct allocation_array* array, const struct allocation* a)
+static struct allocation*
+allocation_prev(const struct allocation* mem)
 {
-    ALLOCATOR_ASSERT(array);
-    ALLOCATOR_ASSERT(a);
+    ALLOCATOR_ASSERT(mem);
+    const AllocatorBlock* block_view = (const AllocatorBlock*)mem;
+    return (struct allocation*)(block_view - mem->prev_block_count - ALLOCATION_HEAD_BLOCK_COUNT);
+}
 
-    if (a->freelist_id == 0 || a->freelist_id > array->count) {
-        return false;
+static uint32_t
+lowest_set_bit(uint32_t bits)
+{
+    ALLOCATOR_ASSERT(bits);
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(bits);
+#else
+    uint32_t index = 0;
+    while (!(bits & 1u)) {
+        bits >>= 1;
+        index += 1;
+    }
+    return index;
+#endif
+}
+
+// size class bin for a given block_count (floor(log2(block_count)))
+//
+static uint32_t
+bin_for_block_count(size_t block_count)
+{
+    ALLOCATOR_ASSERT(block_count);
+    if (block_count > UINT32_MAX) {
+        return ARENA_PAGE_BIN_COUNT - 1;
     }
+#if defined(__GNUC__) || defined(__clang__)
+    return 31 - (uint32_t)__builtin_clz((uint32_t)block_count);
+#else
+    uint32_t bin = 0;
+    while (block_count >>= 1) {
+        bin += 1;
+    }
+    return bin;
+#endif
+}
+
+static const uint32_t ARENA_PAGE_NO_OFFSET = 0xFFFFFFFF;
+
+// links for the intrusive bin lists, stored in the first block of a free allocation
+//
+struct freelist_links {
+    uint32_t prev;
+    uint32_t next;
+};
+
+ALLOCATOR_STATIC_ASSERT(
+    sizeof(struct freelist_links) <= sizeof(AllocatorBlock), "freelist links exceed one block"
+);
+
+static struct freelist_links*
+freelist_links_view(struct allocation* a)
+{
+    return (struct freelist_links*)a->blocks;
+}
+
+static uint32_t
+arena_page_offset_of(const struct arena_page* page, const struct allocation* a)
+{
+    return (uint32_t)((const AllocatorBlock*)a - page->memory);
+}
+
+static struct allocation*
+arena_page_allocation_at(const struct arena_page* page, uint32_t offset)
+{
+    return (struct allocation*)(page->memory + offset);
+}
 
-    return (array->allocations[a->freelist_id - 1] == a);
+static bool
+arena_page_freelist_contains(const struct arena_page* page, const struct allocation* a)
+{
+    ALLOCATOR_ASSERT(page);
+    ALLOCATOR_ASSERT(a);
+    ALLOCATOR_ASSERT((AllocatorBlock*)a < page->head);
+    (void)page;
+    return a->freelist_id != 0;
 }
 
 static void
-allocation_array_append(struct allocation_array* array, struct allocation* a)
+arena_page_freelist_insert(struct arena_page* page, struct allocation* a)
 {
-    ALLOCATOR_ASSERT(array);
+    ALLOCATOR_ASSERT(page);
     ALLOCATOR_ASSERT(a);
+    ALLOCATOR_ASSERT(a->freelist_id == 0);
 
-    if (array->count >= array->capacity) {
-        array->capacity    = 1 + 2 * array->count;
-        array->allocations = ALLOCATOR_INTERNAL_REALLOC(
-            array->allocations, sizeof *array->allocations * array->capacity
-        );
-        if (!array->allocations) {
-            ALLOCATOR_ABORT("failed to allocate memory for allocator freelist");
-        }
+    const uint32_t         bin    = bin_for_block_count(a->block_count);
+    const uint32_t         offset = arena_page_offset_of(page, a);
+    struct freelist_links* links  = freelist_links_view(a);
+
+    links->prev = ARENA_PAGE_NO_OFFSET;
+    links->next = ARENA_PAGE_NO_OFFSET;
+    if (page->bin_bitmap & (1u << bin)) {
+        links->next = page->bin_heads[bin];
+        freelist_links_view(arena_page_allocation_at(page, links->next))->prev = offset;
     }
-    array->allocations[array->count++] = a;
-    a->freelist_id                     = array->count;
+    page->bin_heads[bin] = offset;
+    page->bin_bitmap |= (1u << bin);
+    a->freelist_id = bin + 1;
 }
 
 static void
-allocation_array_remove(struct allocation_array* array, struct allocation* a)
+arena_page_freelist_remove(struct arena_page* page, struct allocation* a)
 {
-    ALLOCATOR_ASSERT(array);
+    ALLOCATOR_ASSERT(page);
     ALLOCATOR_ASSERT(a);
-    ALLOCATOR_ASSERT(allocation_array_contains(array, a));
+    ALLOCATOR_ASSERT(arena_page_freelist_contains(page, a));
 
-    array->allocations[a->freelist_id - 1]              = array->allocations[--(array->count)];
-    array->allocations[a->freelist_id - 1]->freelist_id = a->freelist_id;
+    const uint32_t         bin   = a->freelist_id - 1;
+    struct freelist_links* links = freelist_links_view(a);
 
+    if (links->prev == ARENA_PAGE_NO_OFFSET) {
+        if (links->next == ARENA_PAGE_NO_OFFSET) {
+            page->bin_bitmap &= ~(1u << bin);
+        }
+        else {
+            page->bin_heads[bin] = links->next;
+        }
+    }
+    else {
+        freelist_links_view(arena_page_allocation_at(page, links->prev))->next = links->next;
+    }
+    if (links->next != ARENA_PAGE_NO_OFFSET) {
+        freelist_links_view(arena_page_allocation_at(page, links->next))->prev = links->prev;
+    }
     a->freelist_id = 0;
+}
 
-    if (array->count * 4 <= array->capacity) {
-        array->capacity    = 1 + 2 * array->count;
-        array->allocations = ALLOCATOR_INTERNAL_REALLOC(
-            array->allocations, sizeof &array->allocations * array->capacity
-        );
-        if (!array->allocations) {
-            ALLOCATOR_ABORT("failed to allocate memory for allocator freelist");
+static struct allocation*
+arena_page_freelist_next(const struct arena_page* page, struct allocation* a)
+{
+    const uint32_t next = freelist_links_view(a)->next;
+    return (next == ARENA_PAGE_NO_OFFSET) ? NULL : arena_page_allocation_at(page, next);
+}
+
+// Returns a free allocation with at least `block_count` blocks or NULL. The head of the smallest
+// bin that could hold the request is tried first, then the larger bins (every member of which is
+// guaranteed to fit), so this is O(1) unless the only fit sits deeper in the request's own bin,
+// which is then walked so nothing a first fit would find is missed.
+//
+static struct allocation*
+arena_page_freelist_find(const struct arena_page* page, size_t block_count)
+{
+    ALLOCATOR_ASSERT(page);
+    ALLOCATOR_ASSERT(block_count);
+
+    if (!page->bin_bitmap) {
+        return NULL;
+    }
+
+    const uint32_t bin         = bin_for_block_count(block_count);
+    const bool     own_bin     = page->bin_bitmap & (1u << bin);
+    const uint32_t larger_bins = page->bin_bitmap & ~((2u << bin) - 1u);
+    if (own_bin) {
+        struct allocation* candidate = arena_page_allocation_at(page, page->bin_heads[bin]);
+        if (candidate->block_count >= block_count) {
+            return candidate;
+        }
+    }
+    if (larger_bins) {
+        return arena_page_allocation_at(page, page->bin_heads[lowest_set_bit(larger_bins)]);
+    }
+    if (!own_bin) {
+        return NULL;
+    }
+
+    struct allocation* candidate = arena_page_allocation_at(page, page->bin_heads[bin]);
+    while ((candidate = arena_page_freelist_next(page, candidate))) {
+        if (candidate->block_count >= block_count) {
+            return candidate;
         }
     }
+    return NULL;
+}
+
+// keeps the boundary tag of the allocation to the right of `a` up to date (this may be the
+// page head, which always carries the tag of the allocation immediately before it)
+//
+static void
+arena_page_update_boundary_tag(struct arena_page* page, struct allocation* a)
+{
+    ALLOCATOR_ASSERT(page);
+    ALLOCATOR_ASSERT(a);
+
+    struct allocation* next = allocation_next(a);
+    ALLOCATOR_ASSERT((AllocatorBlock*)next <= page->head);
+    (void)page;
+    next->prev_block_count = a->block_count;
 }
 
-// returns 0 on failure otherwise returns the number of blocks the caller
-// has taken ownership of (caller may acquire more blocks than requested)
+// Removes `member` from the freelist returning the number of blocks (including the head) the
+// caller has taken ownership of (caller may acquire more blocks than requested). Any surplus
+// large enough to stand on its own is split off to the right and returned to the freelist.
+//
+// The caller is responsible for the boundary tag to the right of the blocks it has taken.
 //
 static size_t
-allocation_array_try_to_take_blocks_from_member(
-    struct allocation_array* array, struct allocation* member, size_t required_blocks
+arena_page_take_blocks_from_free_allocation(
+    struct arena_page* page, struct allocation* member, size_t required_blocks
 )
 {
-    ALLOCATOR_ASSERT(array);
+    ALLOCATOR_ASSERT(page);
     ALLOCATOR_ASSERT(member);
-    ALLOCATOR_ASSERT(allocation_array_contains(array, member));
+    ALLOCATOR_ASSERT(arena_page_freelist_contains(page, member));
 
     const size_t available_blocks = member->block_count + ALLOCATION_HEAD_BLOCK_COUNT;
+    ALLOCATOR_ASSERT(available_blocks >= required_blocks);
 
-    // Not enough blocks available.
-    //
-    if (available_blocks < required_blocks) {
-        return 0;
-    }
+    arena_page_freelist_remove(page, member);
 
     // Enough blocks available, but not enough surplus to support splitting the
     // allocation into two smaller allocations.
     //
     if (available_blocks < required_blocks + MIN_BLOCKS_REQUIRED_FOR_ALLOCATION) {
-        allocation_array_remove(array, member);
         return available_blocks;
     }
 
     // Enough blocks available, and enough surplus to support splitting the allocation into
     // two smaller allocations.
     //
-    const size_t remaining_blocks               = available_blocks - required_blocks;
-    member->block_count                         = required_blocks - ALLOCATION_HEAD_BLOCK_COUNT;
-    struct allocation* new_free_node            = allocation_next(member);
-    new_free_node->block_count                  = remaining_blocks - ALLOCATION_HEAD_BLOCK_COUNT;
-    new_free_node->freelist_id                  = member->freelist_id;
-    array->allocations[member->freelist_id - 1] = new_free_node;
+    struct allocation* remainder =
+        (struct allocation*)((AllocatorBlock*)member + required_blocks);
+    remainder->block_count = available_blocks - required_blocks - ALLOCATION_HEAD_BLOCK_COUNT;
+    remainder->freelist_id = 0;
+    arena_page_freelist_insert(page, remainder);
+    arena_page_update_boundary_tag(page, remainder);
     return required_blocks;
 }
 
-// If the given allocation is adjacent to another allocation already in the array then the two
-// will be joined into a single larger allocation. Otherwise the given allocation will be
-// appended to the array.
-//
-static void
-allocation_array_join_allocation(struct allocation_array* array, struct allocation* a)
-{
-    ALLOCATOR_ASSERT(array);
-    ALLOCATOR_ASSERT(a);
-    ALLOCATOR_ASSERT(a->freelist_id == 0);
-
-    // try to merge with adjecent node to the right
-    //
-    struct allocation* next = allocation_next(a);
-    if (allocation_array_contains(array, next)) {
-        a->freelist_id = next->freelist_id;
-        a->block_count += next->block_count + ALLOCATION_HEAD_BLOCK_COUNT;
-        array->allocations[a->freelist_id - 1] = a;
-    }
-
-    // try to merge with adjacent node to the left
-    //
-    for (size_t i = 0; i < array->count; i++) {
-        struct allocation* before                   = array->allocations[i];
-        struct allocation* next_after_iterated_node = allocation_next(before);
-        if (next_after_iterated_node == a) {
-            before->block_count += a->block_count + ALLOCATION_HEAD_BLOCK_COUNT;
-            if (a->freelist_id != 0) {
-                allocation_array_remove(array, a);
-            }
-            return;
-        }
-    }
-
-    // no adjecent node in array to merge with
-    //
-    if (a->freelist_id == 0) {
-        allocation_array_append(array, a);
-    }
-}
-
 struct arena_page
 arena_page_create_from_memory(void* memory, size_t size, bool page_owns_memory)
 {
@@ -209,6 +336,11 @@ arena_page_create_from_memory(void* memory, size_t size, bool page_owns_memory)
     struct allocation* end_allocation_view = (struct allocation*)page.end;
     memset(end_allocation_view, 0, sizeof *end_allocation_view);
 
+    // the head carries the boundary tag of the allocation before it (none yet)
+    //
+    struct allocation* head_allocation_view = (struct allocation*)page.head;
+    head_allocation_view->prev_block_count  = 0;
+
     return page;
 }
 
@@ -222,17 +354,65 @@ arena_page_contains_allocation(const struct arena_page* page, const struct alloc
     return (blockview >= page->memory && blockview < page->end);
 }
 
+// Finds the page that owns the allocation through the page id recorded in its head. The id
+// is only trusted once the allocation is confirmed to lie within the page it names, so
+// this is safe to call on allocations which were not made by this arena.
+//
+static struct arena_page*
+arena_find_owning_page(const struct arena* arena, const struct allocation* a)
+{
+    ALLOCATOR_ASSERT(arena);
+    ALLOCATOR_ASSERT(a);
+
+    if (a->page_id == 0 || a->page_id > arena->page_count) {
+        return NULL;
+    }
+    struct arena_page* page = &arena->pages[a->page_id - 1];
+    if (!arena_page_contains_allocation(page, a)) {
+        return NULL;
+    }
+    return page;
+}
+
+static size_t
+arena_page_memory_size(const struct arena_page* page)
+{
+    return (size_t)(page->end - page->memory + ALLOCATION_HEAD_BLOCK_COUNT) * sizeof *page->memory;
+}
+
 static void
 arena_page_deallocate_entire_page(struct arena_page* page)
 {
     if (!page) return;
-    if (page->owns_memory) {
+    if (page->owns_memory && page->mapped) {
+        platform_unmap_pages(page->memory, arena_page_memory_size(page));
+    }
+    else if (page->owns_memory) {
         ALLOCATOR_INTERNAL_FREE(page->memory);
     }
-    ALLOCATOR_INTERNAL_FREE(page->freelist.allocations);
     *page = (struct arena_page){0};
 }
 
+// gives every allocation in the page back at once, keeping the page memory
+//
+static void
+arena_page_reset(struct arena_page* page)
+{
+    if (!page->memory) return;
+    const bool   mapped    = page->mapped;
+    const bool   dedicated = page->dedicated;
+    const size_t size      = arena_page_memory_size(page);
+    *page           = arena_page_create_from_memory(page->memory, size, page->owns_memory);
+    page->mapped    = mapped;
+    page->dedicated = dedicated;
+}
+
+static bool
+arena_page_is_empty(const struct arena_page* page)
+{
+    return page->memory && page->head == page->memory;
+}
+
 static bool
 arena_page_try_advancing_head(struct arena_page* page, size_t advance_block_count)
 {
@@ -242,6 +422,45 @@ arena_page_try_advancing_head(struct arena_page* page, size_t advance_block_coun
     return true;
 }
 
+// caller is responsible for ensuring the pointer belongs to this page
+//
+static void
+arena_page_free_allocation(struct arena_page* page, struct allocation* a)
+{
+    ALLOCATOR_ASSERT(page);
+    ALLOCATOR_ASSERT(a);
+
+    // try to merge with adjacent node to the right
+    //
+    struct allocation* next = allocation_next(a);
+    if ((AllocatorBlock*)next != page->head && arena_page_freelist_contains(page, next)) {
+        arena_page_freelist_remove(page, next);
+        a->block_count += next->block_count + ALLOCATION_HEAD_BLOCK_COUNT;
+    }
+
+    // try to merge with adjacent node to the left (found through the boundary tag)
+    //
+    if ((AllocatorBlock*)a != page->memory) {
+        struct allocation* prev = allocation_prev(a);
+        if (arena_page_freelist_contains(page, prev)) {
+            arena_page_freelist_remove(page, prev);
+            prev->block_count += a->block_count + ALLOCATION_HEAD_BLOCK_COUNT;
+            a = prev;
+        }
+    }
+
+    // give the blocks back to the head when the allocation ends there (since neighbours are
+    // always merged, the allocation before the head is never free)
+    //
+    if ((AllocatorBlock*)allocation_next(a) == page->head) {
+        page->head = (AllocatorBlock*)a;
+        return;
+    }
+
+    arena_page_freelist_insert(page, a);
+    arena_page_update_boundary_tag(page, a);
+}
+
 static bool
 arena_page_try_reallocating_in_place(struct arena_page* page, struct allocation* a, size_t size)
 {
@@ -260,6 +479,7 @@ arena_page_try_reallocating_in_place(struct arena_page* page, struct allocation*
         if ((AllocatorBlock*)allocation_next(a) == page->head) {
             page->head -= remaining_blocks;
             a->block_count = required_blocks;
+            arena_page_update_boundary_tag(page, a);
             return true;
         }
 
@@ -267,7 +487,8 @@ arena_page_try_reallocating_in_place(struct arena_page* page, struct allocation*
         struct allocation* remainder = allocation_next(a);
         remainder->block_count       = remaining_blocks - ALLOCATION_HEAD_BLOCK_COUNT;
         remainder->freelist_id       = 0;
-        allocation_array_join_allocation(&page->freelist, remainder);
+        arena_page_update_boundary_tag(page, a);
+        arena_page_free_allocation(page, remainder);
         return true;
     }
     // allocation is growing
@@ -283,20 +504,21 @@ arena_page_try_reallocating_in_place(struct arena_page* page, struct allocation*
                 return false;
             }
             a->block_count += additional_blocks_required;
+            arena_page_update_boundary_tag(page, a);
             return true;
         }
 
         // try to allocate extra space from a freed allocation
         //
-        if (allocation_array_contains(&page->freelist, next)) {
-            size_t blocks_allocated = allocation_array_try_to_take_blocks_from_member(
-                &page->freelist, next, additional_blocks_required
-            );
-            if (blocks_allocated == 0) {
+        if (arena_page_freelist_contains(page, next)) {
+            if (next->block_count + ALLOCATION_HEAD_BLOCK_COUNT < additional_blocks_required) {
                 return false;
             }
+            size_t blocks_allocated =
+                arena_page_take_blocks_from_free_allocation(page, next, additional_blocks_required);
             ALLOCATOR_ASSERT(blocks_allocated >= additional_blocks_required);
             a->block_count += blocks_allocated;
+            arena_page_update_boundary_tag(page, a);
             return true;
         }
 
@@ -315,28 +537,19 @@ arena_page_make_allocation(struct arena_page* page, size_t size)
     ALLOCATOR_ASSERT(size);
     ALLOCATOR_ASSERT(page);
 
-    const size_t required_blocks = blocks_required_for_size(size) + ALLOCATION_HEAD_BLOCK_COUNT;
-
-    // page full
-    //
-    if (page->end - page->head <= (int64_t)required_blocks && page->freelist.count == 0) {
-        return NULL;
-    }
+    const size_t data_blocks     = blocks_required_for_size(size);
+    const size_t required_blocks = data_blocks + ALLOCATION_HEAD_BLOCK_COUNT;
 
     // attempt to allocate from freelist
     //
-    for (size_t i = 0; i < page->freelist.count; i++) {
-        struct allocation* a = page->freelist.allocations[i];
-        ALLOCATOR_ASSERT(a);
-
+    struct allocation* a = arena_page_freelist_find(page, data_blocks);
+    if (a) {
         size_t allocated_blocks =
-            allocation_array_try_to_take_blocks_from_member(&page->freelist, a, required_blocks);
-        if (allocated_blocks == 0) {
-            continue;
-        }
+            arena_page_take_blocks_from_free_allocation(page, a, required_blocks);
         ALLOCATOR_ASSERT(allocated_blocks >= required_blocks);
-        a->freelist_id = 0;
         a->block_count = allocated_blocks - ALLOCATION_HEAD_BLOCK_COUNT;
+        a->page_id     = 0;
+        arena_page_update_boundary_tag(page, a);
         return a;
     }
 
@@ -344,31 +557,16 @@ arena_page_make_allocation(struct arena_page* page, size_t size)
     //
     struct allocation* new_allocation = (struct allocation*)page->head;
     if (arena_page_try_advancing_head(page, required_blocks)) {
-        new_allocation->block_count = required_blocks - ALLOCATION_HEAD_BLOCK_COUNT;
+        new_allocation->block_count = data_blocks;
         new_allocation->freelist_id = 0;
+        new_allocation->page_id     = 0;
+        arena_page_update_boundary_tag(page, new_allocation);
         return new_allocation;
     }
 
     return NULL;
 }
 
-// caller is responsible for ensuring the pointer belongs to this page
-//
-static void
-arena_page_free_allocation(struct arena_page* page, struct allocation* a)
-{
-    ALLOCATOR_ASSERT(page);
-    ALLOCATOR_ASSERT(a);
-
-    struct allocation* next_alloc = allocation_next(a);
-
-    if ((AllocatorBlock*)next_alloc == page->head) {
-        page->head -= ALLOCATION_HEAD_BLOCK_COUNT + a->block_count;
-    }
-    else {
-        allocation_array_join_allocation(&page->freelist, a);
-    }
-}
 
 static const uint32_t DEFAULT_ALLOCATOR_SPECIAL_FREELIST_ID = 0xFFFFFFFF;
 
@@ -383,6 +581,7 @@ default_malloc(size_t size)
     }
     a->block_count = blocks_required_for_size(size);
     a->freelist_id = DEFAULT_ALLOCATOR_SPECIAL_FREELIST_ID;
+    a->page_id     = 0;
     return a;
 }
 
@@ -411,114 +610,305 @@ default_free(struct allocation* a)
     ALLOCATOR_INTERNAL_FREE(a);
 }
 
+// DEFAULT_PLUS allocations are a default_plus_node followed by a regular allocation head. The
+// node links the allocation into its allocator's list so tracking never allocates, and the
+// node's owner makes checking ownership constant time.
+//
+static const uint32_t DEFAULT_PLUS_ALLOCATOR_SPECIAL_FREELIST_ID = 0xFFFFFFFD;
+
+static struct default_plus_node*
+default_plus_node_of(const struct allocation* a)
+{
+    return (struct default_plus_node*)((AllocatorBlock*)a - DEFAULT_PLUS_NODE_BLOCK_COUNT);
+}
+
+static struct allocation*
+default_plus_allocation_of(const struct default_plus_node* node)
+{
+    return (struct allocation*)((AllocatorBlock*)node + DEFAULT_PLUS_NODE_BLOCK_COUNT);
+}
+
+static bool
+default_plus_contains(const struct default_plus_list* list, const struct allocation* a)
+{
+    ALLOCATOR_ASSERT(list);
+    ALLOCATOR_ASSERT(a);
+
+    return a->freelist_id == DEFAULT_PLUS_ALLOCATOR_SPECIAL_FREELIST_ID &&
+           default_plus_node_of(a)->owner == list;
+}
+
+static void
+default_plus_link(struct default_plus_list* list, struct default_plus_node* node)
+{
+    node->owner = list;
+    node->prev  = NULL;
+    node->next  = list->head;
+    if (list->head) {
+        list->head->prev = node;
+    }
+    list->head = node;
+    list->count += 1;
+}
+
+static void
+default_plus_unlink(struct default_plus_list* list, struct default_plus_node* node)
+{
+    if (node->prev) {
+        node->prev->next = node->next;
+    }
+    else {
+        list->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    list->count -= 1;
+}
+
+static size_t
+default_plus_total_size(size_t size)
+{
+    return DEFAULT_PLUS_NODE_BLOCK_COUNT * sizeof(AllocatorBlock) +
+           total_allocation_size_by_data_size(size);
+}
+
 static struct allocation*
-default_plus_malloc(struct allocation_array* default_plus_allocations, size_t size)
+default_plus_malloc(struct default_plus_list* list, size_t size)
 {
-    ALLOCATOR_ASSERT(default_plus_allocations);
+    ALLOCATOR_ASSERT(list);
     ALLOCATOR_ASSERT(size);
 
-    const size_t       block_count = blocks_required_for_size(size);
-    const size_t       total_size  = total_allocation_size_by_data_size(size);
-    struct allocation* a           = ALLOCATOR_INTERNAL_MALLOC(total_size);
-    if (!a) {
+    struct default_plus_node* node = ALLOCATOR_INTERNAL_MALLOC(default_plus_total_size(size));
+    if (!node) {
         return NULL;
     }
-    a->block_count = block_count;
-    allocation_array_append(default_plus_allocations, a);
+    default_plus_link(list, node);
+
+    struct allocation* a = default_plus_allocation_of(node);
+    a->block_count       = blocks_required_for_size(size);
+    a->freelist_id       = DEFAULT_PLUS_ALLOCATOR_SPECIAL_FREELIST_ID;
+    a->page_id           = 0;
     return a;
 }
 
 static void
-default_plus_free(struct allocation_array* default_plus_allocations, struct allocation* a)
+default_plus_free(struct default_plus_list* list, struct allocation* a)
 {
-    ALLOCATOR_ASSERT(default_plus_allocations);
+    ALLOCATOR_ASSERT(list);
     ALLOCATOR_ASSERT(a);
 
-    allocation_array_remove(default_plus_allocations, a);
-    ALLOCATOR_INTERNAL_FREE(a);
+    struct default_plus_node* node = default_plus_node_of(a);
+    default_plus_unlink(list, node);
+    ALLOCATOR_INTERNAL_FREE(node);
 }
 
 // caller is responsible for ensuring the allocation belongs to this allocator
 //
 static struct allocation*
-default_plus_realloc(
-    struct allocation_array* default_plus_allocations, struct allocation* a, size_t size
-)
+default_plus_realloc(struct default_plus_list* list, struct allocation* a, size_t size)
 {
-    ALLOCATOR_ASSERT(default_plus_allocations);
+    ALLOCATOR_ASSERT(list);
     ALLOCATOR_ASSERT(size);
     ALLOCATOR_ASSERT(a);
-    ALLOCATOR_ASSERT(allocation_array_contains(default_plus_allocations, a));
+    ALLOCATOR_ASSERT(default_plus_contains(list, a));
 
-    struct allocation* new =
-        ALLOCATOR_INTERNAL_REALLOC(a, total_allocation_size_by_data_size(size));
+    struct default_plus_node* node = default_plus_node_of(a);
+    struct default_plus_node* new =
+        ALLOCATOR_INTERNAL_REALLOC(node, default_plus_total_size(size));
     if (!new) {
         return NULL;
     }
-    if (new != a) {
-        default_plus_allocations->allocations[new->freelist_id - 1] = new;
+
+    // the neighbours still point at the old node
+    //
+    if (new != node) {
+        if (new->prev) {
+            new->prev->next = new;
+        }
+        else {
+            list->head = new;
+        }
+        if (new->next) {
+            new->next->prev = new;
+        }
     }
-    new->block_count = blocks_required_for_size(size);
-    return new;
+
+    struct allocation* new_allocation = default_plus_allocation_of(new);
+    new_allocation->block_count       = blocks_required_for_size(size);
+    return new_allocation;
 }
 
-static struct allocation*
-arena_malloc(struct arena* arena, size_t size)
+static void
+default_plus_free_all(struct default_plus_list* list)
 {
-    ALLOCATOR_ASSERT(arena);
-    ALLOCATOR_ASSERT(size);
+    struct default_plus_node* node = list->head;
+    while (node) {
+        struct default_plus_node* next = node->next;
+        ALLOCATOR_INTERNAL_FREE(node);
+        node = next;
+    }
+    *list = (struct default_plus_list){0};
+}
 
-    if (size > arena->page_size) {
-        return NULL;
+// Size of a page holding nothing but one allocation of `size` bytes, with room for the
+// sentinel head at the end of the page. Returns 0 when the allocation is too large for its head
+// to describe (block counts are 32 bits) or the size isn't representable.
+//
+static size_t
+arena_page_size_for_allocation(size_t size)
+{
+    const size_t data_blocks = blocks_required_for_size(size);
+    if (data_blocks > UINT32_MAX ||
+        data_blocks > SIZE_MAX / sizeof(AllocatorBlock) - 2 * ALLOCATION_HEAD_BLOCK_COUNT) {
+        return 0;
     }
+    return (data_blocks + 2 * ALLOCATION_HEAD_BLOCK_COUNT) * sizeof(AllocatorBlock);
+}
 
-    struct allocation* a = NULL;
-    for (size_t i = 0; i < arena->page_count; i++) {
-        if ((a = arena_page_make_allocation(&arena->pages[i], size))) {
-            return a;
+// Adds a page of (at least) `size` bytes returning its page id (0 on failure). Pages are sized
+// for `page_size` unless an allocation wouldn't fit, then it gets a dedicated page of its own
+// which is given back as soon as the allocation is freed.
+//
+static uint32_t
+arena_add_page(struct arena* arena, size_t size, bool dedicated)
+{
+    const bool mapped     = arena->flags & (ARENA_MAP_PAGES | ARENA_HUGE_PAGES);
+    const bool huge_pages = arena->flags & ARENA_HUGE_PAGES;
+    if (huge_pages) {
+        if (size > SIZE_MAX - ALLOCATOR_HUGE_PAGE_SIZE + 1) {
+            return 0;
         }
+        size = (size + ALLOCATOR_HUGE_PAGE_SIZE - 1) / ALLOCATOR_HUGE_PAGE_SIZE *
+               ALLOCATOR_HUGE_PAGE_SIZE;
     }
 
-    arena->page_count += 1;
-    arena->pages =
-        ALLOCATOR_INTERNAL_REALLOC(arena->pages, sizeof *arena->pages * arena->page_count);
-    if (!arena->pages) {
-        ALLOCATOR_ABORT("paged allocator failed to allocate page");
+    // slots of released dedicated pages are reused so page ids stay stable
+    //
+    size_t index = arena->page_count;
+    for (size_t i = 0; i < arena->page_count; i++) {
+        if (!arena->pages[i].memory) {
+            index = i;
+            break;
+        }
+    }
+    if (index >= UINT32_MAX) {
+        return 0;
     }
 
-    AllocatorBlock* page_memory = ALLOCATOR_INTERNAL_MALLOC(arena->page_size);
+    AllocatorBlock* page_memory =
+        (mapped) ? platform_map_pages(size, huge_pages) : ALLOCATOR_INTERNAL_MALLOC(size);
     if (!page_memory) {
-        ALLOCATOR_ABORT("paged allocator failed to allocate page");
+        return 0;
+    }
+
+    if (index == arena->page_count) {
+        struct arena_page* pages = ALLOCATOR_INTERNAL_REALLOC(
+            arena->pages, sizeof *arena->pages * (arena->page_count + 1)
+        );
+        if (!pages) {
+            if (mapped) {
+                platform_unmap_pages(page_memory, size);
+            }
+            else {
+                ALLOCATOR_INTERNAL_FREE(page_memory);
+            }
+            return 0;
+        }
+        arena->pages = pages;
+        arena->page_count += 1;
     }
 
-    struct arena_page* new_page = &arena->pages[arena->page_count - 1];
-    *new_page = arena_page_create_from_memory(page_memory, arena->page_size, true);
-    return arena_page_make_allocation(new_page, size);
+    arena->pages[index]        = arena_page_create_from_memory(page_memory, size, true);
+    arena->pages[index].mapped    = mapped;
+    arena->pages[index].dedicated = dedicated;
+    return (uint32_t)index + 1;
 }
 
-// caller is responsible for ensuring the allocation belongs to this arena
-//
 static struct allocation*
-arena_realloc(struct arena* arena, struct allocation* a, size_t size)
+arena_malloc(struct arena* arena, size_t size)
 {
     ALLOCATOR_ASSERT(arena);
     ALLOCATOR_ASSERT(size);
-    ALLOCATOR_ASSERT(a);
 
-    if (size > arena->page_size) {
+    struct allocation* a = NULL;
+
+    const size_t required_page_size = arena_page_size_for_allocation(size);
+    if (!required_page_size) {
         return NULL;
     }
+    if (required_page_size > arena->page_size) {
+        const uint32_t page_id = arena_add_page(arena, required_page_size, true);
+        if (page_id && (a = arena_page_make_allocation(&arena->pages[page_id - 1], size))) {
+            a->page_id = page_id;
+        }
+        return a;
+    }
+
+    if (arena->recent_page_index < arena->page_count) {
+        const size_t i = arena->recent_page_index;
+        if (arena->pages[i].memory && (a = arena_page_make_allocation(&arena->pages[i], size))) {
+            a->page_id = i + 1;
+            return a;
+        }
+    }
+    for (size_t i = 0; i < arena->page_count; i++) {
+        if (arena->pages[i].memory && (a = arena_page_make_allocation(&arena->pages[i], size))) {
+            a->page_id = i + 1;
+            return a;
+        }
+    }
 
-    struct arena_page* owning_page       = NULL;
-    size_t             owning_page_index = 0;
+    const uint32_t page_id = arena_add_page(arena, arena->page_size, false);
+    if (page_id && (a = arena_page_make_allocation(&arena->pages[page_id - 1], size))) {
+        a->page_id = page_id;
+    }
+    return a;
+}
 
+// caller is responsible for ensuring the allocation belongs to this arena
+//
+static void
+arena_free(struct arena* arena, struct allocation* a)
+{
+    struct arena_page* page = arena_find_owning_page(arena, a);
+    ALLOCATOR_ASSERT(page);
+
+    arena_page_free_allocation(page, a);
+    if (page->dedicated) {
+        if (arena_page_is_empty(page)) {
+            arena_page_deallocate_entire_page(page);
+        }
+        return;
+    }
+    arena->recent_page_index = (size_t)(page - arena->pages);
+}
+
+// Hands the physical memory of empty mapped pages back to the system, the pages stay mapped
+// and are faulted back in when used again.
+//
+static void
+arena_trim(struct arena* arena)
+{
     for (size_t i = 0; i < arena->page_count; i++) {
-        if (arena_page_contains_allocation(&arena->pages[i], a)) {
-            owning_page       = &arena->pages[i];
-            owning_page_index = i;
-            break;
-        };
+        struct arena_page* page = &arena->pages[i];
+        if (page->mapped && arena_page_is_empty(page)) {
+            platform_release_pages(page->memory, arena_page_memory_size(page));
+            arena_page_reset(page);
+        }
     }
+}
+
+// caller is responsible for ensuring the allocation belongs to this arena
+//
+static struct allocation*
+arena_realloc(struct arena* arena, struct allocation* a, size_t size)
+{
+    ALLOCATOR_ASSERT(arena);
+    ALLOCATOR_ASSERT(size);
+    ALLOCATOR_ASSERT(a);
+
+    struct arena_page* owning_page = arena_find_owning_page(arena, a);
     if (!owning_page) {
         return NULL;
     }
@@ -536,7 +926,7 @@ arena_realloc(struct arena* arena, struct allocation* a, size_t size)
     const size_t smaller_block_count =
         (a->block_count < new->block_count) ? a->block_count : new->block_count;
     memcpy(new->blocks, a->blocks, smaller_block_count * sizeof *a->blocks);
-    arena_page_free_allocation(&arena->pages[owning_page_index], a);
+    arena_free(arena, a);
     return new;
 }
 
@@ -565,41 +955,727 @@ static_arena_realloc(struct arena_page* page, struct allocation* a, size_t size)
     return new;
 }
 
+struct concurrent_arena_page {
+    struct arena_page              page;
+    struct concurrent_arena_cache* owner;
+};
+
+struct concurrent_arena_cache {
+    struct concurrent_arena_cache* next;  // link in the arena's list of every cache
+    _Atomic(struct allocation*)    remote_frees;  // linked through the first block
+    size_t                         recent_page_index;
+    size_t                         page_count;
+    size_t                         page_capacity;
+    uint32_t*                      page_ids;
+};
+
+#define CONCURRENT_ARENA_THREAD_CACHE_SLOTS 8
+
+struct concurrent_arena_thread_cache_slot {
+    uint64_t                       arena_id;
+    struct concurrent_arena_cache* cache;
+};
+
+static _Thread_local struct concurrent_arena_thread_cache_slot
+    concurrent_arena_thread_caches[CONCURRENT_ARENA_THREAD_CACHE_SLOTS];
+
+static _Thread_local size_t concurrent_arena_thread_cache_next_slot;
+
+static _Atomic(uint64_t) concurrent_arena_next_id = 1;
+
+static uint64_t
+concurrent_arena_id(struct concurrent_arena* arena)
+{
+    uint64_t id = atomic_load_explicit(&arena->id, memory_order_acquire);
+    if (id) {
+        return id;
+    }
+    uint64_t new_id = atomic_fetch_add(&concurrent_arena_next_id, 1);
+    if (atomic_compare_exchange_strong(&arena->id, &id, new_id)) {
+        return new_id;
+    }
+    return id;  // another thread got there first
+}
+
+// Returns the calling thread's cache for this arena. When `create` is false NULL is returned
+// for threads which have never allocated from the arena.
+//
+static struct concurrent_arena_cache*
+concurrent_arena_thread_cache(struct concurrent_arena* arena, bool create)
+{
+    const uint64_t id = concurrent_arena_id(arena);
+    for (size_t i = 0; i < CONCURRENT_ARENA_THREAD_CACHE_SLOTS; i++) {
+        if (concurrent_arena_thread_caches[i].arena_id == id) {
+            return concurrent_arena_thread_caches[i].cache;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    struct concurrent_arena_cache* cache = ALLOCATOR_INTERNAL_MALLOC(sizeof *cache);
+    if (!cache) {
+        return NULL;
+    }
+    *cache = (struct concurrent_arena_cache){0};
+    atomic_init(&cache->remote_frees, NULL);
+
+    cache->next = atomic_load_explicit(&arena->caches, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+        &arena->caches, &cache->next, cache, memory_order_release, memory_order_relaxed
+    )) {
+    }
+
+    // A thread using more arenas than there are slots evicts the oldest cache. The evicted
+    // cache's memory stays valid (and is released by `allocator_destroy`), but the thread
+    // will start a fresh cache if it comes back to that arena.
+    //
+    const size_t slot =
+        concurrent_arena_thread_cache_next_slot++ % CONCURRENT_ARENA_THREAD_CACHE_SLOTS;
+    concurrent_arena_thread_caches[slot] = (struct concurrent_arena_thread_cache_slot){
+        .arena_id = id,
+        .cache    = cache,
+    };
+    return cache;
+}
+
+// Safe to call from any thread on any allocation (the page id is validated against pages
+// which have been published).
+//
+static struct concurrent_arena_page*
+concurrent_arena_find_owning_page(struct concurrent_arena* arena, const struct allocation* a)
+{
+    ALLOCATOR_ASSERT(arena);
+    ALLOCATOR_ASSERT(a);
+
+    const size_t page_count = atomic_load_explicit(&arena->page_count, memory_order_acquire);
+    if (a->page_id == 0 || a->page_id > page_count) {
+        return NULL;
+    }
+    struct concurrent_arena_page* page = arena->pages[a->page_id - 1];
+    if (!arena_page_contains_allocation(&page->page, a)) {
+        return NULL;
+    }
+    return page;
+}
+
+static void
+concurrent_arena_lock_pages(struct concurrent_arena* arena)
+{
+    while (atomic_exchange_explicit(&arena->page_lock, true, memory_order_acquire)) {
+        while (atomic_load_explicit(&arena->page_lock, memory_order_relaxed)) {
+        }
+    }
+}
+
+static void
+concurrent_arena_unlock_pages(struct concurrent_arena* arena)
+{
+    atomic_store_explicit(&arena->page_lock, false, memory_order_release);
+}
+
+// Publishes a new page owned by `cache` returning its page id (0 on failure).
+//
+static uint32_t
+concurrent_arena_add_page(struct concurrent_arena* arena, struct concurrent_arena_cache* cache)
+{
+    if (cache->page_count >= cache->page_capacity) {
+        const size_t new_capacity = 1 + 2 * cache->page_capacity;
+        uint32_t*    page_ids =
+            ALLOCATOR_INTERNAL_REALLOC(cache->page_ids, sizeof *page_ids * new_capacity);
+        if (!page_ids) {
+            return 0;
+        }
+        cache->page_ids      = page_ids;
+        cache->page_capacity = new_capacity;
+    }
+
+    struct concurrent_arena_page* page        = ALLOCATOR_INTERNAL_MALLOC(sizeof *page);
+    AllocatorBlock*               page_memory = ALLOCATOR_INTERNAL_MALLOC(arena->page_size);
+    if (!page || !page_memory) {
+        ALLOCATOR_INTERNAL_FREE(page);
+        ALLOCATOR_INTERNAL_FREE(page_memory);
+        return 0;
+    }
+    page->page  = arena_page_create_from_memory(page_memory, arena->page_size, true);
+    page->owner = cache;
+
+    uint32_t page_id = 0;
+    concurrent_arena_lock_pages(arena);
+    {
+        if (!arena->pages) {
+            arena->pages = ALLOCATOR_INTERNAL_MALLOC(
+                sizeof *arena->pages * ALLOCATOR_CONCURRENT_ARENA_MAX_PAGES
+            );
+        }
+        const size_t page_count = atomic_load_explicit(&arena->page_count, memory_order_relaxed);
+        if (arena->pages && page_count < ALLOCATOR_CONCURRENT_ARENA_MAX_PAGES) {
+            arena->pages[page_count] = page;
+            atomic_store_explicit(&arena->page_count, page_count + 1, memory_order_release);
+            page_id = page_count + 1;
+        }
+    }
+    concurrent_arena_unlock_pages(arena);
+
+    if (!page_id) {
+        arena_page_deallocate_entire_page(&page->page);
+        ALLOCATOR_INTERNAL_FREE(page);
+        return 0;
+    }
+    cache->page_ids[cache->page_count++] = page_id;
+    return page_id;
+}
+
+// returns the blocks other threads have freed back to the pages of this cache
+//
+static void
+concurrent_arena_cache_collect_remote_frees(
+    struct concurrent_arena* arena, struct concurrent_arena_cache* cache
+)
+{
+    if (!atomic_load_explicit(&cache->remote_frees, memory_order_relaxed)) {
+        return;
+    }
+    struct allocation* a =
+        atomic_exchange_explicit(&cache->remote_frees, NULL, memory_order_acquire);
+    while (a) {
+        struct allocation* next;
+        memcpy(&next, a->blocks, sizeof next);
+        struct concurrent_arena_page* page = arena->pages[a->page_id - 1];
+        ALLOCATOR_ASSERT(page->owner == cache);
+        arena_page_free_allocation(&page->page, a);
+        a = next;
+    }
+}
+
+static struct allocation*
+concurrent_arena_cache_make_allocation(
+    struct concurrent_arena* arena, struct concurrent_arena_cache* cache, size_t index, size_t size
+)
+{
+    const uint32_t     page_id = cache->page_ids[index];
+    struct allocation* a       = arena_page_make_allocation(&arena->pages[page_id - 1]->page, size);
+    if (a) {
+        a->page_id               = page_id;
+        cache->recent_page_index = index;
+    }
+    return a;
+}
+
+static struct allocation*
+concurrent_arena_malloc(struct concurrent_arena* arena, size_t size)
+{
+    ALLOCATOR_ASSERT(arena);
+    ALLOCATOR_ASSERT(size);
+
+    // requests which wouldn't fit in a fresh page are refused before a page is added for them
+    //
+    const size_t required_page_size = arena_page_size_for_allocation(size);
+    if (!required_page_size || required_page_size > arena->page_size) {
+        return NULL;
+    }
+
+    struct concurrent_arena_cache* cache = concurrent_arena_thread_cache(arena, true);
+    if (!cache) {
+        return NULL;
+    }
+    concurrent_arena_cache_collect_remote_frees(arena, cache);
+
+    struct allocation* a = NULL;
+    if (cache->recent_page_index < cache->page_count) {
+        if ((a = concurrent_arena_cache_make_allocation(
+                 arena, cache, cache->recent_page_index, size
+             ))) {
+            return a;
+        }
+    }
+    for (size_t i = 0; i < cache->page_count; i++) {
+        if ((a = concurrent_arena_cache_make_allocation(arena, cache, i, size))) {
+            return a;
+        }
+    }
+
+    if (!concurrent_arena_add_page(arena, cache)) {
+        return NULL;
+    }
+    return concurrent_arena_cache_make_allocation(arena, cache, cache->page_count - 1, size);
+}
+
+// caller is responsible for ensuring the allocation belongs to this arena
+//
+static void
+concurrent_arena_free(struct concurrent_arena* arena, struct allocation* a)
+{
+    ALLOCATOR_ASSERT(arena);
+    ALLOCATOR_ASSERT(a);
+
+    struct concurrent_arena_page* page = concurrent_arena_find_owning_page(arena, a);
+    ALLOCATOR_ASSERT(page);
+
+    struct concurrent_arena_cache* cache = concurrent_arena_thread_cache(arena, false);
+    if (page->owner == cache) {
+        arena_page_free_allocation(&page->page, a);
+        return;
+    }
+
+    // hand the allocation back to the thread which owns the page
+    //
+    struct allocation** link = (struct allocation**)a->blocks;
+    *link = atomic_load_explicit(&page->owner->remote_frees, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+        &page->owner->remote_frees, link, a, memory_order_release, memory_order_relaxed
+    )) {
+    }
+}
+
+// caller is responsible for ensuring the allocation belongs to this arena
+//
+static struct allocation*
+concurrent_arena_realloc(struct concurrent_arena* arena, struct allocation* a, size_t size)
+{
+    ALLOCATOR_ASSERT(arena);
+    ALLOCATOR_ASSERT(size);
+    ALLOCATOR_ASSERT(a);
+
+    struct concurrent_arena_page* page = concurrent_arena_find_owning_page(arena, a);
+    ALLOCATOR_ASSERT(page);
+
+    if (page->owner == concurrent_arena_thread_cache(arena, false) &&
+        arena_page_try_reallocating_in_place(&page->page, a, size)) {
+        return a;
+    }
+
+    struct allocation* new = concurrent_arena_malloc(arena, size);
+    if (!new) {
+        return NULL;
+    }
+
+    const size_t smaller_block_count =
+        (a->block_count < new->block_count) ? a->block_count : new->block_count;
+    memcpy(new->blocks, a->blocks, smaller_block_count * sizeof *a->blocks);
+    concurrent_arena_free(arena, a);
+    return new;
+}
+
+// collects the blocks waiting in every cache, including those of threads which have exited
+//
+static void
+concurrent_arena_trim(struct concurrent_arena* arena)
+{
+    ALLOCATOR_ASSERT(arena);
+
+    for (struct concurrent_arena_cache* cache = atomic_load(&arena->caches); cache;
+         cache                                = cache->next) {
+        concurrent_arena_cache_collect_remote_frees(arena, cache);
+    }
+}
+
+static void
+concurrent_arena_destroy(struct concurrent_arena* arena)
+{
+    ALLOCATOR_ASSERT(arena);
+
+    const size_t page_count = atomic_load(&arena->page_count);
+    for (size_t i = 0; i < page_count; i++) {
+        arena_page_deallocate_entire_page(&arena->pages[i]->page);
+        ALLOCATOR_INTERNAL_FREE(arena->pages[i]);
+    }
+    ALLOCATOR_INTERNAL_FREE(arena->pages);
+
+    struct concurrent_arena_cache* cache = atomic_load(&arena->caches);
+    while (cache) {
+        struct concurrent_arena_cache* next = cache->next;
+        ALLOCATOR_INTERNAL_FREE(cache->page_ids);
+        ALLOCATOR_INTERNAL_FREE(cache);
+        cache = next;
+    }
+
+    // a fresh id is assigned on next use so that stale thread cache slots never match
+    //
+    arena->pages = NULL;
+    atomic_store(&arena->page_count, 0);
+    atomic_store(&arena->caches, NULL);
+    atomic_store(&arena->id, 0);
+}
+
+static void
+concurrent_arena_reset(struct concurrent_arena* arena)
+{
+    ALLOCATOR_ASSERT(arena);
+
+    const size_t page_count = atomic_load(&arena->page_count);
+    for (size_t i = 0; i < page_count; i++) {
+        arena_page_reset(&arena->pages[i]->page);
+    }
+    for (struct concurrent_arena_cache* cache = atomic_load(&arena->caches); cache;
+         cache                                = cache->next) {
+        atomic_store(&cache->remote_frees, NULL);
+    }
+}
+
+// Scratch pages begin with a gap the size of an allocation head and a DEFAULT_PLUS node.
+// Allocators earlier in a fallback chain read what is in front of a pointer to decide
+// ownership, so those reads have to stay inside the page even for the first scratch allocation.
+//
+static AllocatorBlock*
+scratch_page_start(const struct scratch_page* page)
+{
+    return page->memory + HEADLESS_GAP_BLOCK_COUNT;
+}
+
+static size_t
+scratch_page_block_capacity(size_t page_size)
+{
+    const size_t block_count = page_size / sizeof(AllocatorBlock);
+    return (block_count > HEADLESS_GAP_BLOCK_COUNT) ? block_count - HEADLESS_GAP_BLOCK_COUNT : 0;
+}
+
+static struct scratch_page*
+scratch_current_page(struct scratch_arena* scratch)
+{
+    if (scratch->page_index < scratch->page_count) {
+        return &scratch->pages[scratch->page_index];
+    }
+    return NULL;
+}
+
+// returns the page holding `ptr` if it lies within memory handed out by the scratch arena
+//
+static struct scratch_page*
+scratch_find_owning_page(const struct scratch_arena* scratch, const void* ptr)
+{
+    ALLOCATOR_ASSERT(scratch);
+
+    const AllocatorBlock* blockview = ptr;
+    for (size_t i = 0; i <= scratch->page_index && i < scratch->page_count; i++) {
+        struct scratch_page* page = &scratch->pages[i];
+        if (blockview >= scratch_page_start(page) && blockview < page->head) {
+            return page;
+        }
+    }
+    return NULL;
+}
+
+// moves on to the next page, reusing one that was kept by a rewind/reset when possible
+//
+static struct scratch_page*
+scratch_advance_page(struct scratch_arena* scratch)
+{
+    const size_t next_index = (scratch->page_count) ? scratch->page_index + 1 : 0;
+
+    if (next_index == scratch->page_count) {
+        scratch->page_count += 1;
+        scratch->pages = ALLOCATOR_INTERNAL_REALLOC(
+            scratch->pages, sizeof *scratch->pages * scratch->page_count
+        );
+        if (!scratch->pages) {
+            ALLOCATOR_ABORT("scratch allocator failed to allocate page");
+        }
+        AllocatorBlock* memory = ALLOCATOR_INTERNAL_MALLOC(scratch->page_size);
+        if (!memory) {
+            ALLOCATOR_ABORT("scratch allocator failed to allocate page");
+        }
+        scratch->pages[next_index] = (struct scratch_page){
+            .memory = memory,
+            .end    = memory + scratch->page_size / sizeof *memory,
+        };
+    }
+
+    struct scratch_page* page = &scratch->pages[next_index];
+    page->head                = scratch_page_start(page);
+    scratch->page_index       = next_index;
+    scratch->last             = NULL;
+    return page;
+}
+
+static void*
+scratch_malloc(struct scratch_arena* scratch, size_t size)
+{
+    ALLOCATOR_ASSERT(scratch);
+    ALLOCATOR_ASSERT(size);
+
+    const size_t         block_count = blocks_required_for_size(size);
+    struct scratch_page* page        = scratch_current_page(scratch);
+
+    if (!page || block_count > (size_t)(page->end - page->head)) {
+        if (block_count > scratch_page_block_capacity(scratch->page_size)) {
+            return NULL;
+        }
+        page = scratch_advance_page(scratch);
+    }
+
+    scratch->last = page->head;
+    page->head += block_count;
+    return scratch->last;
+}
+
+// only the most recent allocation can be given back individually
+//
+static void
+scratch_free(struct scratch_arena* scratch, void* ptr)
+{
+    ALLOCATOR_ASSERT(scratch);
+
+    if (ptr && ptr == scratch->last) {
+        scratch_current_page(scratch)->head = scratch->last;
+        scratch->last                       = NULL;
+    }
+}
+
+// resizes in place when `ptr` is the most recent allocation and the page has room
+//
+static void*
+scratch_realloc(struct scratch_arena* scratch, void* ptr, size_t size)
+{
+    ALLOCATOR_ASSERT(scratch);
+    ALLOCATOR_ASSERT(ptr);
+    ALLOCATOR_ASSERT(size);
+
+    if (ptr != scratch->last) {
+        return NULL;
+    }
+    struct scratch_page* page        = scratch_current_page(scratch);
+    const size_t         block_count = blocks_required_for_size(size);
+    if (block_count > (size_t)(page->end - scratch->last)) {
+        return NULL;
+    }
+    page->head = scratch->last + block_count;
+    return ptr;
+}
+
+// Allocations carry no size, so this is the distance to the end of the used part of the page,
+// which is never smaller than the allocation itself.
+//
+static size_t
+scratch_usable_size(const struct scratch_arena* scratch, const void* ptr)
+{
+    const struct scratch_page* page = scratch_find_owning_page(scratch, ptr);
+    ALLOCATOR_ASSERT(page);
+    return (size_t)(page->head - (const AllocatorBlock*)ptr) * sizeof *page->head;
+}
+
+static void
+scratch_reset(struct scratch_arena* scratch)
+{
+    ALLOCATOR_ASSERT(scratch);
+
+    scratch->page_index = 0;
+    scratch->last       = NULL;
+    if (scratch->page_count) {
+        scratch->pages[0].head = scratch_page_start(&scratch->pages[0]);
+    }
+}
+
+static void
+scratch_destroy(struct scratch_arena* scratch)
+{
+    ALLOCATOR_ASSERT(scratch);
+
+    for (size_t i = 0; i < scratch->page_count; i++) {
+        ALLOCATOR_INTERNAL_FREE(scratch->pages[i].memory);
+    }
+    ALLOCATOR_INTERNAL_FREE(scratch->pages);
+    *scratch = (struct scratch_arena){.page_size = scratch->page_size};
+}
+
+static size_t
+pool_object_block_count(const struct pool* pool)
+{
+    const size_t block_count = blocks_required_for_size(pool->object_size);
+    return (block_count) ? block_count : 1;
+}
+
+// slabs reserve the same gap in front of their first object as scratch pages do
+//
+static AllocatorBlock*
+pool_slab_start(const struct pool_slab* slab)
+{
+    return slab->memory + HEADLESS_GAP_BLOCK_COUNT;
+}
+
+static struct pool_slab*
+pool_find_owning_slab(const struct pool* pool, const void* ptr)
+{
+    ALLOCATOR_ASSERT(pool);
+
+    const AllocatorBlock* blockview = ptr;
+    size_t                low       = 0;
+    size_t                high      = pool->slab_count;
+    while (low < high) {
+        const size_t      middle = low + (high - low) / 2;
+        struct pool_slab* slab   = &pool->slabs[middle];
+        if (blockview < pool_slab_start(slab)) {
+            high = middle;
+        }
+        else if (blockview >= slab->end) {
+            low = middle + 1;
+        }
+        else {
+            return slab;
+        }
+    }
+    return NULL;
+}
+
+static void
+pool_add_slab(struct pool* pool)
+{
+    const size_t object_block_count = pool_object_block_count(pool);
+    const size_t slab_block_count   = pool->slab_size / sizeof(AllocatorBlock);
+    if (slab_block_count < HEADLESS_GAP_BLOCK_COUNT + object_block_count) {
+        ALLOCATOR_ABORT("pool slab is too small to hold an object");
+    }
+    const size_t object_count =
+        (slab_block_count - HEADLESS_GAP_BLOCK_COUNT) / object_block_count;
+
+    AllocatorBlock* memory = ALLOCATOR_INTERNAL_MALLOC(pool->slab_size);
+    if (!memory) {
+        ALLOCATOR_ABORT("pool allocator failed to allocate slab");
+    }
+    pool->slabs =
+        ALLOCATOR_INTERNAL_REALLOC(pool->slabs, sizeof *pool->slabs * (pool->slab_count + 1));
+    if (!pool->slabs) {
+        ALLOCATOR_ABORT("pool allocator failed to allocate slab");
+    }
+
+    const struct pool_slab slab = {
+        .memory = memory,
+        .end    = memory + HEADLESS_GAP_BLOCK_COUNT + object_count * object_block_count,
+    };
+
+    size_t index = pool->slab_count;
+    while (index > 0 && pool->slabs[index - 1].memory > memory) {
+        index--;
+    }
+    memmove(
+        pool->slabs + index + 1,
+        pool->slabs + index,
+        sizeof *pool->slabs * (pool->slab_count - index)
+    );
+    pool->slabs[index] = slab;
+    pool->slab_count += 1;
+
+    pool->fresh     = pool_slab_start(&slab);
+    pool->fresh_end = slab.end;
+}
+
+static void*
+pool_malloc(struct pool* pool, size_t size)
+{
+    ALLOCATOR_ASSERT(pool);
+    ALLOCATOR_ASSERT(size);
+
+    if (size > pool->object_size) {
+        return NULL;
+    }
+
+    void* object = pool->free_list;
+    if (object) {
+        pool->free_list = *(void**)object;
+        return object;
+    }
+
+    if (pool->fresh == pool->fresh_end) {
+        pool_add_slab(pool);
+    }
+    object = pool->fresh;
+    pool->fresh += pool_object_block_count(pool);
+    return object;
+}
+
+static void
+pool_free(struct pool* pool, void* ptr)
+{
+    ALLOCATOR_ASSERT(pool);
+    ALLOCATOR_ASSERT(ptr);
+
+    *(void**)ptr    = pool->free_list;
+    pool->free_list = ptr;
+}
+
+static void*
+pool_realloc(struct pool* pool, void* ptr, size_t size)
+{
+    ALLOCATOR_ASSERT(pool);
+    ALLOCATOR_ASSERT(ptr);
+
+    return (size <= pool->object_size) ? ptr : NULL;
+}
+
+// every object of every slab goes back to the free list
+//
+static void
+pool_reset(struct pool* pool)
+{
+    ALLOCATOR_ASSERT(pool);
+
+    const size_t object_block_count = pool_object_block_count(pool);
+    pool->free_list                 = NULL;
+    pool->fresh                     = NULL;
+    pool->fresh_end                 = NULL;
+    for (size_t i = 0; i < pool->slab_count; i++) {
+        struct pool_slab* slab = &pool->slabs[i];
+        for (AllocatorBlock* object = pool_slab_start(slab); object < slab->end;
+             object += object_block_count) {
+            pool_free(pool, object);
+        }
+    }
+}
+
+static void
+pool_destroy(struct pool* pool)
+{
+    ALLOCATOR_ASSERT(pool);
+
+    for (size_t i = 0; i < pool->slab_count; i++) {
+        ALLOCATOR_INTERNAL_FREE(pool->slabs[i].memory);
+    }
+    ALLOCATOR_INTERNAL_FREE(pool->slabs);
+    *pool = (struct pool){.object_size = pool->object_size, .slab_size = pool->slab_size};
+}
+
+// Every type except ALLOCATOR_SCRATCH and ALLOCATOR_POOL keeps a head in front of the pointer.
+// Reading it is safe for headerless pointers too, see `scratch_page_start`.
+//
 static bool
-allocator_owns_memory(struct allocator* allocator, struct allocation* a)
+allocator_owns_memory(struct allocator* allocator, const void* ptr)
 {
-    if (!allocator || !a) {
+    if (!allocator || !ptr) {
         return false;
     }
 
+    const struct allocation* a = allocation_view_from_application_pointer((void*)ptr);
+
     switch (allocator->type) {
         case ALLOCATOR_DEFAULT:
             return a->freelist_id == DEFAULT_ALLOCATOR_SPECIAL_FREELIST_ID;
         case ALLOCATOR_DEFAULT_PLUS:
-            return allocation_array_contains(&allocator->default_plus_allocations, a);
+            return default_plus_contains(&allocator->default_plus_allocations, a);
         case ALLOCATOR_ARENA:
-            for (size_t i = 0; i < allocator->arena.page_count; i++) {
-                if (arena_page_contains_allocation(&allocator->arena.pages[i], a)) {
-                    return true;
-                }
-            }
-            return false;
+            return arena_find_owning_page(&allocator->arena, a) != NULL;
         case ALLOCATOR_STATIC_ARENA:
             return arena_page_contains_allocation(&allocator->static_page, a);
+        case ALLOCATOR_CONCURRENT_ARENA:
+            return concurrent_arena_find_owning_page(&allocator->concurrent_arena, a) != NULL;
+        case ALLOCATOR_SCRATCH:
+            return scratch_find_owning_page(&allocator->scratch, ptr) != NULL;
+        case ALLOCATOR_POOL:
+            return pool_find_owning_slab(&allocator->pool, ptr) != NULL;
     }
 
     ALLOCATOR_ASSERT(0 && "unreachable");
+    return false;
 }
 
 static struct allocator*
-find_owning_allocator(struct allocator* root, struct allocation* a)
+find_owning_allocator(struct allocator* root, const void* ptr)
 {
     ALLOCATOR_ASSERT(root);
-    ALLOCATOR_ASSERT(a);
+    ALLOCATOR_ASSERT(ptr);
 
     struct allocator* current = root;
     while (current != NULL) {
-        if (allocator_owns_memory(current, a)) {
+        if (allocator_owns_memory(current, ptr)) {
             return current;
         }
         current = current->fallback;
@@ -607,6 +1683,76 @@ find_owning_allocator(struct allocator* root, struct allocation* a)
     return NULL;
 }
 
+// number of bytes that can be safely read starting from `ptr`
+//
+static size_t
+allocator_usable_size(struct allocator* allocator, void* ptr)
+{
+    if (allocator->type == ALLOCATOR_SCRATCH) {
+        return scratch_usable_size(&allocator->scratch, ptr);
+    }
+    if (allocator->type == ALLOCATOR_POOL) {
+        return pool_object_block_count(&allocator->pool) * sizeof(AllocatorBlock);
+    }
+    return allocation_get_actual_data_size(allocation_view_from_application_pointer(ptr));
+}
+
+// Aligned allocations are over-allocated from the regular API and the returned pointer is
+// preceded by a padding head which leads back to the real allocation:
+//
+//     block_count      - blocks from the real allocation to the aligned pointer
+//     prev_block_count - the requested alignment
+//     freelist_id      - ALIGNED_PADDING_FREELIST_ID
+//
+// Only the aligned entry points read the padding, the bytes in front of a pointer handed out
+// by a headerless allocator belong to its neighbour and can't tell an aligned pointer apart.
+//
+static const uint32_t ALIGNED_PADDING_FREELIST_ID = 0xFFFFFFFE;
+
+static bool
+alignment_is_valid(size_t alignment)
+{
+    return alignment && (alignment & (alignment - 1)) == 0 && alignment <= 0x80000000u;
+}
+
+// caller is responsible for ensuring the pointer came from the aligned entry points
+//
+static const struct allocation*
+aligned_padding_view(void* ptr)
+{
+    const struct allocation* padding = allocation_view_from_application_pointer(ptr);
+    ALLOCATOR_ASSERT(padding->freelist_id == ALIGNED_PADDING_FREELIST_ID);
+    ALLOCATOR_ASSERT(alignment_is_valid(padding->prev_block_count));
+    return padding;
+}
+
+// distance from `raw` to the first aligned address which leaves room for a padding head
+//
+static size_t
+aligned_padding_offset(const void* raw, size_t alignment)
+{
+    const uintptr_t first   = (uintptr_t)raw + sizeof(struct allocation);
+    const uintptr_t aligned = (first + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    return aligned - (uintptr_t)raw;
+}
+
+// writes the padding head in front of the first aligned address within `raw` which leaves
+// room for it
+//
+static void*
+aligned_padding_place(void* raw, size_t alignment)
+{
+    const size_t offset = aligned_padding_offset(raw, alignment);
+    void*        ptr    = (uint8_t*)raw + offset;
+
+    struct allocation* padding = allocation_view_from_application_pointer(ptr);
+    padding->block_count       = (uint32_t)(offset / sizeof(AllocatorBlock));
+    padding->prev_block_count  = (uint32_t)alignment;
+    padding->freelist_id       = ALIGNED_PADDING_FREELIST_ID;
+    padding->page_id           = 0;
+    return ptr;
+}
+
 void*
 allocator_malloc(struct allocator* allocator, size_t size)
 {
@@ -617,7 +1763,11 @@ allocator_malloc(struct allocator* allocator, size_t size)
         allocator = &default_allocator;
     }
 
-    struct allocation* a = NULL;
+    ALLOCATOR_COUNT(allocator, malloc_count, 1);
+    ALLOCATOR_COUNT(allocator, bytes_requested, size);
+
+    struct allocation* a   = NULL;
+    void*              ptr = NULL;
 
     switch (allocator->type) {
         case ALLOCATOR_DEFAULT: {
@@ -636,12 +1786,28 @@ allocator_malloc(struct allocator* allocator, size_t size)
             a = arena_malloc(&allocator->arena, size);
             break;
         }
+        case ALLOCATOR_CONCURRENT_ARENA: {
+            a = concurrent_arena_malloc(&allocator->concurrent_arena, size);
+            break;
+        }
+        case ALLOCATOR_SCRATCH: {
+            ptr = scratch_malloc(&allocator->scratch, size);
+            break;
+        }
+        case ALLOCATOR_POOL: {
+            ptr = pool_malloc(&allocator->pool, size);
+            break;
+        }
     }
 
     if (a) {
         return a->blocks;
     }
+    else if (ptr) {
+        return ptr;
+    }
     else if (allocator->fallback) {
+        ALLOCATOR_COUNT(allocator, fallback_count, 1);
         return allocator_malloc(allocator->fallback, size);
     }
     return NULL;
@@ -682,12 +1848,25 @@ allocator_copy(struct allocator* allocator, const void* ptr, size_t size)
 // assumes caller has validated that this memory is owned by this allocator
 //
 static void
-allocator_free_internal(struct allocator* allocator, struct allocation* a)
+allocator_free_internal(struct allocator* allocator, void* ptr)
 {
     if (!allocator) {
         allocator = &default_allocator;
     }
 
+    ALLOCATOR_COUNT(allocator, free_count, 1);
+
+    if (allocator->type == ALLOCATOR_SCRATCH) {
+        scratch_free(&allocator->scratch, ptr);
+        return;
+    }
+    if (allocator->type == ALLOCATOR_POOL) {
+        pool_free(&allocator->pool, ptr);
+        return;
+    }
+
+    struct allocation* a = allocation_view_from_application_pointer(ptr);
+
     switch (allocator->type) {
         case ALLOCATOR_DEFAULT:
             default_free(a);
@@ -699,13 +1878,14 @@ allocator_free_internal(struct allocator* allocator, struct allocation* a)
             arena_page_free_allocation(&allocator->static_page, a);
             return;
         case ALLOCATOR_ARENA:
-            for (size_t i = 0; i < allocator->arena.page_count; i++) {
-                if (arena_page_contains_allocation(&allocator->arena.pages[i], a)) {
-                    arena_page_free_allocation(&allocator->arena.pages[i], a);
-                    return;
-                }
-            }
+            arena_free(&allocator->arena, a);
+            return;
+        case ALLOCATOR_CONCURRENT_ARENA:
+            concurrent_arena_free(&allocator->concurrent_arena, a);
             return;
+        case ALLOCATOR_SCRATCH:
+        case ALLOCATOR_POOL:
+            break;
     }
     ALLOCATOR_ASSERT(0 && "unreachable");
 }
@@ -720,12 +1900,11 @@ allocator_free(struct allocator* allocator, void* ptr)
         allocator = &default_allocator;
     }
 
-    struct allocation* a                = allocation_view_from_application_pointer(ptr);
-    struct allocator*  owning_allocator = find_owning_allocator(allocator, a);
+    struct allocator* owning_allocator = find_owning_allocator(allocator, ptr);
     if (!owning_allocator) {
         ALLOCATOR_ABORT("trying to free unrecognized pointer");
     }
-    allocator_free_internal(owning_allocator, a);
+    allocator_free_internal(owning_allocator, ptr);
 }
 
 void*
@@ -742,12 +1921,12 @@ allocator_realloc(struct allocator* allocator, void* ptr, size_t size)
         return allocator_malloc(allocator, size);
     }
 
-    struct allocation* a                = allocation_view_from_application_pointer(ptr);
-    struct allocator*  owning_allocator = find_owning_allocator(allocator, a);
+    struct allocator* owning_allocator = find_owning_allocator(allocator, ptr);
     if (!owning_allocator) {
         ALLOCATOR_ABORT("passing unknown pointer to allocator for reallocation");
     }
 
+    struct allocation* a      = allocation_view_from_application_pointer(ptr);
     struct allocation* result = NULL;
 
     switch (owning_allocator->type) {
@@ -767,24 +1946,427 @@ allocator_realloc(struct allocator* allocator, void* ptr, size_t size)
             result = arena_realloc(&owning_allocator->arena, a, size);
             break;
         }
+        case ALLOCATOR_CONCURRENT_ARENA: {
+            result = concurrent_arena_realloc(&owning_allocator->concurrent_arena, a, size);
+            break;
+        }
+        case ALLOCATOR_SCRATCH: {
+            void* in_place = scratch_realloc(&owning_allocator->scratch, ptr, size);
+            if (in_place) {
+                ALLOCATOR_COUNT(owning_allocator, realloc_in_place_count, 1);
+                return in_place;
+            }
+            break;
+        }
+        case ALLOCATOR_POOL: {
+            void* in_place = pool_realloc(&owning_allocator->pool, ptr, size);
+            if (in_place) {
+                ALLOCATOR_COUNT(owning_allocator, realloc_in_place_count, 1);
+                return in_place;
+            }
+            break;
+        }
     }
 
+    if (result == a) {
+        ALLOCATOR_COUNT(owning_allocator, realloc_in_place_count, 1);
+        return result->blocks;
+    }
     if (result) {
+        ALLOCATOR_COUNT(owning_allocator, realloc_copy_count, 1);
         return result->blocks;
     }
 
     // failed to reallocate, but we can try making a fresh allocation from the root allocator
+    // (the usable size is taken first, a scratch allocation can't be measured after the bump)
+    //
+    const size_t mem_data_size = allocator_usable_size(owning_allocator, ptr);
+    void*        new           = allocator_malloc(allocator, size);
+    if (!new) {
+        return NULL;
+    }
+    memcpy(new, ptr, (mem_data_size < size) ? mem_data_size : size);
+    allocator_free_internal(owning_allocator, ptr);
+    ALLOCATOR_COUNT(owning_allocator, realloc_copy_count, 1);
+    return new;
+}
+
+void*
+allocator_malloc_aligned(struct allocator* allocator, size_t size, size_t alignment)
+{
+    if (!alignment_is_valid(alignment)) {
+        ALLOCATOR_ABORT("alignment must be a power of two");
+    }
+    if (!size || size > SIZE_MAX - alignment - sizeof(struct allocation)) {
+        return NULL;
+    }
+
+    void* raw = allocator_malloc(allocator, size + alignment + sizeof(struct allocation));
+    if (!raw) {
+        return NULL;
+    }
+    return aligned_padding_place(raw, alignment);
+}
+
+void*
+allocator_realloc_aligned(struct allocator* allocator, void* ptr, size_t size, size_t alignment)
+{
+    if (!alignment_is_valid(alignment)) {
+        ALLOCATOR_ABORT("alignment must be a power of two");
+    }
+    if (!allocator) {
+        allocator = &default_allocator;
+    }
+    if (!size) {
+        allocator_free_aligned(allocator, ptr);
+        return NULL;
+    }
+    if (!ptr) {
+        return allocator_malloc_aligned(allocator, size, alignment);
+    }
+
+    const struct allocation* padding = aligned_padding_view(ptr);
+    void*                    raw     = (AllocatorBlock*)ptr - padding->block_count;
+    const size_t             offset  = padding->block_count * sizeof(AllocatorBlock);
+
+    struct allocator* owning_allocator = find_owning_allocator(allocator, raw);
+    if (!owning_allocator) {
+        ALLOCATOR_ABORT("passing unknown pointer to allocator for reallocation");
+    }
+    const size_t old_size = allocator_usable_size(owning_allocator, raw) - offset;
+
+    // The real allocation is resized with room for the worst case padding, so when it moves to
+    // an address which puts the data out of alignment the data is shifted within the new
+    // allocation rather than copied into yet another one (which could fail after the original
+    // has already been given back).
     //
-    void* new = allocator_malloc(allocator, size);
+    if (padding->prev_block_count == alignment) {
+        if (size > SIZE_MAX - alignment - sizeof(struct allocation)) {
+            return NULL;
+        }
+        void* new_raw =
+            allocator_realloc(allocator, raw, size + alignment + sizeof(struct allocation));
+        if (!new_raw) {
+            return NULL;
+        }
+        const size_t new_offset = aligned_padding_offset(new_raw, alignment);
+        if (new_offset != offset) {
+            memmove(
+                (uint8_t*)new_raw + new_offset,
+                (uint8_t*)new_raw + offset,
+                (old_size < size) ? old_size : size
+            );
+        }
+        return aligned_padding_place(new_raw, alignment);
+    }
+
+    void* new = allocator_malloc_aligned(allocator, size, alignment);
     if (!new) {
         return NULL;
     }
-    const size_t mem_data_size = allocation_get_actual_data_size(a);
-    memcpy(new, a->blocks, (mem_data_size < size) ? mem_data_size : size);
-    allocator_free_internal(owning_allocator, a);
+    memcpy(new, ptr, (old_size < size) ? old_size : size);
+    allocator_free_aligned(allocator, ptr);
     return new;
 }
 
+void
+allocator_free_aligned(struct allocator* allocator, void* ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    const struct allocation* padding = aligned_padding_view(ptr);
+    allocator_free(allocator, (AllocatorBlock*)ptr - padding->block_count);
+}
+
+struct allocator_mark
+allocator_mark(struct allocator* allocator)
+{
+    if (!allocator || allocator->type != ALLOCATOR_SCRATCH) {
+        ALLOCATOR_ABORT("allocator type does not support marks");
+    }
+
+    const struct scratch_page* page = scratch_current_page(&allocator->scratch);
+    return (struct allocator_mark){
+        .page_index = allocator->scratch.page_index,
+        .head       = (page) ? page->head : NULL,
+    };
+}
+
+void
+allocator_rewind(struct allocator* allocator, struct allocator_mark mark)
+{
+    if (!allocator || allocator->type != ALLOCATOR_SCRATCH) {
+        ALLOCATOR_ABORT("allocator type does not support marks");
+    }
+
+    struct scratch_arena* scratch = &allocator->scratch;
+
+    // marked before the first page existed
+    //
+    if (!mark.head) {
+        scratch_reset(scratch);
+        return;
+    }
+
+    if (mark.page_index > scratch->page_index) {
+        ALLOCATOR_ABORT("rewinding to a mark which is no longer valid");
+    }
+    struct scratch_page* page = &scratch->pages[mark.page_index];
+    if (mark.head < scratch_page_start(page) || mark.head > page->end ||
+        (mark.page_index == scratch->page_index && mark.head > page->head)) {
+        ALLOCATOR_ABORT("rewinding to a mark which is no longer valid");
+    }
+
+    // pages past the mark are left as they are, their heads are reset when bumped into again
+    //
+    page->head          = mark.head;
+    scratch->page_index = mark.page_index;
+    scratch->last       = NULL;
+}
+
+void
+allocator_reset(struct allocator* allocator)
+{
+    if (!allocator) {
+        return;
+    }
+
+    allocator_reset(allocator->fallback);
+
+    switch (allocator->type) {
+        case ALLOCATOR_DEFAULT:
+            ALLOCATOR_ABORT("default allocator cannot be reset");
+        case ALLOCATOR_DEFAULT_PLUS:
+            default_plus_free_all(&allocator->default_plus_allocations);
+            return;
+        case ALLOCATOR_STATIC_ARENA:
+            arena_page_reset(&allocator->static_page);
+            return;
+        case ALLOCATOR_ARENA:
+            for (size_t i = 0; i < allocator->arena.page_count; i++) {
+                struct arena_page* page = &allocator->arena.pages[i];
+                if (page->memory && page->dedicated) {
+                    arena_page_deallocate_entire_page(page);
+                }
+                arena_page_reset(page);
+            }
+            allocator->arena.recent_page_index = 0;
+            return;
+        case ALLOCATOR_CONCURRENT_ARENA:
+            concurrent_arena_reset(&allocator->concurrent_arena);
+            return;
+        case ALLOCATOR_SCRATCH:
+            scratch_reset(&allocator->scratch);
+            return;
+        case ALLOCATOR_POOL:
+            pool_reset(&allocator->pool);
+            return;
+    }
+
+    ALLOCATOR_ASSERT(0 && "unreachable");
+}
+
+void
+allocator_trim(struct allocator* allocator)
+{
+    if (!allocator) {
+        return;
+    }
+
+    allocator_trim(allocator->fallback);
+
+    if (allocator->type == ALLOCATOR_ARENA) {
+        arena_trim(&allocator->arena);
+    }
+    else if (allocator->type == ALLOCATOR_CONCURRENT_ARENA) {
+        concurrent_arena_trim(&allocator->concurrent_arena);
+    }
+}
+
+static void
+arena_page_collect_stats(const struct arena_page* page, struct allocator_page_stats* stats)
+{
+    *stats = (struct allocator_page_stats){0};
+    if (!page->memory) {
+        return;
+    }
+    stats->reserved_bytes = arena_page_memory_size(page);
+
+    const struct allocation* a = (const struct allocation*)page->memory;
+    while ((AllocatorBlock*)a < page->head) {
+        const size_t bytes =
+            (ALLOCATION_HEAD_BLOCK_COUNT + a->block_count) * sizeof(AllocatorBlock);
+        if (arena_page_freelist_contains(page, a)) {
+            stats->freelist_count += 1;
+            if (bytes > stats->largest_free_bytes) stats->largest_free_bytes = bytes;
+        }
+        else {
+            stats->live_count += 1;
+            stats->used_bytes += bytes;
+        }
+        a = allocation_next(a);
+    }
+
+    const size_t untouched_bytes = (size_t)(page->end - page->head) * sizeof(AllocatorBlock);
+    if (untouched_bytes > stats->largest_free_bytes) stats->largest_free_bytes = untouched_bytes;
+}
+
+static void
+scratch_collect_page_stats(
+    const struct scratch_arena* scratch, size_t page_index, struct allocator_page_stats* stats
+)
+{
+    const struct scratch_page* page = &scratch->pages[page_index];
+    const AllocatorBlock*      head = page->head;
+    if (page_index > scratch->page_index) {
+        head = scratch_page_start(page);  // unused, the head is only reset once bumped into
+    }
+    *stats = (struct allocator_page_stats){
+        .reserved_bytes     = scratch->page_size,
+        .used_bytes         = (size_t)(head - scratch_page_start(page)) * sizeof(AllocatorBlock),
+        .largest_free_bytes = (size_t)(page->end - head) * sizeof(AllocatorBlock),
+    };
+}
+
+static void
+pool_collect_slab_stats(
+    const struct pool* pool, size_t slab_index, struct allocator_page_stats* stats
+)
+{
+    const struct pool_slab* slab         = &pool->slabs[slab_index];
+    const size_t            object_bytes = pool_object_block_count(pool) * sizeof(AllocatorBlock);
+
+    // objects never handed out, only the newest slab has any
+    //
+    size_t fresh_count = 0;
+    if (pool->fresh >= pool_slab_start(slab) && pool->fresh < slab->end) {
+        fresh_count = (size_t)(slab->end - pool->fresh) * sizeof(AllocatorBlock) / object_bytes;
+    }
+
+    size_t free_count = 0;
+    for (void* object = pool->free_list; object; object = *(void**)object) {
+        if (pool_find_owning_slab(pool, object) == slab) free_count += 1;
+    }
+
+    const size_t object_count =
+        (size_t)(slab->end - pool_slab_start(slab)) * sizeof(AllocatorBlock) / object_bytes;
+    *stats = (struct allocator_page_stats){
+        .reserved_bytes     = pool->slab_size,
+        .used_bytes         = (object_count - fresh_count - free_count) * object_bytes,
+        .live_count         = object_count - fresh_count - free_count,
+        .freelist_count     = free_count,
+        .largest_free_bytes = (free_count + fresh_count) ? object_bytes : 0,
+    };
+}
+
+static size_t
+allocator_page_count(struct allocator* allocator)
+{
+    switch (allocator->type) {
+        case ALLOCATOR_DEFAULT:
+        case ALLOCATOR_DEFAULT_PLUS:
+            return 0;
+        case ALLOCATOR_STATIC_ARENA:
+            return 1;
+        case ALLOCATOR_ARENA:
+            return allocator->arena.page_count;
+        case ALLOCATOR_CONCURRENT_ARENA:
+            return atomic_load(&allocator->concurrent_arena.page_count);
+        case ALLOCATOR_SCRATCH:
+            return allocator->scratch.page_count;
+        case ALLOCATOR_POOL:
+            return allocator->pool.slab_count;
+    }
+    ALLOCATOR_ASSERT(0 && "unreachable");
+    return 0;
+}
+
+bool
+allocator_page_stats(
+    struct allocator* allocator, size_t page_index, struct allocator_page_stats* stats
+)
+{
+    if (!allocator) {
+        allocator = &default_allocator;
+    }
+    ALLOCATOR_ASSERT(stats);
+
+    if (page_index >= allocator_page_count(allocator)) {
+        return false;
+    }
+
+    switch (allocator->type) {
+        case ALLOCATOR_DEFAULT:
+        case ALLOCATOR_DEFAULT_PLUS:
+            break;
+        case ALLOCATOR_STATIC_ARENA:
+            arena_page_collect_stats(&allocator->static_page, stats);
+            return true;
+        case ALLOCATOR_ARENA:
+            arena_page_collect_stats(&allocator->arena.pages[page_index], stats);
+            return true;
+        case ALLOCATOR_CONCURRENT_ARENA:
+            arena_page_collect_stats(&allocator->concurrent_arena.pages[page_index]->page, stats);
+            return true;
+        case ALLOCATOR_SCRATCH:
+            scratch_collect_page_stats(&allocator->scratch, page_index, stats);
+            return true;
+        case ALLOCATOR_POOL:
+            pool_collect_slab_stats(&allocator->pool, page_index, stats);
+            return true;
+    }
+    ALLOCATOR_ASSERT(0 && "unreachable");
+    return false;
+}
+
+struct allocator_stats
+allocator_stats(struct allocator* allocator)
+{
+    if (!allocator) {
+        allocator = &default_allocator;
+    }
+
+    const struct allocator_counters* counters = &allocator->counters;
+    struct allocator_stats           stats    = {
+        .page_count             = allocator_page_count(allocator),
+        .malloc_count           = atomic_load(&counters->malloc_count),
+        .free_count             = atomic_load(&counters->free_count),
+        .bytes_requested        = atomic_load(&counters->bytes_requested),
+        .fallback_count         = atomic_load(&counters->fallback_count),
+        .realloc_in_place_count = atomic_load(&counters->realloc_in_place_count),
+        .realloc_copy_count     = atomic_load(&counters->realloc_copy_count),
+    };
+
+    // default plus allocations aren't kept in pages but are tracked individually
+    //
+    if (allocator->type == ALLOCATOR_DEFAULT_PLUS) {
+        const struct default_plus_list* list = &allocator->default_plus_allocations;
+        for (const struct default_plus_node* node = list->head; node; node = node->next) {
+            const size_t bytes =
+                default_plus_total_size(default_plus_allocation_of(node)->block_count *
+                                        sizeof(AllocatorBlock));
+            stats.reserved_bytes += bytes;
+            stats.used_bytes += bytes;
+        }
+        stats.live_count = list->count;
+        return stats;
+    }
+
+    for (size_t i = 0; i < stats.page_count; i++) {
+        struct allocator_page_stats page;
+        allocator_page_stats(allocator, i, &page);
+        stats.reserved_bytes += page.reserved_bytes;
+        stats.used_bytes += page.used_bytes;
+        stats.live_count += page.live_count;
+        stats.freelist_count += page.freelist_count;
+        if (page.largest_free_bytes > stats.largest_free_bytes) {
+            stats.largest_free_bytes = page.largest_free_bytes;
+        }
+    }
+    return stats;
+}
+
 void
 allocator_destroy(struct allocator* allocator)
 {
@@ -798,11 +2380,7 @@ allocator_destroy(struct allocator* allocator)
         case ALLOCATOR_DEFAULT:
             ALLOCATOR_ABORT("default allocator cannot be destroyed");
         case ALLOCATOR_DEFAULT_PLUS:
-            for (size_t i = 0; i < allocator->default_plus_allocations.count; i++) {
-                ALLOCATOR_INTERNAL_FREE(allocator->default_plus_allocations.allocations[i]);
-            }
-            ALLOCATOR_INTERNAL_FREE(allocator->default_plus_allocations.allocations);
-            allocator->default_plus_allocations = (struct allocation_array){0};
+            default_plus_free_all(&allocator->default_plus_allocations);
             return;
         case ALLOCATOR_STATIC_ARENA:
             arena_page_deallocate_entire_page(&allocator->static_page);
@@ -813,13 +2391,98 @@ allocator_destroy(struct allocator* allocator)
                 arena_page_deallocate_entire_page(&allocator->arena.pages[i]);
             }
             ALLOCATOR_INTERNAL_FREE(allocator->arena.pages);
-            allocator->arena = (struct arena){0};
+            allocator->arena = (struct arena){.flags = allocator->arena.flags};
+            return;
+        case ALLOCATOR_CONCURRENT_ARENA:
+            concurrent_arena_destroy(&allocator->concurrent_arena);
+            return;
+        case ALLOCATOR_SCRATCH:
+            scratch_destroy(&allocator->scratch);
+            return;
+        case ALLOCATOR_POOL:
+            pool_destroy(&allocator->pool);
             return;
     }
 
     ALLOCATOR_ASSERT(0 && "unreachable");
 }
 
+#ifdef _WIN32
+
+static void*
+platform_map_pages(size_t size, bool huge_pages)
+{
+    void* memory = NULL;
+    if (huge_pages) {
+        const SIZE_T large_page_size = GetLargePageMinimum();
+        if (large_page_size && size % large_page_size == 0) {
+            memory = VirtualAlloc(
+                NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE
+            );
+        }
+    }
+    if (!memory) {
+        memory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    return memory;
+}
+
+static void
+platform_unmap_pages(void* memory, size_t size)
+{
+    (void)size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+static void
+platform_release_pages(void* memory, size_t size)
+{
+    VirtualAlloc(memory, size, MEM_RESET, PAGE_READWRITE);
+}
+
+#else
+
+static void*
+platform_map_pages(size_t size, bool huge_pages)
+{
+    void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+        memory = mmap(
+            NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+        );
+    }
+#endif
+    if (memory == MAP_FAILED) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return NULL;
+        }
+        // no huge pages reserved, transparent huge pages are the next best thing
+        //
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            madvise(memory, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    return memory;
+}
+
+static void
+platform_unmap_pages(void* memory, size_t size)
+{
+    munmap(memory, size);
+}
+
+static void
+platform_release_pages(void* memory, size_t size)
+{
+    madvise(memory, size, MADV_DONTNEED);
+}
+
+#endif
+
 /*
 ==============================================================================
 OPTION 1 (MIT)
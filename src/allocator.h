@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #ifndef ALLOCATOR_INTERNAL_MALLOC
 #include <stdlib.h>
@@ -30,6 +31,16 @@
 #define ALLOCATOR_STATIC_ASSERT static_assert
 #endif
 
+#ifndef ALLOCATOR_CONCURRENT_ARENA_MAX_PAGES
+#define ALLOCATOR_CONCURRENT_ARENA_MAX_PAGES 4096
+#endif
+
+// size mapped pages are rounded up to when using ARENA_HUGE_PAGES
+//
+#ifndef ALLOCATOR_HUGE_PAGE_SIZE
+#define ALLOCATOR_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#endif
+
 #ifndef ALLOCATOR_ABORT
 #include <stdlib.h>
 #include <stdio.h>
@@ -43,8 +54,10 @@
 typedef uint64_t AllocatorBlock;
 
 struct allocation {
-    uint32_t block_count;
-    uint32_t freelist_id;  // freelist index + 1, (0 is reserved for nodes not in the freelist)
+    uint32_t       block_count;
+    uint32_t       prev_block_count;  // boundary tag: block_count of the left neighbour in a page
+    uint32_t       freelist_id;  // freelist index + 1 (0 is reserved for nodes not in a freelist)
+    uint32_t       page_id;  // owning arena page index + 1, (0 when not owned by an arena page)
     AllocatorBlock blocks[];
 };
 
@@ -52,45 +65,200 @@ ALLOCATOR_STATIC_ASSERT(
     sizeof(struct allocation) % sizeof(AllocatorBlock) == 0, "allocation head unaligned"
 );
 
-struct allocation_array {
-    size_t              capacity;
-    size_t              count;
-    struct allocation** allocations;
+struct default_plus_list;
+
+// Every DEFAULT_PLUS allocation is preceded by a node which links it into its allocator's
+// list. Nodes point back at the list, so an allocator must not be moved while it holds
+// allocations.
+//
+struct default_plus_node {
+    struct default_plus_node* prev;
+    struct default_plus_node* next;
+    struct default_plus_list* owner;
+};
+
+struct default_plus_list {
+    struct default_plus_node* head;
+    size_t                    count;
 };
 
+// Free allocations within a page are kept in power-of-two size class bins (by block_count).
+// Each bin is an intrusive doubly linked list threaded through the first block of the free
+// allocations, using block offsets from the start of the page.
+//
+#define ARENA_PAGE_BIN_COUNT 32
+
 struct arena_page {
-    AllocatorBlock*         end;
-    AllocatorBlock*         head;
-    AllocatorBlock*         memory;
-    struct allocation_array freelist;
-    bool                    owns_memory;
+    AllocatorBlock* end;
+    AllocatorBlock* head;
+    AllocatorBlock* memory;
+    uint32_t        bin_bitmap;
+    uint32_t        bin_heads[ARENA_PAGE_BIN_COUNT];
+    bool            owns_memory;
+    bool            mapped;  // memory was mapped from the system rather than malloc'd
+    bool            dedicated;  // holds a single allocation larger than the arena's page size
 };
 
 struct arena_page arena_page_create_from_memory(void* memory, size_t size, bool page_owns_memory);
 
+// Arena pages are malloc'd by default. With ARENA_MAP_PAGES they are mapped from the system
+// instead (mmap/VirtualAlloc) so that memory is only committed when touched, and empty pages
+// can be handed back with `allocator_trim`. ARENA_HUGE_PAGES additionally rounds pages up to
+// ALLOCATOR_HUGE_PAGE_SIZE and asks for huge pages, falling back to regular pages if none are
+// available.
+//
+// Allocations which don't fit in `page_size` get a dedicated page of their own. Failing to
+// allocate or map a page fails the allocation (it's passed on to the fallback) rather than
+// aborting.
+//
+enum arena_flags {
+    ARENA_MAP_PAGES  = 1 << 0,
+    ARENA_HUGE_PAGES = 1 << 1,
+};
+
 struct arena {
     size_t             page_size;
+    unsigned           flags;  // arena_flags
     size_t             page_count;
+    size_t             recent_page_index;  // page most recently freed into, tried first on malloc
     struct arena_page* pages;
 };
 
+struct concurrent_arena_page;
+struct concurrent_arena_cache;
+
+// An arena which is safe to use from many threads at once. Each thread allocates from arena
+// pages held in its own cache, blocks freed by a thread which doesn't own the page are handed
+// back to the owning cache through a lock-free queue, and a lock is only taken to publish a
+// new page.
+//
+// A thread keeps its caches for as long as the arena lives, `allocator_destroy` must not be
+// called while other threads are still using the arena.
+//
+// Blocks handed back to another thread's cache are reclaimed the next time that thread
+// allocates from the arena. Blocks handed back to a thread which has exited (or won't allocate
+// again) wait, and are still counted as live by `allocator_stats`, until `allocator_trim` or
+// `allocator_reset` is called while no other thread is using the arena.
+//
+struct concurrent_arena {
+    size_t                         page_size;
+    _Atomic(uint64_t)              id;  // assigned on first use, identifies per-thread caches
+    atomic_bool                    page_lock;
+    _Atomic(size_t)                page_count;
+    struct concurrent_arena_page** pages;  // ALLOCATOR_CONCURRENT_ARENA_MAX_PAGES slots
+    _Atomic(struct concurrent_arena_cache*) caches;
+};
+
+// A bump allocator with no per-allocation header. Memory is given back in bulk by rewinding to
+// a mark or by resetting, and pages are kept for reuse until `allocator_destroy`. Freeing or
+// resizing the most recent allocation is done in place, any other free is ignored.
+//
+struct scratch_page {
+    AllocatorBlock* memory;
+    AllocatorBlock* head;
+    AllocatorBlock* end;
+};
+
+struct scratch_arena {
+    size_t               page_size;
+    size_t               page_count;
+    size_t               page_index;  // page currently bumped into, pages after it are unused
+    AllocatorBlock*      last;        // most recent allocation (NULL after a page change/rewind)
+    struct scratch_page* pages;
+};
+
+// Hands out objects of a single size carved from slabs. Objects carry no head, free objects
+// are kept in an intrusive singly linked list and requests for more than `object_size` bytes
+// are passed on to the fallback.
+//
+struct pool_slab {
+    AllocatorBlock* memory;
+    AllocatorBlock* end;
+};
+
+struct pool {
+    size_t            object_size;
+    size_t            slab_size;
+    size_t            slab_count;
+    void*             free_list;
+    AllocatorBlock*   fresh;  // objects of the newest slab which were never handed out
+    AllocatorBlock*   fresh_end;
+    struct pool_slab* slabs;  // sorted by address so ownership is a binary search
+};
+
+// Event counters are only maintained when allocator.c is built with ALLOCATOR_STATS defined,
+// otherwise they stay at zero and cost nothing on the hot paths.
+//
+struct allocator_counters {
+    _Atomic(uint64_t) malloc_count;
+    _Atomic(uint64_t) free_count;
+    _Atomic(uint64_t) bytes_requested;
+    _Atomic(uint64_t) fallback_count;  // mallocs passed on to the fallback
+    _Atomic(uint64_t) realloc_in_place_count;
+    _Atomic(uint64_t) realloc_copy_count;
+};
+
 struct allocator {
-    struct allocator* fallback;
+    struct allocator*         fallback;
+    struct allocator_counters counters;
 
     enum {
         ALLOCATOR_DEFAULT = 0,
         ALLOCATOR_DEFAULT_PLUS,
         ALLOCATOR_STATIC_ARENA,
         ALLOCATOR_ARENA,
+        ALLOCATOR_CONCURRENT_ARENA,
+        ALLOCATOR_SCRATCH,
+        ALLOCATOR_POOL,
     } type;
 
     union {
-        struct allocation_array default_plus_allocations;
-        struct arena_page       static_page;
-        struct arena            arena;
+        struct default_plus_list default_plus_allocations;
+        struct arena_page        static_page;
+        struct arena             arena;
+        struct concurrent_arena  concurrent_arena;
+        struct scratch_arena     scratch;
+        struct pool              pool;
     };
 };
 
+// A snapshot of the memory held by a single page (or slab) of an allocator. Byte counts include
+// allocation heads, `largest_free_bytes` also considers the untouched space at the end of a
+// page. Headerless allocators (SCRATCH) can't tell allocations apart and report
+// no live or freelist counts.
+//
+struct allocator_page_stats {
+    size_t reserved_bytes;
+    size_t used_bytes;
+    size_t live_count;
+    size_t freelist_count;
+    size_t largest_free_bytes;
+};
+
+// Totals for one allocator (not including its fallbacks) along with its event counters.
+//
+struct allocator_stats {
+    size_t   page_count;
+    size_t   reserved_bytes;
+    size_t   used_bytes;
+    size_t   live_count;
+    size_t   freelist_count;
+    size_t   largest_free_bytes;
+    uint64_t malloc_count;
+    uint64_t free_count;
+    uint64_t bytes_requested;
+    uint64_t fallback_count;
+    uint64_t realloc_in_place_count;
+    uint64_t realloc_copy_count;
+};
+
+// A checkpoint in a scratch allocator, see `allocator_mark`.
+//
+struct allocator_mark {
+    size_t          page_index;
+    AllocatorBlock* head;
+};
+
 void* allocator_malloc(struct allocator*, size_t size);
 void* allocator_calloc(struct allocator*, size_t count, size_t size);
 void* allocator_realloc(struct allocator*, void* ptr, size_t size);
@@ -98,6 +266,41 @@ void* allocator_copy(struct allocator*, const void* ptr, size_t size);
 void  allocator_free(struct allocator*, void* ptr);
 void  allocator_destroy(struct allocator*);
 
+// `alignment` must be a power of two. Aligned pointers may only be resized with
+// `allocator_realloc_aligned` and freed with `allocator_free_aligned` (which also gives back
+// the padding used to align them), the regular entry points don't recognize them.
+//
+void* allocator_malloc_aligned(struct allocator*, size_t size, size_t alignment);
+void* allocator_realloc_aligned(struct allocator*, void* ptr, size_t size, size_t alignment);
+void  allocator_free_aligned(struct allocator*, void* ptr);
+
+// `allocator_rewind` releases everything allocated from a scratch allocator since the mark was
+// taken, in constant time. Marks are only supported by ALLOCATOR_SCRATCH and only cover the
+// allocator's own memory (not its fallbacks).
+//
+struct allocator_mark allocator_mark(struct allocator*);
+void                  allocator_rewind(struct allocator*, struct allocator_mark mark);
+
+// Releases every allocation at once but keeps pages for reuse (the allocator and its
+// fallbacks remain usable afterwards). Not supported by ALLOCATOR_DEFAULT.
+//
+void allocator_reset(struct allocator*);
+
+// Returns the physical memory behind empty pages to the system where the allocator supports
+// it (ARENA with mapped pages). A CONCURRENT_ARENA instead collects the blocks freed to the
+// caches of other threads, the arena must not be in use by other threads while this runs. The
+// allocator and its fallbacks remain usable afterwards.
+//
+void allocator_trim(struct allocator*);
+
+// Walks the allocator's pages to build a snapshot, the cost grows with the number of
+// allocations so this isn't meant for hot paths. A concurrent arena must not be in use by
+// other threads while this runs. `allocator_page_stats` returns false for an out of range
+// page index.
+//
+struct allocator_stats allocator_stats(struct allocator*);
+bool allocator_page_stats(struct allocator*, size_t page_index, struct allocator_page_stats*);
+
 #define _ALLOCATOR_MACROVAR_CONCAT(a, b) a##b
 #define _ALLOCATOR_MACROVAR_CONCAT_INDIRECT(a, b) _ALLOCATOR_MACROVAR_CONCAT(a, b)
 #define _ALLOCATOR_MACROVAR(name) _ALLOCATOR_MACROVAR_CONCAT_INDIRECT(name, __LINE__)
@@ -134,6 +337,44 @@ void  allocator_destroy(struct allocator*);
         },                                                                                         \
     }
 
+#define MAPPED_ARENA_ALLOCATOR(allocator_variable, arena_page_size, arena_flags)                   \
+    allocator_variable = (struct allocator)                                                        \
+    {                                                                                              \
+        .type  = ALLOCATOR_ARENA,                                                                  \
+        .arena = {                                                                                 \
+            .page_size = (arena_page_size),                                                        \
+            .flags     = (arena_flags) | ARENA_MAP_PAGES,                                          \
+        },                                                                                         \
+    }
+
+#define CONCURRENT_ARENA_ALLOCATOR(allocator_variable, arena_page_size)                            \
+    allocator_variable = (struct allocator)                                                        \
+    {                                                                                              \
+        .type             = ALLOCATOR_CONCURRENT_ARENA,                                            \
+        .concurrent_arena = {                                                                      \
+            .page_size = (arena_page_size),                                                        \
+        },                                                                                         \
+    }
+
+#define SCRATCH_ALLOCATOR(allocator_variable, scratch_page_size)                                   \
+    allocator_variable = (struct allocator)                                                        \
+    {                                                                                              \
+        .type    = ALLOCATOR_SCRATCH,                                                              \
+        .scratch = {                                                                               \
+            .page_size = (scratch_page_size),                                                      \
+        },                                                                                         \
+    }
+
+#define POOL_ALLOCATOR(allocator_variable, pool_object_size, pool_slab_size)                       \
+    allocator_variable = (struct allocator)                                                        \
+    {                                                                                              \
+        .type = ALLOCATOR_POOL,                                                                    \
+        .pool = {                                                                                  \
+            .object_size = (pool_object_size),                                                     \
+            .slab_size   = (pool_slab_size),                                                       \
+        },                                                                                         \
+    }
+
 #define MALLOC_OR_ELSE(alloc_ptr, result_ptr, size)                                                \
     if (!((result_ptr) = allocator_malloc((alloc_ptr), (size))))
 
@@ -241,6 +482,84 @@ random_index(size_t array_length)
 
 #define CHOICE(array) ((array)[random_index(sizeof(array) / sizeof *(array))])
 
+#include <threads.h>
+
+#define CONCURRENT_TEST_THREAD_COUNT 4
+#define CONCURRENT_TEST_SLOT_COUNT 512
+
+struct concurrent_test {
+    struct allocator*          alloc;
+    _Atomic(struct int_array*) slots[CONCURRENT_TEST_SLOT_COUNT];
+};
+
+struct concurrent_test_thread {
+    struct concurrent_test* test;
+    unsigned int            seed;
+};
+
+static void
+assert_array_filled_with(const struct int_array* array, int fill)
+{
+    for (size_t i = 0; i < array->count; i++) {
+        TEST_ASSERT(array->data[i] == fill);
+    }
+}
+
+// Threads swap arrays in and out of shared slots so most frees land on a thread which did not
+// make the allocation.
+//
+static int
+concurrent_test_worker(void* arg)
+{
+    struct concurrent_test_thread* thread  = arg;
+    struct concurrent_test*        test    = thread->test;
+    unsigned int                   state   = thread->seed;
+    const size_t                   sizes[] = {1, 3, 8, 17, 60, 200};
+
+    for (int i = 0; i < 20000; i++) {
+        state             = state * 1103515245u + 12345u;
+        const int    slot = (int)((state >> 8) % CONCURRENT_TEST_SLOT_COUNT);
+        const size_t size = sizes[(state >> 20) % (sizeof sizes / sizeof *sizes)];
+
+        if (i % 4 == 0) {
+            struct int_array* taken = atomic_exchange(&test->slots[slot], NULL);
+            if (taken) {
+                assert_array_filled_with(taken, slot);
+                taken = reallocate_array(test->alloc, taken, size);
+                assert_array_filled_with(taken, slot);
+                taken = atomic_exchange(&test->slots[slot], taken);
+                allocator_free(test->alloc, taken);
+            }
+            continue;
+        }
+
+        struct int_array* old =
+            atomic_exchange(&test->slots[slot], allocate_array(test->alloc, slot, size));
+        if (old) {
+            assert_array_filled_with(old, slot);
+            allocator_free(test->alloc, old);
+        }
+    }
+    return 0;
+}
+
+struct concurrent_orphan_test {
+    struct allocator* alloc;
+    struct int_array* arrays[CONCURRENT_TEST_SLOT_COUNT];
+};
+
+// allocates and exits, leaving the frees to another thread
+//
+static int
+concurrent_orphan_worker(void* arg)
+{
+    struct concurrent_orphan_test* test = arg;
+    for (int i = 0; i < CONCURRENT_TEST_SLOT_COUNT; i++) {
+        test->arrays[i] = allocate_array(test->alloc, i, 1 + (size_t)i % 50);
+    }
+    return 0;
+}
+
 int
 main(void)
 {
@@ -283,6 +602,530 @@ main(void)
         allocator_destroy(&stackp);
     }
 
+    // default plus allocators can tell their allocations apart from each other's
+    //
+    {
+        struct allocator first;
+        DEFAULT_PLUS_ALLOCATOR(first);
+        struct allocator second;
+        DEFAULT_PLUS_ALLOCATOR(second);
+        first.fallback = &second;
+
+        struct int_array* arrays[64];
+        for (int i = 0; i < 64; i++) {
+            arrays[i] = allocate_array((i % 2) ? &second : &first, i, 10);
+        }
+        TEST_ASSERT(first.default_plus_allocations.count == 32);
+        TEST_ASSERT(second.default_plus_allocations.count == 32);
+
+        for (int i = 0; i < 64; i += 3) {
+            arrays[i] = reallocate_array(&first, arrays[i], 1000);
+        }
+        for (int i = 0; i < 64; i += 2) {
+            assert_array_filled_with(arrays[i], i);
+            allocator_free(&first, arrays[i]);
+        }
+        TEST_ASSERT(first.default_plus_allocations.count == 0);
+        TEST_ASSERT(second.default_plus_allocations.count == 32);
+
+        allocator_destroy(&first);
+        TEST_ASSERT(second.default_plus_allocations.head == NULL);
+    }
+
+    // freed neighbours are coalesced in both directions and given back to the page head
+    //
+    {
+        struct allocator alloc;
+        STACK_ALLOCATOR(alloc, 4096);
+        AllocatorBlock* start = alloc.static_page.head;
+
+        void* a;
+        void* b;
+        void* c;
+        void* d;
+        MALLOC(&alloc, a, 64);
+        MALLOC(&alloc, b, 64);
+        MALLOC(&alloc, c, 64);
+        MALLOC(&alloc, d, 64);
+
+        allocator_free(&alloc, a);
+        allocator_free(&alloc, c);
+        allocator_free(&alloc, b);  // joins both a (left) and c (right)
+
+        void* joined;
+        MALLOC(&alloc, joined, 3 * 64 + 2 * sizeof(struct allocation));
+        TEST_ASSERT(joined == a);
+
+        allocator_free(&alloc, joined);
+        allocator_free(&alloc, d);
+        TEST_ASSERT(alloc.static_page.head == start);
+        TEST_ASSERT(alloc.static_page.bin_bitmap == 0);
+    }
+
+    // a fit sitting behind a bin head too small for the request is still found
+    //
+    {
+        struct allocator alloc;
+        STACK_ALLOCATOR(alloc, 1024);
+
+        void* fits;
+        void* too_small;
+        void* separator;
+        MALLOC(&alloc, fits, 7 * sizeof(AllocatorBlock));
+        MALLOC(&alloc, separator, 1);
+        MALLOC(&alloc, too_small, 4 * sizeof(AllocatorBlock));
+        MALLOC(&alloc, separator, 1);
+
+        // fill the rest of the page so only the freelist can serve the request
+        //
+        while (allocator_malloc(&alloc, 1)) {
+        }
+
+        allocator_free(&alloc, fits);
+        allocator_free(&alloc, too_small);  // same bin as fits and now its head
+
+        void* found;
+        MALLOC(&alloc, found, 5 * sizeof(AllocatorBlock));
+        TEST_ASSERT(found == fits);
+    }
+
+    // arena spread over many pages with a fallback chain behind it
+    //
+    {
+        struct allocator stack;
+        STACK_ALLOCATOR_PLUS(stack, 256);
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 1024);
+        arena.fallback = stack.fallback;
+        stack.fallback = &arena;
+
+#define MANY_PAGES_COUNT 512
+        struct int_array* arrays[MANY_PAGES_COUNT];
+        for (int i = 0; i < MANY_PAGES_COUNT; i++) {
+            arrays[i] = allocate_array(&stack, i, (i % 7 == 0) ? 1000 : 60);
+        }
+        TEST_ASSERT(arena.arena.page_count > 100);
+
+        for (int i = 0; i < MANY_PAGES_COUNT; i += 2) {
+            arrays[i] = reallocate_array(&stack, arrays[i], 100);
+        }
+        for (int i = 0; i < MANY_PAGES_COUNT; i++) {
+            TEST_ASSERT(arrays[i]->data[0] == i);
+            allocator_free(&stack, arrays[i]);
+        }
+        for (size_t i = 0; i < arena.arena.page_count; i++) {
+            TEST_ASSERT(arena.arena.pages[i].head == arena.arena.pages[i].memory);
+        }
+
+        allocator_destroy(&stack);
+    }
+
+    // scratch allocator rewinds to marks and reuses its pages after a reset
+    //
+    {
+        struct allocator alloc;
+        SCRATCH_ALLOCATOR(alloc, 1024);
+
+        struct allocator_mark empty = allocator_mark(&alloc);
+        struct int_array*     first = allocate_array(&alloc, 1, 8);
+
+        struct allocator_mark mark = allocator_mark(&alloc);
+        for (int i = 0; i < 100; i++) {
+            allocate_array(&alloc, i, 30);
+        }
+        TEST_ASSERT(alloc.scratch.page_count > 10);
+        const size_t page_count = alloc.scratch.page_count;
+
+        allocator_rewind(&alloc, mark);
+        struct int_array* second = allocate_array(&alloc, 2, 8);
+        TEST_ASSERT(second == (void*)(first->data + 8));
+        assert_array_filled_with(first, 1);
+
+        // the most recent allocation grows and is freed in place
+        //
+        second = reallocate_array(&alloc, second, 16);
+        TEST_ASSERT(second == (void*)(first->data + 8));
+        allocator_free(&alloc, second);
+        TEST_ASSERT(allocate_array(&alloc, 3, 8) == (void*)(first->data + 8));
+
+        // an older allocation is copied when grown
+        //
+        struct int_array* moved = reallocate_array(&alloc, first, 64);
+        TEST_ASSERT(moved != first);
+        assert_array_filled_with(moved, 1);
+
+        allocator_rewind(&alloc, empty);
+        TEST_ASSERT(allocate_array(&alloc, 4, 8) == first);
+
+        for (int i = 0; i < 100; i++) {
+            allocate_array(&alloc, i, 30);
+        }
+        allocator_reset(&alloc);
+        TEST_ASSERT(allocate_array(&alloc, 5, 8) == first);
+        for (int i = 0; i < 100; i++) {
+            allocate_array(&alloc, i, 30);
+        }
+        TEST_ASSERT(alloc.scratch.page_count == page_count);
+
+        allocator_destroy(&alloc);
+    }
+
+    // scratch allocator in a fallback chain with headed allocators on either side
+    //
+    {
+        struct allocator stack;
+        STACK_ALLOCATOR_PLUS(stack, 256);
+        struct allocator scratch;
+        SCRATCH_ALLOCATOR(scratch, 512);
+        scratch.fallback = stack.fallback;
+        stack.fallback   = &scratch;
+
+        struct int_array* arrays[64];
+        for (int i = 0; i < 64; i++) {
+            arrays[i] = allocate_array(&stack, i, (i % 5 == 0) ? 200 : 20);
+        }
+        for (int i = 0; i < 64; i += 3) {
+            arrays[i] = reallocate_array(&stack, arrays[i], 40);
+        }
+        for (int i = 0; i < 64; i++) {
+            assert_array_filled_with(arrays[i], i);
+            allocator_free(&stack, arrays[i]);
+        }
+
+        allocator_reset(&stack);
+        TEST_ASSERT(stack.static_page.head == stack.static_page.memory);
+        TEST_ASSERT(scratch.scratch.page_index == 0);
+        allocator_destroy(&stack);
+    }
+
+    // pool allocator hands out fixed size objects and passes larger requests on
+    //
+    {
+        struct allocator fallback;
+        DEFAULT_PLUS_ALLOCATOR(fallback);
+        struct allocator pool;
+        POOL_ALLOCATOR(pool, sizeof(struct int_array) + 4 * sizeof(int), 512);
+        pool.fallback = &fallback;
+
+#define POOL_TEST_COUNT 200
+        struct int_array* arrays[POOL_TEST_COUNT];
+        for (int i = 0; i < POOL_TEST_COUNT; i++) {
+            arrays[i] = allocate_array(&pool, i, (i % 10 == 0) ? 50 : 4);
+        }
+        TEST_ASSERT(pool.pool.slab_count > 1);
+        TEST_ASSERT(fallback.default_plus_allocations.count == POOL_TEST_COUNT / 10);
+        for (size_t i = 1; i < pool.pool.slab_count; i++) {
+            TEST_ASSERT(pool.pool.slabs[i - 1].memory < pool.pool.slabs[i].memory);
+        }
+
+        // freed objects are reused, growing past the object size moves to the fallback
+        //
+        struct int_array* freed = arrays[1];
+        allocator_free(&pool, arrays[1]);
+        arrays[1] = allocate_array(&pool, 1, 2);
+        TEST_ASSERT(arrays[1] == freed);
+        arrays[2] = reallocate_array(&pool, arrays[2], 3);
+        arrays[3] = reallocate_array(&pool, arrays[3], 40);
+        TEST_ASSERT(fallback.default_plus_allocations.count == POOL_TEST_COUNT / 10 + 1);
+
+        for (int i = 0; i < POOL_TEST_COUNT; i++) {
+            assert_array_filled_with(arrays[i], i);
+            allocator_free(&pool, arrays[i]);
+        }
+        TEST_ASSERT(fallback.default_plus_allocations.count == 0);
+
+        const size_t slab_count = pool.pool.slab_count;
+        allocator_reset(&pool);
+        for (int i = 0; i < POOL_TEST_COUNT - POOL_TEST_COUNT / 10; i++) {
+            arrays[i] = allocate_array(&pool, i, 4);
+        }
+        TEST_ASSERT(pool.pool.slab_count == slab_count);
+
+        allocator_destroy(&pool);
+    }
+
+    // aligned allocations across allocator types, padding is given back on free
+    //
+    {
+        struct allocator stack;
+        STACK_ALLOCATOR(stack, 16 * 1024);
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 16 * 1024);
+        struct allocator plus;
+        DEFAULT_PLUS_ALLOCATOR(plus);
+        struct allocator scratch;
+        SCRATCH_ALLOCATOR(scratch, 16 * 1024);
+
+        struct allocator* allocators[] = {NULL, &plus, &stack, &arena, &scratch};
+        const size_t      alignments[] = {8, 16, 32, 64, 256, 4096};
+
+        for (size_t i = 0; i < sizeof allocators / sizeof *allocators; i++) {
+            for (size_t j = 0; j < sizeof alignments / sizeof *alignments; j++) {
+                const size_t      alignment = alignments[j];
+                const size_t      size      = sizeof(struct int_array) + 5 * sizeof(int);
+                struct int_array* array = allocator_malloc_aligned(allocators[i], size, alignment);
+                TEST_ASSERT(array);
+                TEST_ASSERT((uintptr_t)array % alignment == 0);
+                array->count = 5;
+                for (size_t k = 0; k < 5; k++) {
+                    array->data[k] = (int)j;
+                }
+
+                array = allocator_realloc_aligned(
+                    allocators[i], array, sizeof *array + 100 * sizeof(int), alignment
+                );
+                TEST_ASSERT((uintptr_t)array % alignment == 0);
+                for (size_t k = 0; k < 5; k++) {
+                    TEST_ASSERT(array->data[k] == (int)j);
+                }
+
+                array = allocator_realloc_aligned(
+                    allocators[i], array, sizeof *array + 2 * sizeof(int), alignment
+                );
+                TEST_ASSERT((uintptr_t)array % alignment == 0);
+                TEST_ASSERT(array->data[0] == (int)j && array->data[1] == (int)j);
+                allocator_free_aligned(allocators[i], array);
+            }
+        }
+
+        TEST_ASSERT(stack.static_page.head == stack.static_page.memory);
+        TEST_ASSERT(arena.arena.pages[0].head == arena.arena.pages[0].memory);
+        TEST_ASSERT(plus.default_plus_allocations.count == 0);
+        TEST_ASSERT(allocator_stats(&scratch).used_bytes == 0);
+
+        allocator_destroy(&arena);
+        allocator_destroy(&plus);
+        allocator_destroy(&scratch);
+    }
+
+    // growing an aligned allocation towards the page size moves it to a fresh page where the
+    // padding needed differs, a failure leaves the allocation untouched
+    //
+    for (size_t filler_size = 512; filler_size <= 4096; filler_size += 512) {
+        struct allocator alloc;
+        CONCURRENT_ARENA_ALLOCATOR(alloc, 64 * 1024);
+
+        const size_t alignment = 4096;
+        void*        filler    = allocator_malloc(&alloc, filler_size);
+        int*         data      = allocator_malloc_aligned(&alloc, 64 * sizeof(int), alignment);
+        TEST_ASSERT(filler && data);
+        for (int i = 0; i < 64; i++) {
+            data[i] = i;
+        }
+
+        for (size_t size = 64 * 1024 - 2 * alignment; size <= 64 * 1024; size += 64) {
+            int* grown = allocator_realloc_aligned(&alloc, data, size, alignment);
+            if (grown) {
+                TEST_ASSERT((uintptr_t)grown % alignment == 0);
+                data = grown;
+            }
+            for (int i = 0; i < 64; i++) {
+                TEST_ASSERT(data[i] == i);
+            }
+        }
+
+        allocator_free_aligned(&alloc, data);
+        allocator_free(&alloc, filler);
+        allocator_destroy(&alloc);
+    }
+
+    // mapped arena pages, allocations larger than a page and trimming idle pages
+    //
+    {
+        const unsigned flags[] = {0, ARENA_HUGE_PAGES};
+        for (size_t f = 0; f < sizeof flags / sizeof *flags; f++) {
+            struct allocator alloc;
+            MAPPED_ARENA_ALLOCATOR(alloc, 64 * 1024, flags[f]);
+
+            struct int_array* small = allocate_array(&alloc, 1, 100);
+            struct int_array* large = allocate_array(&alloc, 2, 768 * 1024);
+            TEST_ASSERT(alloc.arena.page_count == 2);
+            TEST_ASSERT(alloc.arena.pages[0].mapped && alloc.arena.pages[1].mapped);
+
+            // growing moves to a new dedicated page and the old one is released
+            //
+            large = reallocate_array(&alloc, large, 1536 * 1024);
+            assert_array_filled_with(large, 2);
+            TEST_ASSERT(alloc.arena.page_count == 3);
+            TEST_ASSERT(alloc.arena.pages[1].memory == NULL);
+            allocator_free(&alloc, large);
+            TEST_ASSERT(alloc.arena.pages[2].memory == NULL);
+
+            // slots of released pages are reused
+            //
+            large = allocate_array(&alloc, 3, 768 * 1024);
+            TEST_ASSERT(alloc.arena.page_count == 3);
+
+            // a regular page stays when emptied, even when rounded up to a huge page
+            //
+            allocator_free(&alloc, small);
+            TEST_ASSERT(alloc.arena.pages[0].memory != NULL);
+            allocator_trim(&alloc);
+            TEST_ASSERT(alloc.arena.pages[0].head == alloc.arena.pages[0].memory);
+            small = allocate_array(&alloc, 4, 100);
+            assert_array_filled_with(small, 4);
+            assert_array_filled_with(large, 3);
+
+            allocator_destroy(&alloc);
+        }
+    }
+
+    // requests too large for a head to describe or for the system to back return NULL
+    //
+    {
+        struct allocator alloc;
+        ARENA_ALLOCATOR(alloc, 64 * 1024);
+        TEST_ASSERT(allocator_malloc(&alloc, SIZE_MAX) == NULL);
+        TEST_ASSERT(allocator_malloc(&alloc, SIZE_MAX - 8) == NULL);
+        TEST_ASSERT(allocator_malloc(&alloc, (size_t)1 << 46) == NULL);
+        TEST_ASSERT(alloc.arena.page_count == 0);
+
+        // likely more than the system will map, either outcome is fine as long as it returns
+        //
+        struct allocator mapped;
+        MAPPED_ARENA_ALLOCATOR(mapped, 64 * 1024, 0);
+        void* huge = allocator_malloc(&mapped, (size_t)31 << 30);
+        allocator_free(&mapped, huge);
+        struct int_array* small = allocate_array(&mapped, 1, 100);
+        assert_array_filled_with(small, 1);
+        allocator_destroy(&mapped);
+    }
+
+    // stats report what each page holds, counters need ALLOCATOR_STATS
+    //
+    {
+        struct allocator alloc;
+        STACK_ALLOCATOR_PLUS(alloc, 4096);
+
+        void* a;
+        void* b;
+        void* c;
+        MALLOC(&alloc, a, 64);
+        MALLOC(&alloc, b, 64);
+        MALLOC(&alloc, c, 64);
+        allocator_free(&alloc, b);
+        REALLOC(&alloc, c, 128);  // grows into the rest of the page
+        REALLOC(&alloc, a, 8000);  // moves to the fallback
+
+        struct allocator_stats stats = allocator_stats(&alloc);
+        TEST_ASSERT(stats.page_count == 1);
+        TEST_ASSERT(stats.reserved_bytes == 4096);
+        TEST_ASSERT(stats.live_count == 1);
+        TEST_ASSERT(stats.used_bytes == 128 + sizeof(struct allocation));
+        TEST_ASSERT(stats.freelist_count == 1);
+        TEST_ASSERT(stats.largest_free_bytes > 3000);
+
+        struct allocator_page_stats page;
+        TEST_ASSERT(allocator_page_stats(&alloc, 0, &page));
+        TEST_ASSERT(page.live_count == stats.live_count);
+        TEST_ASSERT(!allocator_page_stats(&alloc, 1, &page));
+
+        struct allocator_stats fallback_stats = allocator_stats(alloc.fallback);
+        TEST_ASSERT(fallback_stats.live_count == 1);
+        TEST_ASSERT(fallback_stats.used_bytes >= 8000);
+
+#ifdef ALLOCATOR_STATS
+        TEST_ASSERT(stats.malloc_count == 4);
+        TEST_ASSERT(stats.bytes_requested == 3 * 64 + 8000);
+        TEST_ASSERT(stats.fallback_count == 1);
+        TEST_ASSERT(stats.free_count == 2);
+        TEST_ASSERT(stats.realloc_in_place_count == 1);
+        TEST_ASSERT(stats.realloc_copy_count == 1);
+        TEST_ASSERT(fallback_stats.malloc_count == 1);
+#endif
+
+        allocator_destroy(&alloc);
+    }
+
+    // a reallocation which fails is neither a copy nor in place
+    //
+    {
+        struct allocator alloc;
+        STACK_ALLOCATOR(alloc, 1024);
+
+        void* a;
+        MALLOC(&alloc, a, 64);
+        TEST_ASSERT(allocator_realloc(&alloc, a, 4096) == NULL);
+
+        const struct allocator_stats stats = allocator_stats(&alloc);
+        TEST_ASSERT(stats.realloc_copy_count == 0);
+        TEST_ASSERT(stats.realloc_in_place_count == 0);
+        allocator_free(&alloc, a);
+    }
+
+    // a concurrent arena refuses requests a fresh page can't hold without adding pages
+    //
+    {
+        struct allocator alloc;
+        CONCURRENT_ARENA_ALLOCATOR(alloc, 4096);
+        for (int i = 0; i < 8; i++) {
+            TEST_ASSERT(allocator_malloc(&alloc, 4096 - sizeof(struct allocation)) == NULL);
+        }
+        TEST_ASSERT(atomic_load(&alloc.concurrent_arena.page_count) == 0);
+
+        void* largest = allocator_malloc(&alloc, 4096 - 2 * sizeof(struct allocation));
+        TEST_ASSERT(largest);
+        TEST_ASSERT(atomic_load(&alloc.concurrent_arena.page_count) == 1);
+        allocator_free(&alloc, largest);
+        allocator_destroy(&alloc);
+    }
+
+    // blocks freed to the cache of a thread which has exited are collected by a trim
+    //
+    {
+        struct allocator alloc;
+        CONCURRENT_ARENA_ALLOCATOR(alloc, 64 * 1024);
+
+        static struct concurrent_orphan_test test;
+        test.alloc = &alloc;
+        thrd_t thread;
+        TEST_ASSERT(thrd_create(&thread, concurrent_orphan_worker, &test) == thrd_success);
+        thrd_join(thread, NULL);
+
+        for (int i = 0; i < CONCURRENT_TEST_SLOT_COUNT; i++) {
+            assert_array_filled_with(test.arrays[i], i);
+            allocator_free(&alloc, test.arrays[i]);
+        }
+        TEST_ASSERT(allocator_stats(&alloc).live_count == CONCURRENT_TEST_SLOT_COUNT);
+
+        allocator_trim(&alloc);
+        const struct allocator_stats stats = allocator_stats(&alloc);
+        TEST_ASSERT(stats.live_count == 0);
+        TEST_ASSERT(stats.used_bytes == 0);
+        allocator_destroy(&alloc);
+    }
+
+    // concurrent arena shared between threads
+    //
+    {
+        struct allocator alloc;
+        CONCURRENT_ARENA_ALLOCATOR(alloc, 64 * 1024);
+
+        static struct concurrent_test test;
+        test.alloc = &alloc;
+
+        thrd_t                        threads[CONCURRENT_TEST_THREAD_COUNT];
+        struct concurrent_test_thread thread_args[CONCURRENT_TEST_THREAD_COUNT];
+        for (unsigned int i = 0; i < CONCURRENT_TEST_THREAD_COUNT; i++) {
+            thread_args[i] = (struct concurrent_test_thread){.test = &test, .seed = i + 1};
+            TEST_ASSERT(
+                thrd_create(&threads[i], concurrent_test_worker, &thread_args[i]) == thrd_success
+            );
+        }
+        for (size_t i = 0; i < CONCURRENT_TEST_THREAD_COUNT; i++) {
+            thrd_join(threads[i], NULL);
+        }
+
+        for (int i = 0; i < CONCURRENT_TEST_SLOT_COUNT; i++) {
+            struct int_array* array = atomic_load(&test.slots[i]);
+            if (array) {
+                assert_array_filled_with(array, i);
+                allocator_free(&alloc, array);
+            }
+        }
+        allocator_destroy(&alloc);
+    }
+
     // stress test
     //
     {
@@ -309,6 +1152,12 @@ main(void)
                 reallocate_array(&alloc, arrays[i % ARRAY_COUNT], CHOICE(size_table));
         }
 
+        for (size_t i = 0; i < 10000; i++) {
+            size_t index = random_index(ARRAY_COUNT);
+            allocator_free(&alloc, arrays[index]);
+            arrays[index] = allocate_array(&alloc, (int)index, CHOICE(size_table));
+        }
+
         for (int i = 0; i < ARRAY_COUNT; i++) {
             struct int_array* array = arrays[i];
             for (size_t j = 0; j < array->count; j++) {
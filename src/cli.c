@@ -1,5 +1,8 @@
 #include "cli.h"
+#include "filesystem.h"
+#include "string_view.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -38,87 +41,76 @@ cli_type_to_cstr(enum cli_type type)
             return "floating point";
         case CLI_FLAG:
             return "flag";
+        case CLI_LIST:
+            return "list";
     }
     CLI_ASSERT(0 && "unreachable");
 }
 
-struct info_printer {
-    char* buffer;
-    int   remaining;
-};
-
-#define INFO_PRINTF(info_printer, fmt, ...)                                                        \
-    do {                                                                                           \
-        if ((info_printer)->remaining <= 0) {                                                      \
-            break;                                                                                 \
-        }                                                                                          \
-        int written =                                                                              \
-            snprintf((info_printer)->buffer, (info_printer)->remaining, fmt, __VA_ARGS__);         \
-        (info_printer)->remaining -= written;                                                      \
-        (info_printer)->buffer += written;                                                         \
-    } while (0)
-
-#define INFO_PRINT(info_printer, msg) INFO_PRINTF(info_printer, "%s", msg)
+// Usage and validation messages are built without a size limit, CLI_WRITE_ERROR truncates them
+// to fit the error afterwards.
+//
+#define INFO_PRINTF(builder, fmt, ...) sv_builder_appendf(builder, NULL, fmt, __VA_ARGS__)
+#define INFO_PRINT(builder, msg) sv_builder_append(builder, SV_CSTR(msg), NULL)
 
 static void
-print_param_choices(struct info_printer* printer, const struct cli_param* param)
+print_param_choices(struct sv_builder* builder, const struct cli_param* param)
 {
     CLI_ASSERT(param);
     CLI_ASSERT(param->validation.strategy == CLI_VALIDATION_CHOICES);
 
-    INFO_PRINT(printer, "{");
+    INFO_PRINT(builder, "{");
     for (size_t i = 0; i < param->validation.choices.count; i++) {
         if (i > 0) {
-            INFO_PRINT(printer, ", ");
+            INFO_PRINT(builder, ", ");
         }
-        INFO_PRINT(printer, param->validation.choices.values[i]);
+        INFO_PRINT(builder, param->validation.choices.values[i]);
     }
-    INFO_PRINT(printer, "}");
+    INFO_PRINT(builder, "}");
 }
 
 static void
-print_param_range(struct info_printer* printer, const struct cli_param* param)
+print_param_range(struct sv_builder* builder, const struct cli_param* param)
 {
-    CLI_ASSERT(printer);
+    CLI_ASSERT(builder);
     CLI_ASSERT(param);
     CLI_ASSERT(param->validation.strategy == CLI_VALIDATION_RANGE);
 
     switch (param->type) {
         case CLI_STR:
+        case CLI_LIST:
             INFO_PRINTF(
-                printer,
+                builder,
                 "[%s-%s]",
                 param->validation.range.start.str,
                 param->validation.range.stop.str
             );
             break;
         case CLI_FLOAT:
-            INFO_PRINTF(
-                printer,
-                "[%f-%f]",
-                param->validation.range.start.f64,
-                param->validation.range.stop.f64
-            );
+            INFO_PRINT(builder, "[");
+            sv_builder_append_f64(builder, param->validation.range.start.f64, NULL);
+            INFO_PRINT(builder, "-");
+            sv_builder_append_f64(builder, param->validation.range.stop.f64, NULL);
+            INFO_PRINT(builder, "]");
             break;
         case CLI_FLAG:
             CLI_ASSERT(0 && "unreachable");
             break;
         case CLI_INT:
-            INFO_PRINTF(
-                printer,
-                "[%li-%li]",
-                param->validation.range.start.i64,
-                param->validation.range.stop.i64
-            );
+            INFO_PRINT(builder, "[");
+            sv_builder_append_i64(builder, param->validation.range.start.i64, NULL);
+            INFO_PRINT(builder, "-");
+            sv_builder_append_i64(builder, param->validation.range.stop.i64, NULL);
+            INFO_PRINT(builder, "]");
             break;
     }
 }
 
 static void
-print_param_docs(struct info_printer* printer, const struct cli_param* param)
+print_param_docs(struct sv_builder* builder, const struct cli_param* param)
 {
     INFO_PRINTF(
-        printer,
+        builder,
         "\t%s (%s) - %s\n",
         param->name,
         cli_type_to_cstr(param->type),
@@ -128,20 +120,20 @@ print_param_docs(struct info_printer* printer, const struct cli_param* param)
         case CLI_VALIDATION_TYPES_ONLY:
             break;
         case CLI_VALIDATION_RANGE:
-            INFO_PRINT(printer, "\t  ");
-            print_param_range(printer, param);
-            INFO_PRINT(printer, "\n");
+            INFO_PRINT(builder, "\t  ");
+            print_param_range(builder, param);
+            INFO_PRINT(builder, "\n");
             break;
         case CLI_VALIDATION_CHOICES:
-            INFO_PRINT(printer, "\t  ");
-            print_param_choices(printer, param);
-            INFO_PRINT(printer, "\n");
+            INFO_PRINT(builder, "\t  ");
+            print_param_choices(builder, param);
+            INFO_PRINT(builder, "\n");
             break;
     }
 }
 
-static void
-write_usage_to_error(
+void
+cli_write_usage(
     const char*        program_name,
     const char*        program_description,
     struct cli_param** params,
@@ -149,35 +141,54 @@ write_usage_to_error(
     struct cli_error*  error
 )
 {
-    char                usage_buffer[sizeof error->reason];
-    struct info_printer printer = {
-        .buffer    = usage_buffer,
-        .remaining = sizeof usage_buffer,
-    };
-    int options_count = 0;
+    struct sv_builder builder       = {0};
+    int               options_count = 0;
 
-    INFO_PRINTF(&printer, "%s: %s\n\n", program_name, program_description);
-    INFO_PRINTF(&printer, "%s:\n", "positional arguments");
+    INFO_PRINTF(&builder, "%s: %s\n\n", program_name, program_description);
+    INFO_PRINTF(&builder, "%s:\n", "positional arguments");
 
     for (size_t i = 0; i < params_count; i++) {
         if (params[i]->name[0] == '-') {
             options_count += 1;
             continue;
         }
-        print_param_docs(&printer, params[i]);
+        print_param_docs(&builder, params[i]);
     }
-    INFO_PRINTF(&printer, "%s", "\n");
+    INFO_PRINTF(&builder, "%s", "\n");
 
     if (options_count) {
-        INFO_PRINTF(&printer, "%s:\n", "options");
+        INFO_PRINTF(&builder, "%s:\n", "options");
         for (size_t i = 0; i < params_count; i++) {
             if (params[i]->name[0] == '-') {
-                print_param_docs(&printer, params[i]);
+                print_param_docs(&builder, params[i]);
             }
         }
     }
 
-    CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, usage_buffer);
+    CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, builder.data);
+    sv_builder_free(&builder);
+}
+
+static void*
+cli_realloc(void* ptr, size_t size, CliAllocator* allocator)
+{
+    if (!allocator) {
+        return CLI_DEFAULT_REALLOC(ptr, size);
+    }
+    return allocator_realloc(allocator, ptr, size);
+}
+
+static void
+cli_free(void* ptr, CliAllocator* allocator)
+{
+    if (!ptr) {
+        return;
+    }
+    if (!allocator) {
+        CLI_DEFAULT_FREE(ptr);
+        return;
+    }
+    allocator_free(allocator, ptr);
 }
 
 static int
@@ -185,6 +196,7 @@ cli_value_compare(union cli_value v1, union cli_value v2, enum cli_type type)
 {
     switch (type) {
         case CLI_STR:
+        case CLI_LIST:
             return strcmp(v1.str, v2.str);
         case CLI_FLAG:
             return 0;
@@ -200,57 +212,105 @@ cli_value_compare(union cli_value v1, union cli_value v2, enum cli_type type)
     return 0;
 }
 
-static void
-cli_param_parse_input_value(const char* input, struct cli_param* param, struct cli_error* error)
+// Lists grow by doubling, the capacity is implied by the count so nothing else is stored.
+//
+static bool
+cli_list_append(
+    struct cli_list*  list,
+    const char*       name,
+    const char*       input,
+    CliAllocator*     allocator,
+    struct cli_error* error
+)
 {
-    CLI_ASSERT(param);
+    const size_t count = list->count;
+    if (count == 0 || (count >= 4 && (count & (count - 1)) == 0)) {
+        const size_t capacity = (count) ? count * 2 : 4;
+        const char** values   = cli_realloc(list->values, capacity * sizeof *values, allocator);
+        if (!values) {
+            CLI_WRITE_ERRORF(
+                error, CLI_CODE_FAILURE, "out of memory for values of param `%s`", name
+            );
+            return false;
+        }
+        list->values = values;
+    }
+    list->values[list->count++] = input;
+    return true;
+}
 
+static bool
+cli_convert_input_value(
+    const char*       input,
+    const char*       name,
+    enum cli_type     type,
+    union cli_value*  value,
+    struct cli_error* error
+)
+{
     if (!input || *input == '\0') {
         CLI_WRITE_ERRORF(
-            error, CLI_CODE_FAILURE, "invalid input value (empty) for param `%s`", param->name
+            error, CLI_CODE_FAILURE, "invalid input value (empty) for param `%s`", name
         );
+        return false;
     }
 
-    switch (param->type) {
+    switch (type) {
         case CLI_FLAG:
             CLI_ASSERT(0 && "unreachable");
             break;
         case CLI_STR:
-            param->value.str = input;
+        case CLI_LIST:
+            value->str = input;
             break;
-        case CLI_INT: {
-            char* endptr;
-            param->value.i64 = strtoll(input, &endptr, 10);
-            if (*endptr != '\0') {
-                CLI_WRITE_ERRORF(
-                    error,
-                    CLI_CODE_FAILURE,
-                    "expecting %s type for param `%s` but got value `%s`",
-                    cli_type_to_cstr(param->type),
-                    param->name,
-                    input
-                );
-                return;
-            }
-            break;
-        }
+        case CLI_INT:
         case CLI_FLOAT: {
-            char* endptr;
-            param->value.f64 = strtod(input, &endptr);
-            if (*endptr != '\0') {
+            // the whole input has to be the number, anything left over is an error rather than
+            // silently ignored
+            //
+            struct sv_error    parse_error = {0};
+            struct string_view view        = SV_CSTR(input);
+            const size_t       length      = view.length;
+            size_t             consumed;
+            if (type == CLI_INT) {
+                consumed = sv_parse_i64(&view, &value->i64, &parse_error);
+            }
+            else {
+                consumed = sv_parse_f64(&view, &value->f64, &parse_error);
+            }
+            if (parse_error.code != SV_CODE_SUCCESS || consumed != length) {
                 CLI_WRITE_ERRORF(
                     error,
                     CLI_CODE_FAILURE,
                     "expecting %s type for param `%s` but got value `%s`",
-                    cli_type_to_cstr(param->type),
-                    param->name,
+                    cli_type_to_cstr(type),
+                    name,
                     input
                 );
-                return;
+                return false;
             }
             break;
         }
     }
+    return true;
+}
+
+static void
+cli_param_parse_input_value(
+    const char*       input,
+    struct cli_param* param,
+    CliAllocator*     allocator,
+    struct cli_error* error
+)
+{
+    CLI_ASSERT(param);
+
+    // parsed and validated before it's stored, so a list only ever holds valid values
+    //
+    union cli_value value = {0};
+    if (!cli_convert_input_value(input, param->name, param->type, &value, error)) {
+        return;
+    }
 
     switch (param->validation.strategy) {
         case CLI_VALIDATION_TYPES_ONLY:
@@ -264,44 +324,85 @@ cli_param_parse_input_value(const char* input, struct cli_param* param, struct c
                 }
             }
             if (!valid) {
-                char                error_buffer[sizeof error->reason];
-                struct info_printer printer = {
-                    .buffer    = error_buffer,
-                    .remaining = sizeof error_buffer,
-                };
+                struct sv_builder builder = {0};
                 INFO_PRINTF(
-                    &printer, "value (%s) given for param `%s` not in choices ", input, param->name
+                    &builder, "value (%s) given for param `%s` not in choices ", input, param->name
                 );
-                print_param_choices(&printer, param);
-                CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, error_buffer);
+                print_param_choices(&builder, param);
+                CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, builder.data);
+                sv_builder_free(&builder);
+                return;
             }
             break;
         }
         case CLI_VALIDATION_RANGE: {
-            int  lcmp = cli_value_compare(param->value, param->validation.range.start, param->type);
-            int  rcmp = cli_value_compare(param->value, param->validation.range.stop, param->type);
+            int  lcmp  = cli_value_compare(value, param->validation.range.start, param->type);
+            int  rcmp  = cli_value_compare(value, param->validation.range.stop, param->type);
             bool valid = (lcmp >= 0 && rcmp <= 0);
             if (!valid) {
-                char                error_buffer[sizeof error->reason];
-                struct info_printer printer = {
-                    .buffer    = error_buffer,
-                    .remaining = sizeof error_buffer,
-                };
+                struct sv_builder builder = {0};
                 INFO_PRINTF(
-                    &printer, "value (%s) given for param `%s` not in range ", input, param->name
+                    &builder, "value (%s) given for param `%s` not in range ", input, param->name
                 );
-                print_param_range(&printer, param);
-                CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, error_buffer);
+                print_param_range(&builder, param);
+                CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, builder.data);
+                sv_builder_free(&builder);
+                return;
             }
-
             break;
         }
     }
+
+    if (param->type == CLI_LIST) {
+        cli_list_append(&param->value.list, param->name, input, allocator, error);
+    }
+    else {
+        param->value = value;
+    }
+}
+
+struct cli_option {
+    struct cli_param* param;
+    bool              seen;
+};
+
+static int
+cli_option_compare(const void* o1, const void* o2)
+{
+    return strcmp(
+        ((const struct cli_option*)o1)->param->name, ((const struct cli_option*)o2)->param->name
+    );
+}
+
+static struct cli_option*
+cli_option_find(struct cli_option* options, size_t count, const char* name)
+{
+    size_t low  = 0;
+    size_t high = count;
+    while (low < high) {
+        const size_t middle     = low + (high - low) / 2;
+        const int    comparison = strcmp(name, options[middle].param->name);
+        if (comparison == 0) {
+            return options + middle;
+        }
+        if (comparison < 0) {
+            high = middle;
+        }
+        else {
+            low = middle + 1;
+        }
+    }
+    return NULL;
 }
 
-#ifndef ARGC_MAX
-#define ARGC_MAX 256
-#endif
+static void
+cli_report_unused(struct sv_builder* unused, const char* arg)
+{
+    if (unused->length) {
+        INFO_PRINT(unused, ", ");
+    }
+    INFO_PRINT(unused, arg);
+}
 
 void
 cli_parse_args(
@@ -310,127 +411,449 @@ cli_parse_args(
     struct cli_param** params,
     int                argc,
     const char**       argv,
+    CliAllocator*      allocator,
     struct cli_error*  error
 )
 {
     CLI_ASSERT(argc > 0);
     CLI_ASSERT(params_count > 0);
 
-    if (argc > ARGC_MAX) {
-        CLI_WRITE_ERRORF(
-            error,
-            CLI_CODE_FAILURE,
-            "max argc of %i exceeded -- `#define ARGC_MAX (n)` to raise capacity",
-            ARGC_MAX
-        );
-        return;
-    }
     for (size_t i = 1; i < (size_t)argc; i++) {
         if (strcmp(argv[i], "--help") == 0) {
-            write_usage_to_error(argv[0], program_description, params, params_count, error);
+            cli_write_usage(argv[0], program_description, params, params_count, error);
         }
         else if (strcmp(argv[i], "-help") == 0) {
-            write_usage_to_error(argv[0], program_description, params, params_count, error);
+            cli_write_usage(argv[0], program_description, params, params_count, error);
         }
     }
     if (CLI_ERROR_IS_SET(error)) {
         return;
     }
 
-    bool already_parsed[ARGC_MAX] = {false};
-
-    // parse options
+    // options are sorted by name once so each argument is a binary search rather than a scan
+    // of every param
     //
-    for (size_t param = 0; param < params_count; param++) {
-        if (params[param]->name[0] != '-') {
-            continue;
+    struct sv_builder  unused        = {0};
+    struct cli_option* options       = NULL;
+    size_t             options_count = 0;
+    for (size_t i = 0; i < params_count; i++) {
+        options_count += params[i]->name[0] == '-';
+    }
+    if (options_count) {
+        options = cli_realloc(NULL, options_count * sizeof *options, allocator);
+        if (!options) {
+            CLI_WRITE_ERRORF(error, CLI_CODE_FAILURE, "%s", "out of memory for options");
+            return;
         }
-
-        bool param_successfully_parsed = false;
-
-        for (int arg = 1; !param_successfully_parsed && arg < argc; arg++) {
-            if (already_parsed[arg]) {
-                continue;
+        for (size_t i = 0, j = 0; i < params_count; i++) {
+            if (params[i]->name[0] == '-') {
+                options[j++] = (struct cli_option){.param = params[i]};
             }
-            if (strcmp(argv[arg], params[param]->name) == 0) {
-                already_parsed[arg] = true;
+        }
+        qsort(options, options_count, sizeof *options, cli_option_compare);
+    }
 
-                if (params[param]->type == CLI_FLAG) {
-                    params[param]->value.present = true;
-                }
-                else {
-                    if (++arg >= argc) {
-                        CLI_WRITE_ERRORF(
-                            error,
-                            CLI_CODE_FAILURE,
-                            "option %s has no value specified",
-                            params[param]->name
-                        );
-                        return;
-                    }
-                    cli_param_parse_input_value(argv[arg], params[param], error);
-                    if (CLI_ERROR_IS_SET(error)) {
-                        return;
-                    }
-                    already_parsed[arg] = true;
+    size_t positional = 0;
+    while (positional < params_count && params[positional]->name[0] == '-') {
+        positional++;
+    }
+    bool positional_parsed = false;
+
+    for (int arg = 1; arg < argc; arg++) {
+        struct cli_option* option =
+            (argv[arg][0] == '-') ? cli_option_find(options, options_count, argv[arg]) : NULL;
+
+        if (option) {
+            struct cli_param* param = option->param;
+
+            // only lists can be given more than once, later repeats are unused
+            //
+            const bool repeated = option->seen && param->type != CLI_LIST;
+            option->seen        = true;
+            if (repeated) {
+                cli_report_unused(&unused, argv[arg]);
+                if (param->type != CLI_FLAG && arg + 1 < argc) {
+                    cli_report_unused(&unused, argv[++arg]);
                 }
+                continue;
+            }
 
-                param_successfully_parsed = true;
+            if (param->type == CLI_FLAG) {
+                param->value.present = true;
+                continue;
+            }
+            if (++arg >= argc) {
+                CLI_WRITE_ERRORF(
+                    error, CLI_CODE_FAILURE, "option %s has no value specified", param->name
+                );
+                goto cleanup;
+            }
+            cli_param_parse_input_value(argv[arg], param, allocator, error);
+            if (CLI_ERROR_IS_SET(error)) {
+                goto cleanup;
             }
+            continue;
+        }
+
+        // a positional list takes every positional argument from here on
+        //
+        if (positional == params_count) {
+            cli_report_unused(&unused, argv[arg]);
+            continue;
         }
-        if (!param_successfully_parsed && params[param]->flags & CLI_FLAG_OPTION_REQUIRED) {
+        cli_param_parse_input_value(argv[arg], params[positional], allocator, error);
+        if (CLI_ERROR_IS_SET(error)) {
+            goto cleanup;
+        }
+        positional_parsed = true;
+        if (params[positional]->type != CLI_LIST) {
+            do {
+                positional++;
+            } while (positional < params_count && params[positional]->name[0] == '-');
+            positional_parsed = false;
+        }
+    }
+
+    for (size_t i = 0; i < params_count; i++) {
+        struct cli_option* option = (params[i]->name[0] == '-')
+                                        ? cli_option_find(options, options_count, params[i]->name)
+                                        : NULL;
+        if (option && !option->seen && params[i]->flags & CLI_FLAG_OPTION_REQUIRED) {
             CLI_WRITE_ERRORF(
-                error, CLI_CODE_FAILURE, "required option %s is missing", params[param]->name
+                error, CLI_CODE_FAILURE, "required option %s is missing", params[i]->name
             );
-            return;
+            goto cleanup;
         }
     }
+    if (positional < params_count && !positional_parsed) {
+        CLI_WRITE_ERRORF(
+            error, CLI_CODE_FAILURE, "missing positional argument %s", params[positional]->name
+        );
+        goto cleanup;
+    }
+
+    if (unused.length) {
+        CLI_WRITE_ERRORF(error, CLI_CODE_WARNING, "unused arguments: [%s]", unused.data);
+    }
+
+cleanup:
+    sv_builder_free(&unused);
+    cli_free(options, allocator);
+}
+
+void
+cli_free_params(size_t params_count, struct cli_param** params, CliAllocator* allocator)
+{
+    for (size_t i = 0; i < params_count; i++) {
+        if (params[i]->type == CLI_LIST) {
+            cli_free_list(&params[i]->value.list, allocator);
+        }
+    }
+}
+
+void
+cli_free_list(struct cli_list* list, CliAllocator* allocator)
+{
+    CLI_ASSERT(list);
+    cli_free(list->values, allocator);
+    *list = (struct cli_list){0};
+}
+
+bool
+cli_schema_wants_help(int argc, const char** argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-help") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+cli_schema_store(
+    const char*       name,
+    enum cli_type     type,
+    const char*       input,
+    void*             value,
+    CliAllocator*     allocator,
+    struct cli_error* error
+)
+{
+    CLI_ASSERT(value);
+
+    union cli_value converted = {0};
+    if (!cli_convert_input_value(input, name, type, &converted, error)) {
+        return false;
+    }
+    switch (type) {
+        case CLI_STR:
+            *(const char**)value = converted.str;
+            break;
+        case CLI_INT:
+            *(int64_t*)value = converted.i64;
+            break;
+        case CLI_FLOAT:
+            *(double*)value = converted.f64;
+            break;
+        case CLI_FLAG:
+            CLI_ASSERT(0 && "unreachable");
+            break;
+        case CLI_LIST:
+            return cli_list_append(value, name, input, allocator, error);
+    }
+    return true;
+}
+
+bool
+cli_schema_option(
+    int                argc,
+    const char**       argv,
+    int*               arg,
+    const char*        name,
+    enum cli_type      type,
+    bool*              seen,
+    void*              value,
+    CliAllocator*      allocator,
+    struct sv_builder* unused,
+    struct cli_error*  error
+)
+{
+    CLI_ASSERT(arg && seen && value && unused);
 
-    // parse positional args
+    // the same rules as cli_parse_args, only lists can be given more than once
     //
-    for (size_t param = 0; param < params_count; param++) {
-        if (params[param]->name[0] == '-') {
-            continue;
+    const bool repeated = *seen && type != CLI_LIST;
+    *seen               = true;
+    if (repeated) {
+        cli_report_unused(unused, argv[*arg]);
+        if (type != CLI_FLAG && *arg + 1 < argc) {
+            cli_report_unused(unused, argv[++*arg]);
         }
-        bool param_successfully_parsed = false;
-        for (int arg = 1; !param_successfully_parsed && arg < argc; arg++) {
-            if (already_parsed[arg]) {
-                continue;
+        return true;
+    }
+
+    if (type == CLI_FLAG) {
+        *(bool*)value = true;
+        return true;
+    }
+    if (++*arg >= argc) {
+        CLI_WRITE_ERRORF(error, CLI_CODE_FAILURE, "option %s has no value specified", name);
+        return false;
+    }
+    return cli_schema_store(name, type, argv[*arg], value, allocator, error);
+}
+
+void
+cli_schema_invalid_choice(
+    const char*        name,
+    const char*        input,
+    const char* const* choices,
+    size_t             choices_count,
+    struct cli_error*  error
+)
+{
+    struct sv_builder builder = {0};
+    INFO_PRINTF(&builder, "value (%s) given for param `%s` not in choices {", input, name);
+    for (size_t i = 0; i < choices_count; i++) {
+        if (i > 0) {
+            INFO_PRINT(&builder, ", ");
+        }
+        INFO_PRINT(&builder, choices[i]);
+    }
+    INFO_PRINT(&builder, "}");
+    CLI_WRITE_ERROR(error, CLI_CODE_FAILURE, builder.data);
+    sv_builder_free(&builder);
+}
+
+void
+cli_schema_missing(const char* name, struct cli_error* error)
+{
+    if (name[0] == '-') {
+        CLI_WRITE_ERRORF(error, CLI_CODE_FAILURE, "required option %s is missing", name);
+    }
+    else {
+        CLI_WRITE_ERRORF(error, CLI_CODE_FAILURE, "missing positional argument %s", name);
+    }
+}
+
+void
+cli_schema_unused(struct sv_builder* unused, const char* arg)
+{
+    cli_report_unused(unused, arg);
+}
+
+void
+cli_schema_finish(struct sv_builder* unused, bool failed, struct cli_error* error)
+{
+    if (!failed && unused->length) {
+        CLI_WRITE_ERRORF(error, CLI_CODE_WARNING, "unused arguments: [%s]", unused->data);
+    }
+    sv_builder_free(unused);
+}
+
+// Splits `buffer` into arguments in place. Whitespace separates them, single quotes keep
+// everything up to the next single quote, double quotes do the same but a backslash still
+// escapes the next character, and a backslash outside quotes escapes the next character.
+// Unquoted text is written back over itself without the quotes and escapes and each argument
+// is null terminated where its separator was, so no argument is copied out of the buffer.
+//
+static bool
+cli_tokenize_append(struct cli_args* args, const char* token, CliAllocator* allocator)
+{
+    if (args->argc == INT_MAX) {
+        return false;
+    }
+    if ((size_t)args->argc == args->capacity) {
+        const size_t capacity = (args->capacity) ? args->capacity * 2 : 64;
+        const char** argv     = cli_realloc(args->argv, capacity * sizeof *argv, allocator);
+        if (!argv) {
+            return false;
+        }
+        args->argv     = argv;
+        args->capacity = capacity;
+    }
+    args->argv[args->argc++] = token;
+    return true;
+}
+
+static void
+cli_tokenize(
+    struct cli_args*  args,
+    char*             buffer,
+    size_t            size,
+    const char*       source,
+    CliAllocator*     allocator,
+    struct cli_error* error
+)
+{
+    struct string_view rest = {.length = size, .data = buffer};
+    for (;;) {
+        sv_lstrip(&rest);
+        if (!rest.length) {
+            return;
+        }
+
+        char*       token = buffer + (rest.data - buffer);
+        char*       out   = token;
+        const char* in    = rest.data;
+        const char* end   = rest.data + rest.length;
+        char        quote = '\0';
+        while (in < end) {
+            const char c = *in;
+            if (quote == '\'') {
+                in++;
+                if (c == '\'') quote = '\0';
+                else *out++ = c;
             }
-            cli_param_parse_input_value(argv[arg], params[param], error);
-            if (CLI_ERROR_IS_SET(error)) {
-                return;
+            else if (c == '\\' && in + 1 < end) {
+                *out++ = in[1];
+                in += 2;
+            }
+            else if (quote == '"') {
+                in++;
+                if (c == '"') quote = '\0';
+                else *out++ = c;
+            }
+            else if (c == '\'' || c == '"') {
+                quote = c;
+                in++;
+            }
+            else if (c == ' ' || (c >= '\t' && c <= '\r')) {
+                break;
+            }
+            else {
+                *out++ = c;
+                in++;
             }
-            already_parsed[arg]       = true;
-            param_successfully_parsed = true;
-            break;
         }
-        if (!param_successfully_parsed) {
+        if (quote) {
             CLI_WRITE_ERRORF(
-                error, CLI_CODE_FAILURE, "missing positional argument %s", params[param]->name
+                error, CLI_CODE_FAILURE, "unterminated %c quote in %s", quote, source
+            );
+            return;
+        }
+
+        // `out` never passes `in`, so the terminator lands at the latest on the separator, which
+        // is skipped, or on the buffer's own terminator
+        //
+        sv_ldiscard(&rest, (size_t)(in - rest.data) + (in < end));
+        *out = '\0';
+        if (!cli_tokenize_append(args, token, allocator)) {
+            CLI_WRITE_ERRORF(
+                error, CLI_CODE_FAILURE, "out of memory for arguments from %s", source
             );
             return;
         }
     }
+}
 
-    // warn on unrecognized args
-    //
-    bool                unused = false;
-    char                unused_buffer[sizeof error->reason];
-    struct info_printer printer = {
-        .buffer    = unused_buffer,
-        .remaining = sizeof unused_buffer,
-    };
-    for (size_t i = 1; i < (size_t)argc; i++) {
-        if (!already_parsed[i]) {
-            if (unused) {
-                INFO_PRINT(&printer, ", ");
+struct cli_args
+cli_expand_args(int argc, const char** argv, CliAllocator* allocator, struct cli_error* error)
+{
+    CLI_ASSERT(argc > 0);
+    CLI_ASSERT(argv);
+
+    struct cli_args args = {0};
+    for (int i = 0; i < argc; i++) {
+        if (i == 0 || argv[i][0] != '@' || argv[i][1] == '\0') {
+            if (!cli_tokenize_append(&args, argv[i], allocator)) {
+                CLI_WRITE_ERRORF(error, CLI_CODE_FAILURE, "%s", "out of memory for arguments");
+                goto failed;
             }
-            unused = true;
-            INFO_PRINT(&printer, argv[i]);
+            continue;
+        }
+
+        const char*       source   = argv[i] + 1;
+        const bool        is_stdin = strcmp(source, "-") == 0;
+        struct fs_error   fs_error = {0};
+        struct fs_content content  = (is_stdin)
+                                         ? fs_read_all(stdin, allocator, &fs_error)
+                                         : fs_read_file_binary(source, allocator, &fs_error);
+        if (fs_error.code != FS_CODE_SUCCESS) {
+            CLI_WRITE_ERRORF(
+                error,
+                CLI_CODE_FAILURE,
+                "failed to read arguments from %s: %s",
+                argv[i],
+                fs_error.reason
+            );
+            goto failed;
+        }
+
+        // the buffers are kept, arguments point into them
+        //
+        char** buffers =
+            cli_realloc(args.buffers, (args.buffer_count + 1) * sizeof *buffers, allocator);
+        if (!buffers) {
+            cli_free(content.data, allocator);
+            CLI_WRITE_ERRORF(error, CLI_CODE_FAILURE, "%s", "out of memory for arguments");
+            goto failed;
+        }
+        args.buffers                      = buffers;
+        args.buffers[args.buffer_count++] = content.data;
+
+        const char* name = (is_stdin) ? "stdin" : source;
+        cli_tokenize(&args, content.data, content.size, name, allocator, error);
+        if (CLI_ERROR_IS_SET(error)) {
+            goto failed;
         }
     }
-    if (unused) {
-        CLI_WRITE_ERRORF(error, CLI_CODE_WARNING, "unused arguments: [%s]", unused_buffer);
+    return args;
+
+failed:
+    cli_free_args(&args, allocator);
+    return args;
+}
+
+void
+cli_free_args(struct cli_args* args, CliAllocator* allocator)
+{
+    CLI_ASSERT(args);
+    for (size_t i = 0; i < args->buffer_count; i++) {
+        cli_free(args->buffers[i], allocator);
     }
+    cli_free(args->buffers, allocator);
+    cli_free(args->argv, allocator);
+    *args = (struct cli_args){0};
 }
@@ -4,24 +4,47 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "string_view.h"
 
 #ifndef CLI_ASSERT
 #include <assert.h>
 #define CLI_ASSERT assert
 #endif
 
+#ifndef CLI_DEFAULT_REALLOC
+#include <stdlib.h>
+#define CLI_DEFAULT_REALLOC realloc
+#endif
+
+#ifndef CLI_DEFAULT_FREE
+#include <stdlib.h>
+#define CLI_DEFAULT_FREE free
+#endif
+
+typedef struct allocator CliAllocator;
+
 enum cli_type {
     CLI_STR = 0,
     CLI_INT,
     CLI_FLOAT,
     CLI_FLAG,
+    CLI_LIST,  // strings, every value given for a repeated option or a trailing positional
+};
+
+struct cli_list {
+    size_t       count;
+    const char** values;
 };
 
 union cli_value {
-    const char* str;
-    int64_t     i64;
-    double      f64;
-    bool        present;
+    const char*     str;
+    int64_t         i64;
+    double          f64;
+    bool            present;
+    struct cli_list list;
 };
 
 struct cli_validation {
@@ -69,15 +92,288 @@ struct cli_error {
     char          reason[1024];
 };
 
+// Params whose name starts with '-' are options, the rest are positional and taken in order.
+// Arguments are parsed in a single pass with options looked up in a sorted index, so there is
+// no limit on argc. A CLI_LIST option collects a value each time it's given and a CLI_LIST
+// positional, which has to be the last positional, collects every positional argument from
+// there on and needs at least one. List values are allocated from `allocator` and released
+// with `cli_free_params`.
+//
 void cli_parse_args(
     const char*        program_description,
     size_t             params_count,
     struct cli_param** params,
     int                argc,
     const char**       argv,
+    CliAllocator*      allocator,
+    struct cli_error*  error
+);
+void cli_free_params(size_t params_count, struct cli_param** params, CliAllocator* allocator);
+void cli_free_list(struct cli_list*, CliAllocator*);
+
+// The `--help` message, written to `error` as a CLI_CODE_FAILURE.
+//
+void cli_write_usage(
+    const char*        program_name,
+    const char*        program_description,
+    struct cli_param** params,
+    size_t             params_count,
     struct cli_error*  error
 );
 
+// Arguments after response files are expanded, for when the command line can't hold them all.
+// Each "@path" argument is replaced by the arguments in the file and "@-" by those read from
+// stdin, separated by whitespace with shell-like quoting. Arguments from a file are taken
+// literally, they aren't expanded again. The files are read once and split in place, `argv`
+// points into them until `cli_free_args`. Pass `argc` and `argv` on to `cli_parse_args`.
+//
+struct cli_args {
+    int          argc;
+    const char** argv;
+    size_t       capacity;
+    size_t       buffer_count;
+    char**       buffers;
+};
+
+struct cli_args cli_expand_args(int argc, const char** argv, CliAllocator*, struct cli_error*);
+void            cli_free_args(struct cli_args*, CliAllocator*);
+
+// Schemas generate a parser for a fixed set of params at compile time. A schema is an X-macro
+// listing the params in order through the POSITIONAL, OPTION and CHOICE entries it's given:
+//
+//     POSITIONAL(field, type, description)
+//     OPTION(field, "-name", type, flags, description)
+//     CHOICE(field, "-name", enum_tag, CHOICES, flags, description)
+//
+// where CHOICES is another X-macro of X(ENUMERATOR, "text") pairs. CLI_SCHEMA(prefix,
+// description, SCHEMA) then defines `struct prefix_args`, a field per param typed after it
+// (const char*, int64_t, double, bool, struct cli_list or the choice's enum) and
+// `prefix_parse_args(argc, argv, result, allocator, error)`. Names and choices are matched by
+// a length check and a fixed size memcmp the compiler unrolls, so there is no table of params
+// to build or search at startup. Arguments are otherwise taken as `cli_parse_args` takes them.
+// A choice option defaults to its first choice and lists are released with `cli_free_list`.
+// See the schema test below for a whole example.
+//
+#define CLI_SCHEMA(prefix, program_description, schema)                                            \
+    schema(CLI_SCHEMA_NONE, CLI_SCHEMA_NONE, CLI_SCHEMA_CHOICE_ENUM)                               \
+    struct prefix##_args {                                                                         \
+        schema(CLI_SCHEMA_POSITIONAL_FIELD, CLI_SCHEMA_OPTION_FIELD, CLI_SCHEMA_CHOICE_FIELD)      \
+    };                                                                                             \
+    static inline void prefix##_parse_args(                                                        \
+        int argc, const char** argv, struct prefix##_args* result, CliAllocator* allocator,        \
+        struct cli_error* error                                                                    \
+    )                                                                                              \
+    {                                                                                              \
+        enum {                                                                                     \
+            schema(CLI_SCHEMA_POSITIONAL_INDEX, CLI_SCHEMA_NONE, CLI_SCHEMA_NONE)                  \
+            cli_schema_positional_count                                                            \
+        };                                                                                         \
+        enum {                                                                                     \
+            schema(CLI_SCHEMA_NONE, CLI_SCHEMA_OPTION_INDEX, CLI_SCHEMA_OPTION_INDEX)              \
+            cli_schema_option_count                                                                \
+        };                                                                                         \
+        CLI_ASSERT(argc > 0);                                                                      \
+        CLI_ASSERT(result);                                                                        \
+        *result = (struct prefix##_args){0};                                                       \
+        if (cli_schema_wants_help(argc, argv)) {                                                   \
+            struct cli_param params[] = {                                                          \
+                schema(                                                                            \
+                    CLI_SCHEMA_POSITIONAL_PARAM, CLI_SCHEMA_OPTION_PARAM, CLI_SCHEMA_CHOICE_PARAM  \
+                )                                                                                  \
+            };                                                                                     \
+            struct cli_param* pointers[sizeof params / sizeof *params];                            \
+            for (size_t i = 0; i < sizeof params / sizeof *params; i++) {                          \
+                pointers[i] = params + i;                                                          \
+            }                                                                                      \
+            cli_write_usage(                                                                       \
+                argv[0], program_description, pointers, sizeof params / sizeof *params, error      \
+            );                                                                                     \
+            return;                                                                                \
+        }                                                                                          \
+        struct sv_builder cli_schema_unused_args = {0};                                            \
+        int               cli_schema_positional  = 0;                                              \
+        bool              cli_schema_failed      = true;                                           \
+        bool              cli_schema_seen[cli_schema_option_count + 1] = {0};                      \
+        for (int cli_schema_i = 1; cli_schema_i < argc; cli_schema_i++) {                          \
+            const char* cli_schema_arg = argv[cli_schema_i];                                       \
+            if (cli_schema_arg[0] == '-') {                                                        \
+                const size_t cli_schema_length = strlen(cli_schema_arg);                           \
+                (void)cli_schema_length;                                                           \
+                schema(CLI_SCHEMA_NONE, CLI_SCHEMA_OPTION_MATCH, CLI_SCHEMA_CHOICE_MATCH)          \
+            }                                                                                      \
+            schema(CLI_SCHEMA_POSITIONAL_MATCH, CLI_SCHEMA_NONE, CLI_SCHEMA_NONE)                  \
+            cli_schema_unused(&cli_schema_unused_args, cli_schema_arg);                            \
+        }                                                                                          \
+        schema(CLI_SCHEMA_NONE, CLI_SCHEMA_OPTION_CHECK, CLI_SCHEMA_CHOICE_CHECK)                  \
+        schema(CLI_SCHEMA_POSITIONAL_CHECK, CLI_SCHEMA_NONE, CLI_SCHEMA_NONE)                      \
+        cli_schema_failed = false;                                                                 \
+        (void)cli_schema_positional;                                                               \
+        (void)cli_schema_seen;                                                                     \
+    cli_schema_done:                                                                               \
+        cli_schema_finish(&cli_schema_unused_args, cli_schema_failed, error);                      \
+    }
+
+#define CLI_SCHEMA_NONE(...)
+
+#define CLI_SCHEMA_TYPE_CLI_STR const char*
+#define CLI_SCHEMA_TYPE_CLI_INT int64_t
+#define CLI_SCHEMA_TYPE_CLI_FLOAT double
+#define CLI_SCHEMA_TYPE_CLI_FLAG bool
+#define CLI_SCHEMA_TYPE_CLI_LIST struct cli_list
+
+#define CLI_SCHEMA_EMPTY_CLI_STR(value) true
+#define CLI_SCHEMA_EMPTY_CLI_INT(value) true
+#define CLI_SCHEMA_EMPTY_CLI_FLOAT(value) true
+#define CLI_SCHEMA_EMPTY_CLI_FLAG(value) true
+#define CLI_SCHEMA_EMPTY_CLI_LIST(value) ((value).count == 0)
+
+#define CLI_SCHEMA_ENUMERATOR(enumerator, text) enumerator,
+#define CLI_SCHEMA_CHOICE_TEXT(enumerator, text) text,
+#define CLI_SCHEMA_CHOICE_ENUM(field, option_name, enum_tag, choice_list, param_flags, doc)        \
+    enum enum_tag { choice_list(CLI_SCHEMA_ENUMERATOR) };
+
+#define CLI_SCHEMA_POSITIONAL_FIELD(field, param_type, doc) CLI_SCHEMA_TYPE_##param_type field;
+#define CLI_SCHEMA_OPTION_FIELD(field, option_name, param_type, param_flags, doc)                  \
+    CLI_SCHEMA_TYPE_##param_type field;
+#define CLI_SCHEMA_CHOICE_FIELD(field, option_name, enum_tag, choice_list, param_flags, doc)       \
+    enum enum_tag field;
+
+#define CLI_SCHEMA_POSITIONAL_INDEX(field, ...) cli_schema_positional_##field,
+#define CLI_SCHEMA_OPTION_INDEX(field, ...) cli_schema_option_##field,
+
+#define CLI_SCHEMA_POSITIONAL_PARAM(field, param_type, doc)                                        \
+    {.name = #field, .description = doc, .type = param_type},
+#define CLI_SCHEMA_OPTION_PARAM(field, option_name, param_type, param_flags, doc)                  \
+    {.name = option_name, .description = doc, .type = param_type, .flags = param_flags},
+#define CLI_SCHEMA_CHOICE_PARAM(field, option_name, enum_tag, choice_list, param_flags, doc)       \
+    {                                                                                              \
+        .name        = option_name,                                                                \
+        .description = doc,                                                                        \
+        .type        = CLI_STR,                                                                    \
+        .flags       = param_flags,                                                                \
+        .validation  = {                                                                           \
+            .strategy = CLI_VALIDATION_CHOICES,                                                    \
+            .choices  = {                                                                          \
+                .count  = sizeof((const char*[]){choice_list(CLI_SCHEMA_CHOICE_TEXT)}) /           \
+                          sizeof(const char*),                                                     \
+                .values = (const char*[]){choice_list(CLI_SCHEMA_CHOICE_TEXT)},                    \
+            },                                                                                     \
+        },                                                                                         \
+    },
+
+#define CLI_SCHEMA_NAME_MATCHES(input, input_length, name)                                         \
+    ((input_length) == sizeof(name) - 1 && memcmp(input, name, sizeof(name) - 1) == 0)
+
+#define CLI_SCHEMA_OPTION_MATCH(field, option_name, param_type, param_flags, doc)                  \
+    if (CLI_SCHEMA_NAME_MATCHES(cli_schema_arg, cli_schema_length, option_name)) {                 \
+        if (!cli_schema_option(                                                                    \
+                argc, argv, &cli_schema_i, option_name, param_type,                                \
+                &cli_schema_seen[cli_schema_option_##field], &result->field, allocator,            \
+                &cli_schema_unused_args, error                                                     \
+            )) {                                                                                   \
+            goto cli_schema_done;                                                                  \
+        }                                                                                          \
+        continue;                                                                                  \
+    }
+
+// the choice is stored only once the input matched one, a repeated option leaves it NULL
+//
+#define CLI_SCHEMA_CHOICE_MATCH(field, option_name, enum_tag, choice_list, param_flags, doc)       \
+    if (CLI_SCHEMA_NAME_MATCHES(cli_schema_arg, cli_schema_length, option_name)) {                 \
+        const char* cli_schema_input = NULL;                                                       \
+        if (!cli_schema_option(                                                                    \
+                argc, argv, &cli_schema_i, option_name, CLI_STR,                                   \
+                &cli_schema_seen[cli_schema_option_##field], &cli_schema_input, allocator,         \
+                &cli_schema_unused_args, error                                                     \
+            )) {                                                                                   \
+            goto cli_schema_done;                                                                  \
+        }                                                                                          \
+        if (cli_schema_input) {                                                                    \
+            const size_t cli_schema_input_length = strlen(cli_schema_input);                       \
+            int          cli_schema_choice       = -1;                                             \
+            choice_list(CLI_SCHEMA_CHOICE_VALUE_MATCH)                                             \
+            if (cli_schema_choice < 0) {                                                           \
+                static const char* const cli_schema_choices[] = {                                  \
+                    choice_list(CLI_SCHEMA_CHOICE_TEXT)                                            \
+                };                                                                                 \
+                cli_schema_invalid_choice(                                                         \
+                    option_name, cli_schema_input, cli_schema_choices,                             \
+                    sizeof cli_schema_choices / sizeof *cli_schema_choices, error                  \
+                );                                                                                 \
+                goto cli_schema_done;                                                              \
+            }                                                                                      \
+            result->field = (enum enum_tag)cli_schema_choice;                                      \
+        }                                                                                          \
+        continue;                                                                                  \
+    }
+#define CLI_SCHEMA_CHOICE_VALUE_MATCH(enumerator, text)                                            \
+    if (cli_schema_choice < 0 &&                                                                   \
+        CLI_SCHEMA_NAME_MATCHES(cli_schema_input, cli_schema_input_length, text)) {                \
+        cli_schema_choice = (int)(enumerator);                                                     \
+    }
+
+// a positional list takes every positional argument from here on
+//
+#define CLI_SCHEMA_POSITIONAL_MATCH(field, param_type, doc)                                        \
+    if (cli_schema_positional == cli_schema_positional_##field) {                                  \
+        if (!cli_schema_store(                                                                     \
+                #field, param_type, cli_schema_arg, &result->field, allocator, error               \
+            )) {                                                                                   \
+            goto cli_schema_done;                                                                  \
+        }                                                                                          \
+        cli_schema_positional += (param_type) != CLI_LIST;                                         \
+        continue;                                                                                  \
+    }
+
+#define CLI_SCHEMA_OPTION_CHECK(field, option_name, param_type, param_flags, doc)                  \
+    if (((param_flags) & CLI_FLAG_OPTION_REQUIRED) &&                                              \
+        !cli_schema_seen[cli_schema_option_##field]) {                                             \
+        cli_schema_missing(option_name, error);                                                    \
+        goto cli_schema_done;                                                                      \
+    }
+#define CLI_SCHEMA_CHOICE_CHECK(field, option_name, enum_tag, choice_list, param_flags, doc)       \
+    CLI_SCHEMA_OPTION_CHECK(field, option_name, CLI_STR, param_flags, doc)
+#define CLI_SCHEMA_POSITIONAL_CHECK(field, param_type, doc)                                        \
+    if (cli_schema_positional <= cli_schema_positional_##field &&                                  \
+        CLI_SCHEMA_EMPTY_##param_type(result->field)) {                                            \
+        cli_schema_missing(#field, error);                                                         \
+        goto cli_schema_done;                                                                      \
+    }
+
+// Used by the parsers CLI_SCHEMA generates, `value` points at the field for `type`.
+//
+bool cli_schema_wants_help(int argc, const char** argv);
+bool cli_schema_store(
+    const char*       name,
+    enum cli_type     type,
+    const char*       input,
+    void*             value,
+    CliAllocator*     allocator,
+    struct cli_error* error
+);
+bool cli_schema_option(
+    int                argc,
+    const char**       argv,
+    int*               arg,
+    const char*        name,
+    enum cli_type      type,
+    bool*              seen,
+    void*              value,
+    CliAllocator*      allocator,
+    struct sv_builder* unused,
+    struct cli_error*  error
+);
+void cli_schema_invalid_choice(
+    const char*        name,
+    const char*        input,
+    const char* const* choices,
+    size_t             choices_count,
+    struct cli_error*  error
+);
+void cli_schema_missing(const char* name, struct cli_error* error);
+void cli_schema_unused(struct sv_builder* unused, const char* arg);
+void cli_schema_finish(struct sv_builder* unused, bool failed, struct cli_error* error);
+
 #ifdef CLI_TEST_MAIN
 
 #ifndef TEST_ASSERT
@@ -88,6 +384,8 @@ void cli_parse_args(
 #include <stdio.h>
 #include <string.h>
 
+#include "filesystem.h"
+
 static void
 assert_error_contains(struct cli_error* error, const char* expected)
 {
@@ -118,6 +416,25 @@ struct expected_value {
     union cli_value value;
 };
 
+// the schema test's parser, options sharing a length and a choice option
+//
+#define TEST_COLORS(X)                                                                             \
+    X(TEST_COLOR_AUTO, "auto")                                                                     \
+    X(TEST_COLOR_ALWAYS, "always")                                                                 \
+    X(TEST_COLOR_NEVER, "never")
+
+#define TEST_SCHEMA(POSITIONAL, OPTION, CHOICE)                                                    \
+    POSITIONAL(pattern, CLI_STR, "pattern to search for")                                          \
+    POSITIONAL(files, CLI_LIST, "files to search")                                                 \
+    OPTION(max_count, "-max", CLI_INT, 0, "stop after this many matches")                          \
+    OPTION(threshold, "-threshold", CLI_FLOAT, 0, "minimum match score")                           \
+    OPTION(ignore_case, "-i", CLI_FLAG, 0, "ignore case")                                          \
+    OPTION(output, "-o", CLI_STR, CLI_FLAG_OPTION_REQUIRED, "output file")                         \
+    OPTION(exclude, "-exclude", CLI_LIST, 0, "files to skip")                                      \
+    CHOICE(color, "-color", test_color, TEST_COLORS, 0, "when to color output")
+
+CLI_SCHEMA(test_grep, "example search", TEST_SCHEMA)
+
 int
 main(void)
 {
@@ -189,6 +506,7 @@ main(void)
                 (struct cli_param*[]){&param1, &param2, &param3, &param4, &param5},
                 2,
                 (const char*[]){program_name, help_options[i]},
+                NULL,
                 &error
             );
             TEST_ASSERT(error.code == CLI_CODE_FAILURE);
@@ -236,6 +554,7 @@ main(void)
             (struct cli_param*[]){&param1, &param2},
             3,
             (const char*[]){program_name, "val1", "val2"},
+            NULL,
             NULL
         );
 
@@ -260,6 +579,7 @@ main(void)
             (struct cli_param*[]){&param1, &param2},
             2,
             (const char*[]){program_name, "val1"},
+            NULL,
             &error
         );
 
@@ -284,6 +604,7 @@ main(void)
             (struct cli_param*[]){&param1, &param2},
             5,
             (const char*[]){program_name, "--opt1", "1", "--opt2", "2"},
+            NULL,
             NULL
         );
 
@@ -307,6 +628,7 @@ main(void)
             (struct cli_param*[]){&param1, &param2},
             5,
             (const char*[]){program_name, "--opt2", "1", "--opt1", "2"},
+            NULL,
             NULL
         );
 
@@ -330,6 +652,7 @@ main(void)
             (struct cli_param*[]){&param1, &param2},
             3,
             (const char*[]){program_name, "--opt1", "1"},
+            NULL,
             NULL
         );
 
@@ -355,6 +678,7 @@ main(void)
             (struct cli_param*[]){&param1, &param2},
             3,
             (const char*[]){program_name, "--opt2", "2"},
+            NULL,
             &error
         );
 
@@ -378,6 +702,7 @@ main(void)
             (struct cli_param*[]){&param1},
             2,
             (const char*[]){program_name, "--opt1"},
+            NULL,
             &error
         );
 
@@ -400,6 +725,7 @@ main(void)
             (struct cli_param*[]){&param1},
             2,
             (const char*[]){program_name, "--opt1"},
+            NULL,
             NULL
         );
 
@@ -420,6 +746,7 @@ main(void)
             (struct cli_param*[]){&param1},
             1,
             (const char*[]){program_name},
+            NULL,
             NULL
         );
 
@@ -455,6 +782,7 @@ main(void)
                 (struct cli_param*[]){&param},
                 2,
                 (const char*[]){program_name, expected[i].input},
+                NULL,
                 NULL
             );
 
@@ -493,6 +821,7 @@ main(void)
                 (struct cli_param*[]){&param},
                 2,
                 (const char*[]){program_name, expected[i].input},
+                NULL,
                 NULL
             );
 
@@ -529,6 +858,7 @@ main(void)
                 (struct cli_param*[]){&param1},
                 2,
                 (const char*[]){program_name, failing_inputs[i]},
+                NULL,
                 &error
             );
 
@@ -590,6 +920,7 @@ main(void)
                 (struct cli_param*[]){&param},
                 2,
                 (const char*[]){program_name, expected[i].input},
+                NULL,
                 NULL
             );
 
@@ -619,6 +950,7 @@ main(void)
                 (struct cli_param*[]){&param1},
                 2,
                 (const char*[]){program_name, failing_inputs[i]},
+                NULL,
                 &error
             );
 
@@ -653,6 +985,7 @@ main(void)
             (struct cli_param*[]){&param},
             2,
             (const char*[]){program_name, "choice3"},
+            NULL,
             &error
         );
 
@@ -685,6 +1018,7 @@ main(void)
             (struct cli_param*[]){&param},
             2,
             (const char*[]){program_name, "456"},
+            NULL,
             NULL
         );
 
@@ -717,6 +1051,7 @@ main(void)
                 (struct cli_param*[]){&param},
                 2,
                 (const char*[]){program_name, out_of_range_values[i]},
+                NULL,
                 &error
             );
             assert_error_contains(&error, out_of_range_values[i]);
@@ -735,6 +1070,7 @@ main(void)
                 (struct cli_param*[]){&param},
                 2,
                 (const char*[]){program_name, in_range_values[i].input},
+                NULL,
                 NULL
             );
             TEST_ASSERT(param.value.i64 == in_range_values[i].value.i64);
@@ -754,6 +1090,7 @@ main(void)
             (struct cli_param*[]){&param},
             4,
             (const char*[]){program_name, "abc", "def", "zzz"},
+            NULL,
             &error
         );
         TEST_ASSERT(error.code == CLI_CODE_WARNING);
@@ -763,6 +1100,349 @@ main(void)
         assert_error_contains(&error, "zzz");
     }
 
+    // repeated options are unused unless they're lists
+    //
+    {
+        struct cli_param option = {.name = "-n", .type = CLI_INT};
+        struct cli_param flag   = {.name = "-v", .type = CLI_FLAG};
+
+        struct cli_error error = {0};
+        cli_parse_args(
+            program_description,
+            2,
+            (struct cli_param*[]){&option, &flag},
+            6,
+            (const char*[]){program_name, "-n", "1", "-v", "-n", "2"},
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_WARNING);
+        TEST_ASSERT(option.value.i64 == 1 && flag.value.present);
+        assert_error_contains(&error, "-n, 2");
+    }
+
+    // an option's value is taken as given even when it looks like an option
+    //
+    {
+        struct cli_param option = {.name = "-a", .type = CLI_STR};
+        struct cli_param other  = {.name = "-b", .type = CLI_FLAG};
+
+        struct cli_error error = {0};
+        cli_parse_args(
+            program_description,
+            2,
+            (struct cli_param*[]){&other, &option},
+            3,
+            (const char*[]){program_name, "-a", "-b"},
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_SUCCESS);
+        TEST_ASSERT(strcmp(option.value.str, "-b") == 0 && !other.value.present);
+    }
+
+    // list options and a trailing positional list, with more arguments than a fixed size
+    // table would hold
+    //
+    {
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 4096);
+
+        struct cli_param output = {.name = "output", .type = CLI_STR};
+        struct cli_param files  = {.name = "files", .type = CLI_LIST};
+        struct cli_param include = {
+            .name  = "-I",
+            .type  = CLI_LIST,
+            .flags = CLI_FLAG_OPTION_REQUIRED,
+        };
+
+        enum { ARG_COUNT = 5000 };
+        static const char* argv[ARG_COUNT];
+        static char        names[ARG_COUNT][16];
+        argv[0] = program_name;
+        argv[1] = "out";
+        for (size_t i = 2; i < ARG_COUNT; i++) {
+            snprintf(names[i], sizeof names[i], "file%zu", i);
+            argv[i] = names[i];
+        }
+        argv[100]  = "-I";
+        argv[2000] = "-I";
+        argv[4999] = "-I";
+        argv[4998] = "-I";
+
+        struct cli_error error = {0};
+        cli_parse_args(
+            program_description,
+            3,
+            (struct cli_param*[]){&output, &include, &files},
+            ARG_COUNT,
+            argv,
+            &arena,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_SUCCESS);
+        TEST_ASSERT(strcmp(output.value.str, "out") == 0);
+        TEST_ASSERT(include.value.list.count == 3);
+        TEST_ASSERT(strcmp(include.value.list.values[0], "file101") == 0);
+        TEST_ASSERT(strcmp(include.value.list.values[1], "file2001") == 0);
+        TEST_ASSERT(strcmp(include.value.list.values[2], "-I") == 0);
+        TEST_ASSERT(files.value.list.count == ARG_COUNT - 2 - 6);
+        TEST_ASSERT(strcmp(files.value.list.values[0], "file2") == 0);
+        TEST_ASSERT(strcmp(files.value.list.values[98], "file102") == 0);
+        cli_free_params(3, (struct cli_param*[]){&output, &include, &files}, &arena);
+        TEST_ASSERT(!files.value.list.count && !files.value.list.values);
+        allocator_destroy(&arena);
+
+        // the required list option and the positional list each need a value
+        //
+        error = (struct cli_error){0};
+        cli_parse_args(
+            program_description,
+            3,
+            (struct cli_param*[]){&output, &include, &files},
+            3,
+            (const char*[]){program_name, "out", "file"},
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+        assert_error_contains(&error, "required option -I");
+        cli_free_params(3, (struct cli_param*[]){&output, &include, &files}, NULL);
+
+        error = (struct cli_error){0};
+        cli_parse_args(
+            program_description,
+            3,
+            (struct cli_param*[]){&output, &include, &files},
+            4,
+            (const char*[]){program_name, "out", "-I", "dir"},
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+        assert_error_contains(&error, "missing positional argument files");
+        cli_free_params(3, (struct cli_param*[]){&output, &include, &files}, NULL);
+    }
+
+    // every value of a list is validated
+    //
+    {
+        struct cli_param list = {
+            .name = "-mode",
+            .type = CLI_LIST,
+            .validation =
+                {
+                    .strategy = CLI_VALIDATION_CHOICES,
+                    .choices =
+                        {
+                            .count  = 2,
+                            .values = (const char*[]){"fast", "slow"},
+                        },
+                },
+        };
+        struct cli_error error = {0};
+        cli_parse_args(
+            program_description,
+            1,
+            (struct cli_param*[]){&list},
+            5,
+            (const char*[]){program_name, "-mode", "fast", "-mode", "medium"},
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+        assert_error_contains(&error, "medium");
+        TEST_ASSERT(list.value.list.count == 1);
+        cli_free_params(1, (struct cli_param*[]){&list}, NULL);
+    }
+
+    // response files
+    //
+    {
+        const char* argfile = "build/test_cli_argfile";
+        const char  content[] = "  out\n-I include 'with space'\t\"quoted \\\"inner\\\"\"\n"
+                                "esc\\ aped '' @not_expanded\n";
+        fs_write_file(argfile, content, sizeof content - 1, NULL);
+
+        struct cli_error error = {0};
+        struct cli_args  args  = cli_expand_args(
+            5,
+            (const char*[]){program_name, "first", "@build/test_cli_argfile", "@", "last"},
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_SUCCESS);
+        const char* expected[] = {
+            program_name,
+            "first",
+            "out",
+            "-I",
+            "include",
+            "with space",
+            "quoted \"inner\"",
+            "esc aped",
+            "",
+            "@not_expanded",
+            "@",
+            "last",
+        };
+        TEST_ASSERT(args.argc == sizeof expected / sizeof *expected);
+        for (int i = 0; i < args.argc; i++) {
+            TEST_ASSERT(strcmp(args.argv[i], expected[i]) == 0);
+        }
+
+        // and then parsed as usual
+        //
+        struct cli_param files   = {.name = "files", .type = CLI_LIST};
+        struct cli_param include = {.name = "-I", .type = CLI_LIST};
+        cli_parse_args(
+            program_description,
+            2,
+            (struct cli_param*[]){&include, &files},
+            args.argc - 4,
+            args.argv,
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_SUCCESS);
+        TEST_ASSERT(include.value.list.count == 1);
+        TEST_ASSERT(strcmp(include.value.list.values[0], "include") == 0);
+        TEST_ASSERT(files.value.list.count == 5);
+        TEST_ASSERT(strcmp(files.value.list.values[2], "with space") == 0);
+        cli_free_params(2, (struct cli_param*[]){&include, &files}, NULL);
+        cli_free_args(&args, NULL);
+
+        fs_write_file(argfile, "fine 'not closed", 16, NULL);
+        args = cli_expand_args(
+            2, (const char*[]){program_name, "@build/test_cli_argfile"}, NULL, &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+        assert_error_contains(&error, "unterminated");
+        TEST_ASSERT(!args.argv && !args.argc);
+
+        error = (struct cli_error){0};
+        args  = cli_expand_args(
+            2, (const char*[]){program_name, "@build/does_not_exist"}, NULL, &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+        assert_error_contains(&error, "does_not_exist");
+        remove(argfile);
+    }
+
+    // schemas
+    //
+    {
+        struct test_grep_args args  = {0};
+        struct cli_error      error = {0};
+        test_grep_parse_args(
+            17,
+            (const char*[]){
+                program_name,
+                "-i",
+                "needle",
+                "-color",
+                "never",
+                "a.c",
+                "-exclude",
+                "x",
+                "b.c",
+                "-max",
+                "10",
+                "-o",
+                "out",
+                "-threshold",
+                "0.5",
+                "-exclude",
+                "y",
+            },
+            &args,
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_SUCCESS);
+        TEST_ASSERT(strcmp(args.pattern, "needle") == 0);
+        TEST_ASSERT(args.files.count == 2);
+        TEST_ASSERT(strcmp(args.files.values[1], "b.c") == 0);
+        TEST_ASSERT(args.max_count == 10);
+        assert_f64_equal(args.threshold, 0.5);
+        TEST_ASSERT(args.ignore_case);
+        TEST_ASSERT(strcmp(args.output, "out") == 0);
+        TEST_ASSERT(args.exclude.count == 2);
+        TEST_ASSERT(strcmp(args.exclude.values[0], "x") == 0);
+        TEST_ASSERT(strcmp(args.exclude.values[1], "y") == 0);
+        TEST_ASSERT(args.color == TEST_COLOR_NEVER);
+        cli_free_list(&args.files, NULL);
+        cli_free_list(&args.exclude, NULL);
+
+        // defaults, the first choice for a choice option
+        //
+        test_grep_parse_args(
+            5, (const char*[]){program_name, "-o", "out", "needle", "a.c"}, &args, NULL, &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_SUCCESS);
+        TEST_ASSERT(args.color == TEST_COLOR_AUTO);
+        TEST_ASSERT(!args.max_count && !args.ignore_case && !args.exclude.count);
+        cli_free_list(&args.files, NULL);
+
+        // repeats are unused the same as with cli_parse_args
+        //
+        test_grep_parse_args(
+            11,
+            (const char*[]){
+                program_name,
+                "-o",
+                "out",
+                "-max",
+                "1",
+                "-color",
+                "always",
+                "-max",
+                "2",
+                "needle",
+                "a.c",
+            },
+            &args,
+            NULL,
+            &error
+        );
+        TEST_ASSERT(error.code == CLI_CODE_WARNING);
+        assert_error_contains(&error, "-max, 2");
+        TEST_ASSERT(args.max_count == 1 && args.color == TEST_COLOR_ALWAYS);
+        cli_free_list(&args.files, NULL);
+
+        const struct {
+            int         argc;
+            const char* argv[8];
+            const char* expected;
+        } failures[] = {
+            {7, {program_name, "-o", "out", "-color", "sometimes", "needle", "a.c"}, "{auto, "},
+            {7, {program_name, "-o", "out", "-color", "sometimes", "needle", "a.c"}, "sometimes"},
+            {7, {program_name, "-o", "out", "-max", "many", "needle", "a.c"}, "integer"},
+            {3, {program_name, "needle", "a.c"}, "required option -o is missing"},
+            {4, {program_name, "-o", "out", "needle"}, "missing positional argument files"},
+            {3, {program_name, "-o", "out"}, "missing positional argument pattern"},
+            {2, {program_name, "-o"}, "option -o has no value specified"},
+        };
+        for (size_t i = 0; i < sizeof failures / sizeof *failures; i++) {
+            error = (struct cli_error){0};
+            test_grep_parse_args(
+                failures[i].argc, (const char**)failures[i].argv, &args, NULL, &error
+            );
+            TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+            assert_error_contains(&error, failures[i].expected);
+            cli_free_list(&args.files, NULL);
+            cli_free_list(&args.exclude, NULL);
+        }
+
+        error = (struct cli_error){0};
+        test_grep_parse_args(2, (const char*[]){program_name, "--help"}, &args, NULL, &error);
+        TEST_ASSERT(error.code == CLI_CODE_FAILURE);
+        assert_error_contains(&error, "example search");
+        assert_error_contains(&error, "pattern (string) - pattern to search for");
+        assert_error_contains(&error, "-exclude (list) - files to skip");
+        assert_error_contains(&error, "{auto, always, never}");
+    }
+
     printf("%s tests passed\n", __FILE__);
     return 0;
 }
@@ -1,15 +1,28 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include "filesystem.h"
 
 static bool        platform_is_absolute_filepath(const char* filepath);
 static void        platform_cwd_to_buffer(char* buffer, size_t buffer_size, struct fs_error*);
 static void        platform_create_directory(const char* filepath, struct fs_error*);
 static void        platform_remove_directory(const char* filepath, struct fs_error*);
+static void        platform_remove_file(const char* filepath, struct fs_error*);
 static bool        platform_path_is_directory(const char* filepath);
 static bool        platform_path_is_file(const char* filepath);
 static bool        platform_path_exists(const char* filepath);
 static void        platform_iterdir_init(struct iterdir*, struct fs_error*);
 static const char* platform_iterdir_step(struct iterdir*, struct fs_error*);
 static void        platform_iterdir_teardown(struct iterdir*);
+static void
+platform_iterdir_entry_info(struct iterdir*, struct fs_entry*, unsigned flags, struct fs_error*);
+static enum fs_entry_type platform_path_type(const char* filepath);
+static void               platform_stat(const char* filepath, struct fs_stat*, struct fs_error*);
+static void
+platform_write_filev(const char*, const struct fs_iovec*, size_t, unsigned, struct fs_error*);
+static struct fs_mapping platform_map_file(const char* filepath, unsigned flags, struct fs_error*);
+static void              platform_unmap_file(struct fs_mapping*);
 
 #ifdef _WIN32
 
@@ -23,12 +36,30 @@ static void        platform_iterdir_teardown(struct iterdir*);
 #define PLATFORM_PATHSEP '/'
 #define PLATFORM_PATHSEP_CSTR "/"
 #define PLATFORM_ROOT_PATH_LENGTH 1
-#ifndef _DEFAULT_SOURCE
-#define _DEFAULT_SOURCE
-#endif
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifdef __APPLE__
+#define PLATFORM_DATASYNC fsync
+#else
+#define PLATFORM_DATASYNC fdatasync
+#endif
+
+#ifdef __linux__
+#define FS_INOTIFY
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#if defined(__linux__) && !defined(FS_NO_IO_URING)
+#define FS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
 
 #endif
 
@@ -49,12 +80,26 @@ struct iterdir {
 
 #include <errno.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <time.h>
 
 static void*
 fs_malloc(size_t size, FilesystemAllocator* allocator)
 {
-    (void)allocator;
-    return FS_DEFAULT_MALLOC(size);
+    if (!allocator) {
+        return FS_DEFAULT_MALLOC(size);
+    }
+    return allocator_malloc(allocator, size);
+}
+
+static void*
+fs_realloc(void* ptr, size_t size, FilesystemAllocator* allocator)
+{
+    if (!allocator) {
+        return FS_DEFAULT_REALLOC(ptr, size);
+    }
+    return allocator_realloc(allocator, ptr, size);
 }
 
 static void
@@ -63,10 +108,53 @@ fs_free(void* ptr, FilesystemAllocator* allocator)
     if (!ptr) {
         return;
     }
-    (void)allocator;
-    FS_DEFAULT_FREE(ptr);
+    if (!allocator) {
+        FS_DEFAULT_FREE(ptr);
+        return;
+    }
+    allocator_free(allocator, ptr);
+}
+
+#ifdef FS_STATS
+static struct {
+    _Atomic(uint64_t) calls;
+    _Atomic(uint64_t) bytes;
+    _Atomic(uint64_t) ns;
+} fs_counters[FS_OPERATION_COUNT];
+
+static fs_trace_callback fs_trace;
+static void*             fs_trace_user_data;
+
+static uint64_t
+fs_now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+fs_trace_record(enum fs_operation operation, const char* filepath, uint64_t bytes, uint64_t start)
+{
+    const uint64_t ns = fs_now_ns() - start;
+    atomic_fetch_add_explicit(&fs_counters[operation].calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fs_counters[operation].bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fs_counters[operation].ns, ns, memory_order_relaxed);
+    if (fs_trace) {
+        fs_trace(operation, filepath, bytes, ns, fs_trace_user_data);
+    }
 }
 
+// FS_TRACE_BEGIN goes at the top of a block and FS_TRACE_END at each of its exits
+//
+#define FS_TRACE_BEGIN() const uint64_t fs_trace_start = fs_now_ns()
+#define FS_TRACE_END(operation, filepath, bytes)                                                   \
+    fs_trace_record((operation), (filepath), (bytes), fs_trace_start)
+#else
+#define FS_TRACE_BEGIN() ((void)0)
+#define FS_TRACE_END(operation, filepath, bytes) ((void)0)
+#endif
+
 #define FS_FATAL_ERRORF(fmt, ...)                                                                  \
     do {                                                                                           \
         fprintf(stderr, "[FILESYSTEM FATAL ERROR]: ");                                             \
@@ -202,6 +290,10 @@ map_windows_error(
             code   = FS_CODE_DIRECTORY_NOT_EMPTY;
             reason = "directory not empty";
             break;
+        case ERROR_DIRECTORY:
+            code   = FS_CODE_NOT_DIRECTORY;
+            reason = "file is not a directory";
+            break;
         default:
             FormatMessage(
                 FORMAT_MESSAGE_FROM_SYSTEM,
@@ -221,7 +313,11 @@ map_windows_error(
 
 static struct fs_content
 read_fs_content_internal(
-    FILE* fp, const char* filepath, FilesystemAllocator* allocator, struct fs_error* error
+    FILE*                fp,
+    const char*          filepath,
+    FilesystemAllocator* allocator,
+    mtx_t*               allocator_lock,
+    struct fs_error*     error
 )
 {
     struct fs_content content = {0};
@@ -240,7 +336,9 @@ read_fs_content_internal(
     content.size = length;
 
     // read the entire file into an allocation
+    if (allocator_lock) mtx_lock(allocator_lock);
     content.data = fs_malloc(content.size + 1, allocator);
+    if (allocator_lock) mtx_unlock(allocator_lock);
     if (!content.data) {
         FS_SET_ERRORF(
             error,
@@ -264,7 +362,9 @@ read_fs_content_internal(
     }
 cleanup:
     if (FS_ERROR_IS_SET(error)) {
+        if (allocator_lock) mtx_lock(allocator_lock);
         fs_free(content.data, allocator);
+        if (allocator_lock) mtx_unlock(allocator_lock);
         content = (struct fs_content){0};
     }
     return content;
@@ -280,6 +380,7 @@ is_absolute_filepath(const char* filepath)
 static void
 assert_fs_path_is_valid(const struct fs_path* path)
 {
+    (void)path;
     FS_ASSERT(path);
     FS_ASSERT(path->length >= PLATFORM_ROOT_PATH_LENGTH);
     FS_ASSERT(is_absolute_filepath(path->buffer));
@@ -296,31 +397,77 @@ fs_path_cwd(struct fs_error* error)
     return fs_path_resolve(intermediate.buffer, error);
 }
 
-static const char*
-skip_chars(const char* filepath, char c)
+// Shortens an absolute path to its parent, the root is its own parent.
+//
+static size_t
+path_parent_length(const char* buffer, size_t length)
 {
-    FS_ASSERT(c != '\0');
-    while (*filepath == c) {
-        filepath++;
+    if (length <= PLATFORM_ROOT_PATH_LENGTH) {
+        return length;
     }
-    return filepath;
+    // remove trailing pathsep
+    if (buffer[length - 1] == PLATFORM_PATHSEP) {
+        length -= 1;
+    }
+    // remove path segment
+    while (buffer[length - 1] != PLATFORM_PATHSEP) {
+        length -= 1;
+    }
+    // remove trailing pathsep (unless it belongs to root)
+    if (length > PLATFORM_ROOT_PATH_LENGTH) {
+        length -= 1;
+    }
+    return length;
 }
 
-static void
-fs_path_append_char(struct fs_path* path, char c, struct fs_error* error)
+// Appends the segments of `other` to the absolute path in `buffer`, resolving "." and ".." as
+// it goes and copying each segment whole. Returns false if the result won't fit, the path is
+// then left valid but cut short at the segment that didn't fit.
+//
+static bool
+path_append_segments(
+    char*       buffer,
+    size_t*     length,
+    size_t      capacity,
+    const char* other,
+    size_t      other_length,
+    char        separator
+)
 {
-    FS_ASSERT(path);
+    size_t      result = *length;
+    const char* end    = other + other_length;
+    bool        fits   = true;
 
-    if (path->length >= sizeof path->buffer - 1) {
-        FS_SET_ERROR(error, FS_CODE_PATH_TOO_LONG, "fs_path buffer overflow");
-        path->buffer[sizeof path->buffer - 1] = '\0';
-        return;
-    }
+    while (other < end) {
+        const char* next = memchr(other, separator, end - other);
+        if (!next) next = end;
+        const size_t segment_length = next - other;
+
+        if (segment_length == 0 || (segment_length == 1 && other[0] == '.')) {
+            ;
+        }
+        else if (segment_length == 2 && other[0] == '.' && other[1] == '.') {
+            result = path_parent_length(buffer, result);
+        }
+        else {
+            const bool needs_pathsep = buffer[result - 1] != PLATFORM_PATHSEP;
+            if (result + needs_pathsep + segment_length >= capacity) {
+                fits = false;
+                break;
+            }
+            if (needs_pathsep) {
+                buffer[result++] = PLATFORM_PATHSEP;
+            }
+            memcpy(buffer + result, other, segment_length);
+            result += segment_length;
+        }
 
-    path->buffer[path->length] = c;
-    if (c != '\0') {
-        path->length += 1;
+        other = (next < end) ? next + 1 : end;
     }
+
+    buffer[result] = '\0';
+    *length        = result;
+    return fits;
 }
 
 struct fs_path
@@ -330,17 +477,12 @@ fs_path_resolve(const char* filepath, struct fs_error* error)
 
     char           expected_pathsep;
     struct fs_path result;
-    result.length = 0;
 
     if (is_absolute_filepath(filepath)) {
         expected_pathsep = PLATFORM_PATHSEP;
-        for (size_t i = 0; i < PLATFORM_ROOT_PATH_LENGTH; i++) {
-            fs_path_append_char(&result, *filepath++, error);
-            if (FS_ERROR_IS_SET(error)) {
-                fs_path_append_char(&result, '\0', error);
-                return (struct fs_path){0};
-            }
-        }
+        memcpy(result.buffer, filepath, PLATFORM_ROOT_PATH_LENGTH);
+        result.length = PLATFORM_ROOT_PATH_LENGTH;
+        filepath += PLATFORM_ROOT_PATH_LENGTH;
     }
     else {
         // relative filepath
@@ -348,55 +490,19 @@ fs_path_resolve(const char* filepath, struct fs_error* error)
         expected_pathsep = '/';
         result           = fs_path_cwd(error);
         if (FS_ERROR_IS_SET(error)) {
-            fs_path_append_char(&result, '\0', error);
             return (struct fs_path){0};
         }
     }
 
-
-    while (1) {
-        filepath            = skip_chars(filepath, expected_pathsep);
-        const char* nextsep = strchr(filepath, expected_pathsep);
-        if (nextsep == NULL) {
-            nextsep = strchr(filepath, '\0');
-        }
-        const size_t segment_length = nextsep - filepath;
-        if (segment_length == 0) {
-            // this can only happen if the next char is '\0' since we skip sequential pathsep chars
-            break;
-        }
-
-        if (strncmp(filepath, ".", segment_length) == 0) {
-            ;
-        }
-        else if (strncmp(filepath, "..", segment_length) == 0) {
-            fs_path_parent_in_place(&result);
-            if (FS_ERROR_IS_SET(error)) {
-                fs_path_append_char(&result, '\0', error);
-                return (struct fs_path){0};
-            }
-        }
-        else {
-            if (result.buffer[result.length - 1] != PLATFORM_PATHSEP) {
-                fs_path_append_char(&result, PLATFORM_PATHSEP, error);
-            }
-            for (size_t i = 0; i < segment_length; i++) {
-                fs_path_append_char(&result, *filepath++, error);
-            }
-            if (FS_ERROR_IS_SET(error)) {
-                fs_path_append_char(&result, '\0', error);
-                return (struct fs_path){0};
-            }
-        }
-
-        if (*nextsep == '\0') {
-            break;
-        }
-        filepath = nextsep + 1;
-    }
-
-    fs_path_append_char(&result, '\0', error);
-    if (FS_ERROR_IS_SET(error)) {
+    if (!path_append_segments(
+            result.buffer,
+            &result.length,
+            sizeof result.buffer,
+            filepath,
+            strlen(filepath),
+            expected_pathsep
+        )) {
+        FS_SET_ERROR(error, FS_CODE_PATH_TOO_LONG, "fs_path buffer overflow");
         return (struct fs_path){0};
     }
 
@@ -419,48 +525,131 @@ fs_path_join_in_place(struct fs_path* path, const char* other, struct fs_error*
         return;
     }
 
-    while (1) {
-        other               = skip_chars(other, '/');
-        const char* nextsep = strchr(other, '/');
-        if (nextsep == NULL) {
-            nextsep = strchr(other, '\0');
-        }
-        const size_t segment_length = nextsep - other;
-        if (segment_length == 0) {
-            break;
-        }
+    if (!path_append_segments(
+            path->buffer, &path->length, sizeof path->buffer, other, strlen(other), '/'
+        )) {
+        FS_SET_ERROR(error, FS_CODE_PATH_TOO_LONG, "fs_path buffer overflow");
+    }
+}
 
-        if (strncmp(other, ".", segment_length) == 0) {
-            other += 1;
-        }
-        else if (strncmp(other, "..", segment_length) == 0) {
-            other += 2;
-            fs_path_parent_in_place(path);
-            if (FS_ERROR_IS_SET(error)) {
-                return;
-            }
+void
+fs_path_builder_init(
+    struct fs_path_builder* builder, const struct fs_path* base, FilesystemAllocator* allocator
+)
+{
+    FS_ASSERT(builder);
+    assert_fs_path_is_valid(base);
+
+    builder->data      = builder->storage;
+    builder->capacity  = sizeof builder->storage;
+    builder->allocator = allocator;
+    builder->length    = base->length;
+    memcpy(builder->data, base->buffer, base->length + 1);
+}
+
+void
+fs_path_builder_push(
+    struct fs_path_builder* builder, struct string_view relative, struct fs_error* error
+)
+{
+    FS_ASSERT(builder && builder->data);
+
+    if (relative.length == 0) {
+        return;
+    }
+    if (is_absolute_filepath(relative.data)) {
+        FS_SET_ERROR(
+            error, FS_CODE_INVALID_PATH, "cannot join an absolute path into an existing path"
+        );
+        return;
+    }
+
+    // normalizing never adds more than a separator to what is appended
+    //
+    const size_t required = builder->length + relative.length + 2;
+    if (required > builder->capacity) {
+        size_t capacity = builder->capacity * 2;
+        if (capacity < required) capacity = required;
+        char* data = fs_malloc(capacity, builder->allocator);
+        if (!data) {
+            FS_SET_ERRORF(
+                error, FS_CODE_OUT_OF_MEMORY, "failed to grow path to %zu bytes", capacity
+            );
+            return;
         }
-        else {
-            if (path->buffer[path->length - 1] != PLATFORM_PATHSEP) {
-                fs_path_append_char(path, PLATFORM_PATHSEP, error);
-            }
-            for (size_t i = 0; i < segment_length; i++) {
-                fs_path_append_char(path, *other++, error);
-            }
-            if (FS_ERROR_IS_SET(error)) {
-                return;
-            }
+        memcpy(data, builder->data, builder->length + 1);
+        if (builder->data != builder->storage) {
+            fs_free(builder->data, builder->allocator);
         }
+        builder->data     = data;
+        builder->capacity = capacity;
+    }
+
+    path_append_segments(
+        builder->data, &builder->length, builder->capacity, relative.data, relative.length, '/'
+    );
+}
+
+void
+fs_path_builder_pop(struct fs_path_builder* builder)
+{
+    FS_ASSERT(builder && builder->data);
+    builder->length                = path_parent_length(builder->data, builder->length);
+    builder->data[builder->length] = '\0';
+}
+
+void
+fs_path_builder_truncate(struct fs_path_builder* builder, size_t length)
+{
+    FS_ASSERT(builder && builder->data);
+    FS_ASSERT(length >= PLATFORM_ROOT_PATH_LENGTH && length <= builder->length);
+    builder->length                = length;
+    builder->data[builder->length] = '\0';
+}
+
+struct string_view
+fs_path_builder_view(const struct fs_path_builder* builder)
+{
+    FS_ASSERT(builder && builder->data);
+    return (struct string_view){.length = builder->length, .data = builder->data};
+}
+
+struct fs_path
+fs_path_builder_to_path(const struct fs_path_builder* builder, struct fs_error* error)
+{
+    FS_ASSERT(builder && builder->data);
+
+    struct fs_path path;
+    if (builder->length >= sizeof path.buffer) {
+        FS_SET_ERROR(error, FS_CODE_PATH_TOO_LONG, "fs_path buffer overflow");
+        return (struct fs_path){0};
     }
+    memcpy(path.buffer, builder->data, builder->length + 1);
+    path.length = builder->length;
+    return path;
+}
 
-    fs_path_append_char(path, '\0', error);
+void
+fs_path_builder_free(struct fs_path_builder* builder)
+{
+    if (!builder) {
+        return;
+    }
+    if (builder->data && builder->data != builder->storage) {
+        fs_free(builder->data, builder->allocator);
+    }
+    builder->data     = NULL;
+    builder->length   = 0;
+    builder->capacity = 0;
 }
 
 struct fs_path
 fs_path_join(const struct fs_path* path, const char* other, struct fs_error* error)
 {
     assert_fs_path_is_valid(path);
-    struct fs_path copy = *path;
+    struct fs_path copy;
+    copy.length = path->length;
+    memcpy(copy.buffer, path->buffer, path->length + 1);
     fs_path_join_in_place(&copy, other, error);
     return copy;
 }
@@ -469,21 +658,7 @@ void
 fs_path_parent_in_place(struct fs_path* path)
 {
     assert_fs_path_is_valid(path);
-    if (path->length <= PLATFORM_ROOT_PATH_LENGTH) {
-        return;
-    }
-    // remove trailing pathsep
-    if (path->buffer[path->length - 1] == PLATFORM_PATHSEP) {
-        path->length -= 1;
-    }
-    // remove path segment
-    while (path->buffer[path->length - 1] != PLATFORM_PATHSEP) {
-        path->length -= 1;
-    }
-    // remove trailing pathsep (unless it belongs to root)
-    if (path->length > PLATFORM_ROOT_PATH_LENGTH) {
-        path->length -= 1;
-    }
+    path->length               = path_parent_length(path->buffer, path->length);
     path->buffer[path->length] = '\0';
 }
 
@@ -511,91 +686,123 @@ fs_path_mkdir(const struct fs_path* path, bool force, struct fs_error* error)
         return;
     }
 
+    FS_TRACE_BEGIN();
     platform_create_directory(path->buffer, error);
+    FS_TRACE_END(FS_OPERATION_MKDIR, path->buffer, 0);
 }
 
-void
-fs_path_rmfile(const struct fs_path* path, struct fs_error* error)
+static void
+remove_file(const struct fs_path* path, struct fs_error* error)
 {
-    assert_fs_path_is_valid(path);
-
-    if (!fs_path_exists(path)) {
+    const enum fs_entry_type type = platform_path_type(path->buffer);
+    if (type == FS_ENTRY_UNKNOWN) {
         map_errno("failed to remove file", ENOENT, FS_CODE_FILE_NOT_FOUND, path->buffer, error);
         return;
     }
-    if (fs_path_is_dir(path)) {
+    if (type == FS_ENTRY_DIRECTORY) {
         map_errno("failed to remove file", EISDIR, FS_CODE_IS_A_DIRECTORY, path->buffer, error);
         return;
     }
 
-    if (remove(path->buffer) == -1) {
-        map_errno("failed to remove file", errno, FS_CODE_UNSPECIFIED, path->buffer, error);
-    }
+    platform_remove_file(path->buffer, error);
 }
 
 void
-fs_path_rmdir(const struct fs_path* path, bool force, struct fs_error* error)
+fs_path_rmfile(const struct fs_path* path, struct fs_error* error)
 {
     assert_fs_path_is_valid(path);
+    FS_TRACE_BEGIN();
+    remove_file(path, error);
+    FS_TRACE_END(FS_OPERATION_REMOVE, path->buffer, 0);
+}
+
+// A forced rmdir is a walk that removes everything but directories on the way down and the
+// directories themselves on the way back up. The entry types decide what gets recursed into,
+// so there is no stat per entry and symlinks are removed rather than followed.
+//
+static enum fs_walk_action
+remove_directory_tree_visit(
+    const struct fs_entry* entry, size_t depth, void* user_data, struct fs_error* error
+)
+{
+    (void)depth;
+    (void)user_data;
+    if (entry->type != FS_ENTRY_DIRECTORY) {
+        platform_remove_file(entry->path.buffer, error);
+    }
+    return FS_WALK_CONTINUE;
+}
+
+static enum fs_walk_action
+remove_directory_tree_post_visit(
+    const struct fs_entry* entry, size_t depth, void* user_data, struct fs_error* error
+)
+{
+    (void)depth;
+    (void)user_data;
+    platform_remove_directory(entry->path.buffer, error);
+    return FS_WALK_CONTINUE;
+}
 
-    if (!fs_path_exists(path)) {
+static void
+remove_directory(const struct fs_path* path, bool force, struct fs_error* error)
+{
+    const enum fs_entry_type type = platform_path_type(path->buffer);
+    if (type == FS_ENTRY_UNKNOWN) {
         map_errno(
             "failed to remove directory", ENOENT, FS_CODE_FILE_NOT_FOUND, path->buffer, error
         );
         return;
     }
-    if (!fs_path_is_dir(path)) {
+    if (type != FS_ENTRY_DIRECTORY) {
         map_errno(
             "failed to remove directory", ENOTDIR, FS_CODE_NOT_DIRECTORY, path->buffer, error
         );
         return;
     }
 
-
     if (force) {
-        FilesystemDirectoryIterator iterator = fs_iterdir(path, NULL, error);
+        fs_walk(
+            path,
+            remove_directory_tree_visit,
+            NULL,
+            &(struct fs_walk_options){.post_visit = remove_directory_tree_post_visit},
+            error
+        );
         if (FS_ERROR_IS_SET(error)) {
             return;
         }
-
-        struct fs_path entry;
-        while (fs_iterdir_next(iterator, &entry, error)) {
-            if (FS_ERROR_IS_SET(error)) {
-                fs_iterdir_free(iterator);
-                return;
-            }
-
-            if (fs_path_is_dir(&entry)) {
-                fs_path_rmdir(&entry, force, error);
-            }
-            else {
-                fs_path_rmfile(&entry, error);
-            }
-            if (FS_ERROR_IS_SET(error)) {
-                fs_iterdir_free(iterator);
-                return;
-            }
-        }
-
-        fs_iterdir_free(iterator);
     }
-
-
     platform_remove_directory(path->buffer, error);
 }
 
+void
+fs_path_rmdir(const struct fs_path* path, bool force, struct fs_error* error)
+{
+    assert_fs_path_is_valid(path);
+    FS_TRACE_BEGIN();
+    remove_directory(path, force, error);
+    FS_TRACE_END(FS_OPERATION_REMOVE, path->buffer, 0);
+}
+
 bool
 fs_path_is_dir(const struct fs_path* path)
 {
     assert_fs_path_is_valid(path);
-    return platform_path_is_directory(path->buffer);
+    FS_TRACE_BEGIN();
+    const bool is_dir = platform_path_is_directory(path->buffer);
+    FS_TRACE_END(FS_OPERATION_STAT, path->buffer, 0);
+    return is_dir;
 }
 
 bool
 fs_path_exists(const struct fs_path* path)
 {
     assert_fs_path_is_valid(path);
-    return platform_path_exists(path->buffer);
+    FS_TRACE_BEGIN();
+    const bool exists = platform_path_exists(path->buffer);
+    FS_TRACE_END(FS_OPERATION_STAT, path->buffer, 0);
+    return exists;
 }
 
 bool
@@ -610,75 +817,542 @@ bool
 fs_path_is_file(const struct fs_path* path)
 {
     assert_fs_path_is_valid(path);
-    return platform_path_is_file(path->buffer);
+    FS_TRACE_BEGIN();
+    const bool is_file = platform_path_is_file(path->buffer);
+    FS_TRACE_END(FS_OPERATION_STAT, path->buffer, 0);
+    return is_file;
 }
 
-const char*
-fs_path_filename(const struct fs_path* path, size_t* length)
+struct fs_stat
+fs_path_stat(const struct fs_path* path, struct fs_error* error)
 {
     assert_fs_path_is_valid(path);
-    FS_ASSERT(length);
+    FS_TRACE_BEGIN();
+    struct fs_stat stat = {0};
+    platform_stat(path->buffer, &stat, error);
+    FS_TRACE_END(FS_OPERATION_STAT, path->buffer, 0);
+    return stat;
+}
 
-    const char* filepath = path->buffer;
-    const char* start    = filepath;
-    const char* stop     = NULL;
+#define STAT_CACHE_NO_WATCH UINT32_MAX
 
-    char c;
-    while (1) {
-        c = *filepath;
-        if (c == '.') {
-            stop = filepath;
-        }
-        if (c == PLATFORM_PATHSEP) {
-            start = filepath + 1;
-        }
-        if (c == '\0') {
-            stop = (stop) ? stop : filepath;
-            break;
-        }
-        filepath++;
-    }
+struct stat_cache_entry {
+    uint64_t       hash;  // 0 marks an empty slot
+    char*          path;
+    size_t         length;
+    struct fs_stat stat;
+    unsigned       generation;  // of the cache when this was stat'd
+    uint32_t       watch;       // of the directory holding the path
+    unsigned       watch_generation;
+};
 
-    const int difference = stop - start;
-    if (difference <= 0) {
-        *length = 0;
-        return filepath;
-    }
+// A watched directory, the watcher thread bumps the generation for any change inside it.
+//
+struct stat_cache_watch {
+    atomic_int  wd;  // -1 once the kernel has dropped the watch
+    atomic_uint generation;
+    uint64_t    hash;
+    char*       path;
+    size_t      length;
+};
 
-    *length = (size_t)difference;
-    return start;
-}
+struct stat_cache {
+    FilesystemAllocator*     allocator;
+    unsigned                 flags;
+    atomic_uint              generation;
+    struct stat_cache_entry* entries;
+    size_t                   count;
+    size_t                   capacity;  // a power of two
+#ifdef FS_INOTIFY
+    int                      inotify_fd;
+    int                      shutdown_pipe[2];
+    thrd_t                   watcher;
+    struct stat_cache_watch* watches;
+    size_t                   watch_count;
+    uint32_t*                watch_index;  // open addressing over the directory hashes
+    atomic_uint*             watch_of_wd;  // wds beyond the table just invalidate everything
+#endif
+};
 
-const char*
-fs_path_ext(const struct fs_path* path, size_t* length)
-{
-    assert_fs_path_is_valid(path);
-    FS_ASSERT(length);
+#define STAT_CACHE_WATCH_INDEX_CAPACITY (FS_STAT_CACHE_MAX_WATCHES * 2)
+#define STAT_CACHE_WD_CAPACITY (FS_STAT_CACHE_MAX_WATCHES * 4)
 
-    size_t      filename_length;
-    const char* filename = fs_path_filename(path, &filename_length);
-    const char* last_dot = strrchr(filename, '.');
-    if (!last_dot) {
-        *length = 0;
-        return "";
+static uint64_t
+stat_cache_hash(const char* path, size_t length)
+{
+    // FNV-1a, never 0 so 0 can mark empty slots
+    //
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 0x100000001b3ull;
     }
-    *length = strlen(last_dot + 1);
-    return last_dot + 1;
+    return (hash) ? hash : 1;
 }
 
-struct fs_content
-fs_path_read_text(
-    const struct fs_path* path, FilesystemAllocator* allocator, struct fs_error* error
-)
+static char*
+stat_cache_copy_path(struct stat_cache* cache, const char* path, size_t length)
 {
-    assert_fs_path_is_valid(path);
-    if (fs_path_is_dir(path)) {
+    char* copy = fs_malloc(length + 1, cache->allocator);
+    if (copy) {
+        memcpy(copy, path, length + 1);
+    }
+    return copy;
+}
+
+#ifdef FS_INOTIFY
+
+static int
+stat_cache_watcher_main(void* arg)
+{
+    struct stat_cache* cache = arg;
+    _Alignas(struct inotify_event) char buffer[4096];
+
+    for (;;) {
+        struct pollfd fds[2] = {
+            {.fd = cache->inotify_fd, .events = POLLIN},
+            {.fd = cache->shutdown_pipe[0], .events = POLLIN},
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            atomic_fetch_add(&cache->generation, 1);
+            return 0;
+        }
+        if (fds[1].revents) {
+            return 0;
+        }
+
+        const ssize_t length = read(cache->inotify_fd, buffer, sizeof buffer);
+        if (length <= 0) {
+            continue;
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+            offset += sizeof *event + event->len;
+
+            const unsigned watch = (event->wd >= 0 && event->wd < STAT_CACHE_WD_CAPACITY)
+                                       ? atomic_load(&cache->watch_of_wd[event->wd])
+                                       : STAT_CACHE_NO_WATCH;
+            if ((event->mask & IN_Q_OVERFLOW) || watch == STAT_CACHE_NO_WATCH) {
+                atomic_fetch_add(&cache->generation, 1);
+                continue;
+            }
+            atomic_fetch_add(&cache->watches[watch].generation, 1);
+            if (event->mask & IN_IGNORED) {
+                atomic_store(&cache->watches[watch].wd, -1);
+            }
+        }
+    }
+}
+
+// Finds or adds the watch on a directory, STAT_CACHE_NO_WATCH when it can't be watched.
+//
+static uint32_t
+stat_cache_watch_directory(struct stat_cache* cache, const char* path, size_t length)
+{
+    const uint64_t hash = stat_cache_hash(path, length);
+    const size_t   mask = STAT_CACHE_WATCH_INDEX_CAPACITY - 1;
+
+    size_t slot = hash & mask;
+    for (; cache->watch_index[slot] != STAT_CACHE_NO_WATCH; slot = (slot + 1) & mask) {
+        struct stat_cache_watch* watch = &cache->watches[cache->watch_index[slot]];
+        if (watch->hash == hash && watch->length == length &&
+            memcmp(watch->path, path, length) == 0) {
+            if (atomic_load(&watch->wd) >= 0) {
+                return cache->watch_index[slot];
+            }
+            break;  // the kernel dropped it, watch it again
+        }
+    }
+
+    const uint32_t mask_events = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                 IN_ATTRIB | IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF |
+                                 IN_ONLYDIR;
+    const int wd = inotify_add_watch(cache->inotify_fd, path, mask_events);
+    if (wd < 0 || wd >= STAT_CACHE_WD_CAPACITY) {
+        if (wd >= 0) inotify_rm_watch(cache->inotify_fd, wd);
+        return STAT_CACHE_NO_WATCH;
+    }
+
+    uint32_t index;
+    if (cache->watch_index[slot] != STAT_CACHE_NO_WATCH) {
+        index = cache->watch_index[slot];
+    }
+    else {
+        if (cache->watch_count == FS_STAT_CACHE_MAX_WATCHES) {
+            inotify_rm_watch(cache->inotify_fd, wd);
+            return STAT_CACHE_NO_WATCH;
+        }
+        char* copy = stat_cache_copy_path(cache, path, length);
+        if (!copy) {
+            inotify_rm_watch(cache->inotify_fd, wd);
+            return STAT_CACHE_NO_WATCH;
+        }
+        index                          = (uint32_t)cache->watch_count++;
+        struct stat_cache_watch* watch = &cache->watches[index];
+        watch->hash                    = hash;
+        watch->path                    = copy;
+        watch->length                  = length;
+        atomic_init(&watch->generation, 0);
+        cache->watch_index[slot] = index;
+    }
+    atomic_store(&cache->watch_of_wd[wd], index);
+    atomic_store(&cache->watches[index].wd, wd);
+    return index;
+}
+
+#endif  // FS_INOTIFY
+
+FilesystemStatCache
+fs_stat_cache_create(unsigned flags, FilesystemAllocator* allocator, struct fs_error* error)
+{
+    struct stat_cache* cache = fs_malloc(sizeof *cache, allocator);
+    if (!cache) {
+        FS_SET_ERROR(error, FS_CODE_OUT_OF_MEMORY, "failed to allocate stat cache");
+        return NULL;
+    }
+    *cache = (struct stat_cache){.allocator = allocator, .flags = flags};
+
+    if (flags & FS_STAT_CACHE_WATCH) {
+#ifdef FS_INOTIFY
+        const size_t watches_size     = FS_STAT_CACHE_MAX_WATCHES * sizeof *cache->watches;
+        const size_t watch_index_size = STAT_CACHE_WATCH_INDEX_CAPACITY * sizeof(uint32_t);
+        const size_t watch_of_wd_size = STAT_CACHE_WD_CAPACITY * sizeof *cache->watch_of_wd;
+        cache->watches                = fs_malloc(watches_size, allocator);
+        cache->watch_index            = fs_malloc(watch_index_size, allocator);
+        cache->watch_of_wd            = fs_malloc(watch_of_wd_size, allocator);
+        if (!cache->watches || !cache->watch_index || !cache->watch_of_wd) {
+            FS_SET_ERROR(error, FS_CODE_OUT_OF_MEMORY, "failed to allocate stat cache watches");
+            fs_free(cache->watch_of_wd, allocator);
+            fs_free(cache->watch_index, allocator);
+            fs_free(cache->watches, allocator);
+            fs_free(cache, allocator);
+            return NULL;
+        }
+        for (size_t i = 0; i < STAT_CACHE_WATCH_INDEX_CAPACITY; i++) {
+            cache->watch_index[i] = STAT_CACHE_NO_WATCH;
+        }
+        for (size_t i = 0; i < STAT_CACHE_WD_CAPACITY; i++) {
+            atomic_init(&cache->watch_of_wd[i], STAT_CACHE_NO_WATCH);
+        }
+
+        cache->inotify_fd    = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        const int pipe_error = (cache->inotify_fd < 0) ? -1 : pipe(cache->shutdown_pipe);
+        if (cache->inotify_fd < 0 || pipe_error != 0 ||
+            thrd_create(&cache->watcher, stat_cache_watcher_main, cache) != thrd_success) {
+            const int code = errno;
+            if (cache->inotify_fd >= 0) close(cache->inotify_fd);
+            if (cache->inotify_fd >= 0 && pipe_error == 0) {
+                close(cache->shutdown_pipe[0]);
+                close(cache->shutdown_pipe[1]);
+            }
+            fs_free(cache->watch_of_wd, allocator);
+            fs_free(cache->watch_index, allocator);
+            fs_free(cache->watches, allocator);
+            fs_free(cache, allocator);
+            map_errno("failed to start stat cache watcher", code, FS_CODE_UNSPECIFIED, "", error);
+            return NULL;
+        }
+#else
+        fs_free(cache, allocator);
+        FS_SET_ERROR(
+            error, FS_CODE_UNSPECIFIED, "stat cache watching is not supported on this platform"
+        );
+        return NULL;
+#endif
+    }
+    return cache;
+}
+
+void
+fs_stat_cache_destroy(FilesystemStatCache cache)
+{
+    if (!cache) {
+        return;
+    }
+
+#ifdef FS_INOTIFY
+    if (cache->flags & FS_STAT_CACHE_WATCH) {
+        const char byte = 0;
+        while (write(cache->shutdown_pipe[1], &byte, 1) < 0 && errno == EINTR)
+            ;
+        thrd_join(cache->watcher, NULL);
+        close(cache->shutdown_pipe[0]);
+        close(cache->shutdown_pipe[1]);
+        close(cache->inotify_fd);
+        for (size_t i = 0; i < cache->watch_count; i++) {
+            fs_free(cache->watches[i].path, cache->allocator);
+        }
+        fs_free(cache->watch_of_wd, cache->allocator);
+        fs_free(cache->watch_index, cache->allocator);
+        fs_free(cache->watches, cache->allocator);
+    }
+#endif
+
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].hash) {
+            fs_free(cache->entries[i].path, cache->allocator);
+        }
+    }
+    fs_free(cache->entries, cache->allocator);
+    fs_free(cache, cache->allocator);
+}
+
+static struct stat_cache_entry*
+stat_cache_find(struct stat_cache* cache, uint64_t hash, const char* path, size_t length)
+{
+    if (cache->capacity == 0) {
+        return NULL;
+    }
+    const size_t mask = cache->capacity - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        struct stat_cache_entry* entry = &cache->entries[slot];
+        if (entry->hash == 0) {
+            return entry;
+        }
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->path, path, length) == 0) {
+            return entry;
+        }
+    }
+}
+
+static bool
+stat_cache_grow(struct stat_cache* cache)
+{
+    const size_t             capacity = (cache->capacity) ? cache->capacity * 2 : 256;
+    struct stat_cache_entry* entries  = fs_malloc(capacity * sizeof *entries, cache->allocator);
+    if (!entries) {
+        return false;
+    }
+    memset(entries, 0, capacity * sizeof *entries);
+
+    for (size_t i = 0; i < cache->capacity; i++) {
+        const struct stat_cache_entry* entry = &cache->entries[i];
+        if (entry->hash == 0) continue;
+        size_t slot = entry->hash & (capacity - 1);
+        while (entries[slot].hash) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = *entry;
+    }
+    fs_free(cache->entries, cache->allocator);
+    cache->entries  = entries;
+    cache->capacity = capacity;
+    return true;
+}
+
+static bool
+stat_cache_entry_is_valid(struct stat_cache* cache, const struct stat_cache_entry* entry)
+{
+    if (entry->generation != atomic_load_explicit(&cache->generation, memory_order_acquire)) {
+        return false;
+    }
+#ifdef FS_INOTIFY
+    if (cache->flags & FS_STAT_CACHE_WATCH) {
+        // a path whose directory couldn't be watched is never trusted
+        //
+        if (entry->watch == STAT_CACHE_NO_WATCH) {
+            return false;
+        }
+        const struct stat_cache_watch* watch = &cache->watches[entry->watch];
+        return entry->watch_generation ==
+               atomic_load_explicit(&watch->generation, memory_order_acquire);
+    }
+#endif
+    return true;
+}
+
+struct fs_stat
+fs_stat_cache_get(FilesystemStatCache cache, const struct fs_path* path, struct fs_error* error)
+{
+    FS_ASSERT(cache);
+    assert_fs_path_is_valid(path);
+
+    const uint64_t           hash  = stat_cache_hash(path->buffer, path->length);
+    struct stat_cache_entry* entry = stat_cache_find(cache, hash, path->buffer, path->length);
+    if (entry && entry->hash && stat_cache_entry_is_valid(cache, entry)) {
+        return entry->stat;
+    }
+
+    if (!entry || entry->hash == 0) {
+        if ((cache->count + 1) * 2 > cache->capacity) {
+            if (!stat_cache_grow(cache)) {
+                FS_SET_ERROR(error, FS_CODE_OUT_OF_MEMORY, "failed to grow stat cache");
+                return (struct fs_stat){0};
+            }
+        }
+        entry = stat_cache_find(cache, hash, path->buffer, path->length);
+        char* copy = stat_cache_copy_path(cache, path->buffer, path->length);
+        if (!copy) {
+            FS_SET_ERROR(error, FS_CODE_OUT_OF_MEMORY, "failed to copy path into stat cache");
+            return (struct fs_stat){0};
+        }
+        *entry = (struct stat_cache_entry){
+            .hash   = hash,
+            .path   = copy,
+            .length = path->length,
+            .watch  = STAT_CACHE_NO_WATCH,
+        };
+        cache->count++;
+    }
+
+    // the watch and the generations are taken before the stat, so a change that races with it
+    // at worst makes the entry look stale when it isn't
+    //
+#ifdef FS_INOTIFY
+    if (cache->flags & FS_STAT_CACHE_WATCH) {
+        const size_t directory_length = path_parent_length(path->buffer, path->length);
+        char         directory[FS_PATH_MAX];
+        memcpy(directory, path->buffer, directory_length);
+        directory[directory_length] = '\0';
+        entry->watch = stat_cache_watch_directory(cache, directory, directory_length);
+        if (entry->watch != STAT_CACHE_NO_WATCH) {
+            entry->watch_generation = atomic_load(&cache->watches[entry->watch].generation);
+        }
+    }
+#endif
+    entry->generation = atomic_load(&cache->generation);
+
+    struct fs_error stat_error = {0};
+    entry->stat                = (struct fs_stat){0};
+    platform_stat(path->buffer, &entry->stat, &stat_error);
+    if (stat_error.code != FS_CODE_SUCCESS) {
+        entry->generation -= 1;
+        FS_SET_ERRORF(error, stat_error.code, "%s", stat_error.reason);
+        return (struct fs_stat){0};
+    }
+    return entry->stat;
+}
+
+bool
+fs_stat_cache_exists(FilesystemStatCache cache, const struct fs_path* path)
+{
+    struct fs_error error = {0};
+    return fs_stat_cache_get(cache, path, &error).type != FS_ENTRY_UNKNOWN;
+}
+
+bool
+fs_stat_cache_is_dir(FilesystemStatCache cache, const struct fs_path* path)
+{
+    struct fs_error error = {0};
+    return fs_stat_cache_get(cache, path, &error).type == FS_ENTRY_DIRECTORY;
+}
+
+bool
+fs_stat_cache_is_file(FilesystemStatCache cache, const struct fs_path* path)
+{
+    struct fs_error error = {0};
+    return fs_stat_cache_get(cache, path, &error).type == FS_ENTRY_FILE;
+}
+
+void
+fs_stat_cache_invalidate(FilesystemStatCache cache, const struct fs_path* path)
+{
+    FS_ASSERT(cache);
+    assert_fs_path_is_valid(path);
+
+    const uint64_t           hash  = stat_cache_hash(path->buffer, path->length);
+    struct stat_cache_entry* entry = stat_cache_find(cache, hash, path->buffer, path->length);
+    if (entry && entry->hash) {
+        entry->generation = atomic_load(&cache->generation) - 1;
+    }
+}
+
+void
+fs_stat_cache_invalidate_all(FilesystemStatCache cache)
+{
+    FS_ASSERT(cache);
+    atomic_fetch_add(&cache->generation, 1);
+}
+
+const char*
+fs_path_filename(const struct fs_path* path, size_t* length)
+{
+    assert_fs_path_is_valid(path);
+    FS_ASSERT(length);
+
+    const char* filepath = path->buffer;
+    const char* start    = filepath;
+    const char* stop     = NULL;
+
+    char c;
+    while (1) {
+        c = *filepath;
+        if (c == '.') {
+            stop = filepath;
+        }
+        if (c == PLATFORM_PATHSEP) {
+            start = filepath + 1;
+        }
+        if (c == '\0') {
+            stop = (stop) ? stop : filepath;
+            break;
+        }
+        filepath++;
+    }
+
+    const int difference = stop - start;
+    if (difference <= 0) {
+        *length = 0;
+        return filepath;
+    }
+
+    *length = (size_t)difference;
+    return start;
+}
+
+const char*
+fs_path_ext(const struct fs_path* path, size_t* length)
+{
+    assert_fs_path_is_valid(path);
+    FS_ASSERT(length);
+
+    size_t      filename_length;
+    const char* filename = fs_path_filename(path, &filename_length);
+    const char* last_dot = strrchr(filename, '.');
+    if (!last_dot) {
+        *length = 0;
+        return "";
+    }
+    *length = strlen(last_dot + 1);
+    return last_dot + 1;
+}
+
+struct fs_content
+fs_path_read_text(
+    const struct fs_path* path, FilesystemAllocator* allocator, struct fs_error* error
+)
+{
+    assert_fs_path_is_valid(path);
+    if (fs_path_is_dir(path)) {
         map_errno("failed to read file", EISDIR, FS_CODE_IS_A_DIRECTORY, path->buffer, error);
         return (struct fs_content){0};
     }
     return fs_read_file_text(path->buffer, allocator, error);
 }
 
+struct fs_mapping
+fs_path_map(const struct fs_path* path, unsigned flags, struct fs_error* error)
+{
+    assert_fs_path_is_valid(path);
+    return fs_map_file(path->buffer, flags, error);
+}
+
+struct fs_stream
+fs_path_stream(
+    const struct fs_path* path,
+    void*                 buffer,
+    size_t                buffer_size,
+    unsigned              flags,
+    FilesystemAllocator*  allocator,
+    struct fs_error*      error
+)
+{
+    assert_fs_path_is_valid(path);
+    return fs_stream_open(path->buffer, buffer, buffer_size, flags, allocator, error);
+}
+
 struct fs_content
 fs_path_read_binary(
     const struct fs_path* path, FilesystemAllocator* allocator, struct fs_error* error
@@ -699,30 +1373,44 @@ fs_path_write(const struct fs_path* path, void* data, size_t nbytes, struct fs_e
     fs_write_file(path->buffer, data, nbytes, error);
 }
 
+void
+fs_path_writev(
+    const struct fs_path*  path,
+    const struct fs_iovec* iov,
+    size_t                 count,
+    unsigned               flags,
+    struct fs_error*       error
+)
+{
+    assert_fs_path_is_valid(path);
+    fs_write_filev(path->buffer, iov, count, flags, error);
+}
+
 FilesystemDirectoryIterator
 fs_iterdir(const struct fs_path* path, FilesystemAllocator* allocator, struct fs_error* error)
 {
     assert_fs_path_is_valid(path);
 
-    if (!fs_path_exists(path)) {
-        map_errno(
-            "failed to iterate directory", ENOENT, FS_CODE_FILE_NOT_FOUND, path->buffer, error
-        );
-        return NULL;
-    }
-    if (!fs_path_is_dir(path)) {
-        map_errno(
-            "failed to iterate directory", ENOTDIR, FS_CODE_NOT_DIRECTORY, path->buffer, error
+    // missing paths and files are reported by the OS when the directory is opened
+    //
+    struct iterdir* iterator;
+    iterator = fs_malloc(sizeof *iterator, allocator);
+    if (!iterator) {
+        FS_SET_ERRORF(
+            error,
+            FS_CODE_OUT_OF_MEMORY,
+            "failed to allocate directory iterator: %s",
+            path->buffer
         );
         return NULL;
     }
-
-    struct iterdir* iterator;
-    iterator                 = fs_malloc(sizeof *iterator, allocator);
     iterator->allocator      = allocator;
     iterator->directory_path = *path;
     iterator->exhausted      = false;
+
+    FS_TRACE_BEGIN();
     platform_iterdir_init(iterator, error);
+    FS_TRACE_END(FS_OPERATION_ITERDIR, path->buffer, 0);
     if (FS_ERROR_IS_SET(error)) {
         fs_free(iterator, allocator);
         return NULL;
@@ -730,89 +1418,1258 @@ fs_iterdir(const struct fs_path* path, FilesystemAllocator* allocator, struct fs
     return iterator;
 }
 
-static const char*
-fs_iterdir_step(struct iterdir* iterator, struct fs_error* error)
-{
-    FS_ASSERT(iterator);
-    if (iterator->exhausted) {
-        return NULL;
+static const char*
+fs_iterdir_step(struct iterdir* iterator, struct fs_error* error)
+{
+    FS_ASSERT(iterator);
+    if (iterator->exhausted) {
+        return NULL;
+    }
+    return platform_iterdir_step(iterator, error);
+}
+
+bool
+fs_iterdir_next(struct iterdir* iterator, struct fs_path* outpath, struct fs_error* error)
+{
+    FS_ASSERT(iterator);
+    FS_ASSERT(outpath);
+
+    struct string_view name;
+    if (!fs_iterdir_next_name(iterator, &name, error)) {
+        return false;
+    }
+
+    // only the used part of the directory path is copied
+    //
+    const struct fs_path* directory = &iterator->directory_path;
+    outpath->length                 = directory->length;
+    memcpy(outpath->buffer, directory->buffer, directory->length);
+    if (!path_append_segments(
+            outpath->buffer, &outpath->length, sizeof outpath->buffer, name.data, name.length, '/'
+        )) {
+        FS_SET_ERROR(error, FS_CODE_PATH_TOO_LONG, "fs_path buffer overflow");
+        return false;
+    }
+    return true;
+}
+
+bool
+fs_iterdir_next_name(struct iterdir* iterator, struct string_view* name, struct fs_error* error)
+{
+    FS_ASSERT(iterator);
+    FS_ASSERT(name);
+
+    const char* filename = NULL;
+
+    FS_TRACE_BEGIN();
+    do {
+        filename = fs_iterdir_step(iterator, error);
+        if (!filename || FS_ERROR_IS_SET(error)) {
+            FS_TRACE_END(FS_OPERATION_ITERDIR_NEXT, iterator->directory_path.buffer, 0);
+            return false;
+        }
+    } while (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0);
+
+    *name = (struct string_view){.length = strlen(filename), .data = filename};
+    FS_TRACE_END(FS_OPERATION_ITERDIR_NEXT, iterator->directory_path.buffer, name->length);
+    return true;
+}
+
+bool
+fs_iterdir_next_entry(
+    struct iterdir* iterator, struct fs_entry* entry, unsigned flags, struct fs_error* error
+)
+{
+    FS_ASSERT(entry);
+
+    if (!fs_iterdir_next(iterator, &entry->path, error)) {
+        return false;
+    }
+    entry->type     = FS_ENTRY_UNKNOWN;
+    entry->size     = 0;
+    entry->mtime_ns = 0;
+    platform_iterdir_entry_info(iterator, entry, flags, error);
+    return !FS_ERROR_IS_SET(error);
+}
+
+void
+fs_iterdir_free(struct iterdir* iterator)
+{
+    if (!iterator) {
+        return;
+    }
+    platform_iterdir_teardown(iterator);
+    fs_free(iterator, iterator->allocator);
+}
+
+// A directory waiting to be listed or waiting on its subdirectories. `pending` counts its own
+// listing plus each subdirectory that hasn't finished, whoever takes it to zero finishes it.
+//
+struct walk_node {
+    struct fs_entry   entry;
+    size_t            depth;
+    struct walk_node* parent;
+    atomic_size_t     pending;
+};
+
+// The owner pushes and pops at the bottom so it works depth first, idle threads steal from the
+// top where the directories closest to the root (probably the biggest subtrees) are.
+//
+struct walk_deque {
+    mtx_t              lock;
+    struct walk_node** nodes;
+    size_t             top;
+    size_t             bottom;
+    size_t             capacity;
+};
+
+struct walk {
+    fs_walk_visitor        visit;
+    void*                  user_data;
+    struct fs_walk_options options;
+    size_t                 thread_count;
+    struct walk_deque*     deques;
+    atomic_size_t          queued;       // nodes sitting in the deques
+    atomic_size_t          outstanding;  // nodes that haven't finished
+    atomic_size_t          idle_count;
+    atomic_bool            stopped;
+    atomic_bool            failed;
+    struct fs_error        error;  // the first error, written by whoever sets `failed`
+    mtx_t                  idle_lock;
+    cnd_t                  idle_cond;
+};
+
+struct walk_worker {
+    struct walk* walk;
+    size_t       index;
+};
+
+static bool
+walk_deque_push(struct walk_deque* deque, struct walk_node* node)
+{
+    mtx_lock(&deque->lock);
+    if (deque->bottom == deque->capacity) {
+        const size_t       count    = deque->bottom - deque->top;
+        const size_t       capacity = (count * 2 > 64) ? count * 2 : 64;
+        struct walk_node** nodes    = deque->nodes;
+        if (capacity > deque->capacity) {
+            nodes = fs_malloc(capacity * sizeof *nodes, NULL);
+            if (!nodes) {
+                mtx_unlock(&deque->lock);
+                return false;
+            }
+        }
+        if (count) {
+            memmove(nodes, deque->nodes + deque->top, count * sizeof *nodes);
+        }
+        if (nodes != deque->nodes) {
+            fs_free(deque->nodes, NULL);
+            deque->nodes    = nodes;
+            deque->capacity = capacity;
+        }
+        deque->top    = 0;
+        deque->bottom = count;
+    }
+    deque->nodes[deque->bottom++] = node;
+    mtx_unlock(&deque->lock);
+    return true;
+}
+
+static struct walk_node*
+walk_deque_pop(struct walk_deque* deque)
+{
+    struct walk_node* node = NULL;
+    mtx_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        node = deque->nodes[--deque->bottom];
+    }
+    mtx_unlock(&deque->lock);
+    return node;
+}
+
+static struct walk_node*
+walk_deque_steal(struct walk_deque* deque)
+{
+    struct walk_node* node = NULL;
+    mtx_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        node = deque->nodes[deque->top++];
+    }
+    mtx_unlock(&deque->lock);
+    return node;
+}
+
+static void
+walk_fail(struct walk* walk, const struct fs_error* error)
+{
+    if (!atomic_exchange(&walk->failed, true)) {
+        walk->error = *error;
+    }
+    atomic_store(&walk->stopped, true);
+}
+
+static void
+walk_wake(struct walk* walk, bool everyone)
+{
+    if (atomic_load(&walk->idle_count) == 0) {
+        return;
+    }
+    mtx_lock(&walk->idle_lock);
+    if (everyone) {
+        cnd_broadcast(&walk->idle_cond);
+    }
+    else {
+        cnd_signal(&walk->idle_cond);
+    }
+    mtx_unlock(&walk->idle_lock);
+}
+
+static void
+walk_finish(struct walk* walk, struct walk_node* node)
+{
+    while (node && atomic_fetch_sub(&node->pending, 1) == 1) {
+        struct walk_node* parent = node->parent;
+        if (parent && walk->options.post_visit && !atomic_load(&walk->stopped)) {
+            struct fs_error  error_storage = {0};
+            struct fs_error* error         = &error_storage;
+            walk->options.post_visit(&node->entry, node->depth, walk->user_data, error);
+            if (FS_ERROR_IS_SET(error)) {
+                walk_fail(walk, error);
+            }
+        }
+        fs_free(node, NULL);
+        if (atomic_fetch_sub(&walk->outstanding, 1) == 1) {
+            walk_wake(walk, true);
+        }
+        node = parent;
+    }
+}
+
+static void
+walk_push(struct walk* walk, size_t worker_index, struct walk_node* node)
+{
+    atomic_fetch_add(&walk->outstanding, 1);
+    atomic_fetch_add(&walk->queued, 1);
+    if (!walk_deque_push(&walk->deques[worker_index], node)) {
+        atomic_fetch_sub(&walk->queued, 1);
+        atomic_fetch_sub(&walk->outstanding, 1);
+        struct fs_error  error_storage = {0};
+        struct fs_error* error         = &error_storage;
+        FS_SET_ERRORF(
+            error, FS_CODE_OUT_OF_MEMORY, "failed to queue directory: %s", node->entry.path.buffer
+        );
+        walk_fail(walk, error);
+
+        // the parent is waiting on this node, it's finished so the walk can still wind down
+        //
+        struct walk_node* parent = node->parent;
+        fs_free(node, NULL);
+        walk_finish(walk, parent);
+        return;
+    }
+    walk_wake(walk, false);
+}
+
+static void
+walk_list_directory(struct walk* walk, size_t worker_index, struct walk_node* node)
+{
+    struct fs_error             error_storage = {0};
+    struct fs_error*            error         = &error_storage;
+    FilesystemDirectoryIterator iterator      = fs_iterdir(&node->entry.path, NULL, error);
+    if (FS_ERROR_IS_SET(error)) {
+        walk_fail(walk, error);
+        return;
+    }
+
+    const size_t     depth = node->depth + 1;
+    const size_t     max   = walk->options.max_depth;
+    struct walk_node child;
+    while (!atomic_load_explicit(&walk->stopped, memory_order_relaxed) &&
+           fs_iterdir_next_entry(iterator, &child.entry, walk->options.entry_flags, error)) {
+        const enum fs_walk_action action =
+            walk->visit(&child.entry, depth, walk->user_data, error);
+        if (FS_ERROR_IS_SET(error)) {
+            break;
+        }
+        if (action == FS_WALK_STOP) {
+            atomic_store(&walk->stopped, true);
+            break;
+        }
+        if (child.entry.type != FS_ENTRY_DIRECTORY || action == FS_WALK_PRUNE ||
+            (max && depth >= max)) {
+            continue;
+        }
+
+        struct walk_node* queued = fs_malloc(sizeof *queued, NULL);
+        if (!queued) {
+            FS_SET_ERRORF(
+                error,
+                FS_CODE_OUT_OF_MEMORY,
+                "failed to queue directory: %s",
+                child.entry.path.buffer
+            );
+            break;
+        }
+        queued->entry  = child.entry;
+        queued->depth  = depth;
+        queued->parent = node;
+        atomic_init(&queued->pending, 1);
+        atomic_fetch_add(&node->pending, 1);
+        walk_push(walk, worker_index, queued);
+    }
+    fs_iterdir_free(iterator);
+
+    if (FS_ERROR_IS_SET(error)) {
+        walk_fail(walk, error);
+    }
+}
+
+static struct walk_node*
+walk_take(struct walk* walk, size_t worker_index)
+{
+    struct walk_node* node = walk_deque_pop(&walk->deques[worker_index]);
+    for (size_t i = 1; !node && i < walk->thread_count; i++) {
+        node = walk_deque_steal(&walk->deques[(worker_index + i) % walk->thread_count]);
+    }
+    if (node) {
+        atomic_fetch_sub(&walk->queued, 1);
+    }
+    return node;
+}
+
+static int
+walk_worker_main(void* arg)
+{
+    struct walk_worker* worker = arg;
+    struct walk*        walk   = worker->walk;
+
+    while (atomic_load(&walk->outstanding) > 0) {
+        struct walk_node* node = walk_take(walk, worker->index);
+        if (node) {
+            // once stopped, queued directories are only finished so their memory is released
+            //
+            if (!atomic_load_explicit(&walk->stopped, memory_order_relaxed)) {
+                walk_list_directory(walk, worker->index, node);
+            }
+            walk_finish(walk, node);
+            continue;
+        }
+
+        mtx_lock(&walk->idle_lock);
+        atomic_fetch_add(&walk->idle_count, 1);
+        while (atomic_load(&walk->queued) == 0 && atomic_load(&walk->outstanding) > 0) {
+            cnd_wait(&walk->idle_cond, &walk->idle_lock);
+        }
+        atomic_fetch_sub(&walk->idle_count, 1);
+        mtx_unlock(&walk->idle_lock);
+    }
+    return 0;
+}
+
+void
+fs_walk(
+    const struct fs_path*         root,
+    fs_walk_visitor               visit,
+    void*                         user_data,
+    const struct fs_walk_options* options,
+    struct fs_error*              error
+)
+{
+    assert_fs_path_is_valid(root);
+    FS_ASSERT(visit);
+    FS_TRACE_BEGIN();
+
+    struct walk walk = {
+        .visit     = visit,
+        .user_data = user_data,
+        .options   = (options) ? *options : (struct fs_walk_options){0},
+    };
+    walk.thread_count = walk.options.thread_count;
+    if (walk.thread_count == 0) {
+        walk.thread_count = FS_WALK_DEFAULT_THREAD_COUNT;
+    }
+
+    struct walk_node*   node    = fs_malloc(sizeof *node, NULL);
+    struct walk_worker* workers = fs_malloc(walk.thread_count * sizeof *workers, NULL);
+    thrd_t*             threads = fs_malloc(walk.thread_count * sizeof *threads, NULL);
+    walk.deques                 = fs_malloc(walk.thread_count * sizeof *walk.deques, NULL);
+    if (!node || !workers || !threads || !walk.deques) {
+        FS_SET_ERRORF(error, FS_CODE_OUT_OF_MEMORY, "failed to start walk: %s", root->buffer);
+        fs_free(node, NULL);
+        fs_free(workers, NULL);
+        fs_free(threads, NULL);
+        fs_free(walk.deques, NULL);
+        FS_TRACE_END(FS_OPERATION_WALK, root->buffer, 0);
+        return;
+    }
+
+    mtx_init(&walk.idle_lock, mtx_plain);
+    cnd_init(&walk.idle_cond);
+    for (size_t i = 0; i < walk.thread_count; i++) {
+        walk.deques[i] = (struct walk_deque){0};
+        mtx_init(&walk.deques[i].lock, mtx_plain);
+        workers[i] = (struct walk_worker){.walk = &walk, .index = i};
+    }
+
+    node->entry.path = *root;
+    node->entry.type = FS_ENTRY_DIRECTORY;
+    node->depth      = 0;
+    node->parent     = NULL;
+    atomic_init(&node->pending, 1);
+    walk_push(&walk, 0, node);
+
+    // the calling thread is worker 0, if a thread fails to start the others pick up the slack
+    //
+    size_t started = 1;
+    for (; started < walk.thread_count; started++) {
+        if (thrd_create(&threads[started], walk_worker_main, &workers[started]) != thrd_success) {
+            break;
+        }
+    }
+    walk_worker_main(&workers[0]);
+    for (size_t i = 1; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < walk.thread_count; i++) {
+        fs_free(walk.deques[i].nodes, NULL);
+        mtx_destroy(&walk.deques[i].lock);
+    }
+    cnd_destroy(&walk.idle_cond);
+    mtx_destroy(&walk.idle_lock);
+    fs_free(walk.deques, NULL);
+    fs_free(threads, NULL);
+    fs_free(workers, NULL);
+
+    FS_TRACE_END(FS_OPERATION_WALK, root->buffer, 0);
+    if (atomic_load(&walk.failed)) {
+        FS_SET_ERRORF(error, walk.error.code, "%s", walk.error.reason);
+    }
+}
+
+struct fs_content
+fs_read_file_binary(const char* filepath, FilesystemAllocator* allocator, struct fs_error* error)
+{
+    FS_TRACE_BEGIN();
+    FILE* file = fs_open(filepath, "rb", error);
+    if (FS_ERROR_IS_SET(error)) {
+        FS_TRACE_END(FS_OPERATION_READ, filepath, 0);
+        return (struct fs_content){0};
+    }
+
+    struct fs_content content = read_fs_content_internal(file, filepath, allocator, NULL, error);
+    fs_close(file);
+
+    FS_TRACE_END(FS_OPERATION_READ, filepath, content.size);
+    return content;
+}
+
+struct fs_content
+fs_read_file_text(const char* filepath, FilesystemAllocator* allocator, struct fs_error* error)
+{
+    FS_TRACE_BEGIN();
+    FILE* file = fs_open(filepath, "r", error);
+    if (FS_ERROR_IS_SET(error)) {
+        FS_TRACE_END(FS_OPERATION_READ, filepath, 0);
+        return (struct fs_content){0};
+    }
+
+    struct fs_content content = read_fs_content_internal(file, filepath, allocator, NULL, error);
+    fs_close(file);
+
+    FS_TRACE_END(FS_OPERATION_READ, filepath, content.size);
+    return content;
+}
+
+#define READ_ALL_INITIAL_CAPACITY (64 * 1024)
+
+struct fs_content
+fs_read_all(FILE* file, FilesystemAllocator* allocator, struct fs_error* error)
+{
+    FS_ASSERT(file);
+    FS_TRACE_BEGIN();
+
+    // the size isn't known up front, the buffer doubles until a read comes up short
+    //
+    struct fs_content content  = {0};
+    size_t            capacity = 0;
+    for (;;) {
+        if (content.size == capacity) {
+            const size_t new_capacity = (capacity) ? capacity * 2 : READ_ALL_INITIAL_CAPACITY;
+            void*        data         = fs_realloc(content.data, new_capacity + 1, allocator);
+            if (!data) {
+                fs_free(content.data, allocator);
+                FS_SET_ERRORF(
+                    error,
+                    FS_CODE_OUT_OF_MEMORY,
+                    "failed to allocate %zu bytes for stream content",
+                    new_capacity + 1
+                );
+                FS_TRACE_END(FS_OPERATION_READ, NULL, 0);
+                return (struct fs_content){0};
+            }
+            content.data = data;
+            capacity     = new_capacity;
+        }
+        char*        end  = (char*)content.data + content.size;
+        const size_t read = fread(end, 1, capacity - content.size, file);
+        content.size += read;
+        if (read == 0 || content.size < capacity) {
+            if (ferror(file)) {
+                fs_free(content.data, allocator);
+                FS_SET_ERRORF(
+                    error,
+                    FS_CODE_READ_FAILED,
+                    "failed to read stream after %zu bytes",
+                    content.size
+                );
+                FS_TRACE_END(FS_OPERATION_READ, NULL, 0);
+                return (struct fs_content){0};
+            }
+            if (feof(file)) {
+                break;
+            }
+        }
+    }
+    ((char*)content.data)[content.size] = '\0';
+
+    FS_TRACE_END(FS_OPERATION_READ, NULL, content.size);
+    return content;
+}
+
+void
+fs_write_file(const char* filepath, const void* data, size_t data_size, struct fs_error* error)
+{
+    const struct fs_iovec iov = {.data = data, .size = data_size};
+    fs_write_filev(filepath, &iov, 1, 0, error);
+}
+
+void
+fs_write_filev(
+    const char*            filepath,
+    const struct fs_iovec* iov,
+    size_t                 count,
+    unsigned               flags,
+    struct fs_error*       error
+)
+{
+    FS_ASSERT(filepath);
+    FS_ASSERT(iov || count == 0);
+    FS_TRACE_BEGIN();
+    platform_write_filev(filepath, iov, count, flags, error);
+#ifdef FS_STATS
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        bytes += iov[i].size;
+    }
+    FS_TRACE_END(FS_OPERATION_WRITE, filepath, bytes);
+#endif
+}
+
+// The fallback for `fs_batch_run`, each thread takes the next request until there are none.
+//
+struct batch_pool {
+    struct fs_batch_request* requests;
+    size_t                   count;
+    atomic_size_t            next;
+    FilesystemAllocator*     allocator;
+    mtx_t                    allocator_lock;
+};
+
+static int
+batch_pool_worker_main(void* arg)
+{
+    struct batch_pool* pool = arg;
+
+    for (;;) {
+        const size_t index = atomic_fetch_add(&pool->next, 1);
+        if (index >= pool->count) {
+            return 0;
+        }
+        struct fs_batch_request* request = &pool->requests[index];
+        struct fs_error*         error   = &request->error;
+
+        // platform calls rather than fs_write_file so the request is only traced as part of the
+        // batch, as it is on io_uring
+        //
+        if (request->operation == FS_BATCH_WRITE) {
+            const struct fs_iovec iov = {.data = request->data, .size = request->size};
+            platform_write_filev(request->filepath, &iov, 1, 0, error);
+            continue;
+        }
+        if (platform_path_type(request->filepath) == FS_ENTRY_DIRECTORY) {
+            map_errno(
+                "failed to read file", EISDIR, FS_CODE_IS_A_DIRECTORY, request->filepath, error
+            );
+            continue;
+        }
+        FILE* file = fs_open(request->filepath, "rb", error);
+        if (FS_ERROR_IS_SET(error)) {
+            continue;
+        }
+        request->content = read_fs_content_internal(
+            file, request->filepath, pool->allocator, &pool->allocator_lock, error
+        );
+        fs_close(file);
+    }
+}
+
+static void
+batch_run_pool(struct fs_batch_request* requests, size_t count, FilesystemAllocator* allocator)
+{
+    struct batch_pool pool = {.requests = requests, .count = count, .allocator = allocator};
+    mtx_init(&pool.allocator_lock, mtx_plain);
+
+    // the calling thread works too, if a thread fails to start the others pick up the slack
+    //
+    thrd_t threads[FS_BATCH_THREAD_COUNT];
+    size_t started = 1;
+    for (; started < FS_BATCH_THREAD_COUNT && started < count; started++) {
+        if (thrd_create(&threads[started], batch_pool_worker_main, &pool) != thrd_success) {
+            break;
+        }
+    }
+    batch_pool_worker_main(&pool);
+    for (size_t i = 1; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    mtx_destroy(&pool.allocator_lock);
+}
+
+#ifdef FS_IO_URING
+
+// Just enough of io_uring to keep FS_BATCH_QUEUE_DEPTH operations in flight, the rings are
+// shared with the kernel so the indices it writes are read with acquire ordering.
+//
+struct uring {
+    int                  fd;
+    unsigned             sq_entries;
+    unsigned*            sq_head;
+    unsigned*            sq_tail;
+    unsigned*            sq_mask;
+    unsigned*            sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned*            cq_head;
+    unsigned*            cq_tail;
+    unsigned*            cq_mask;
+    struct io_uring_cqe* cqes;
+    void*                sq_ring;
+    size_t               sq_ring_size;
+    void*                cq_ring;
+    size_t               cq_ring_size;
+    size_t               sqes_size;
+    unsigned             unsubmitted;
+};
+
+static void
+uring_destroy(struct uring* ring)
+{
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0) close(ring->fd);
+}
+
+static bool
+uring_init(struct uring* ring, unsigned entries)
+{
+    struct io_uring_params params = {0};
+    *ring                         = (struct uring){.fd = -1};
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return false;
+    }
+
+    // openat and close need 5.6, which is also when IORING_FEAT_RW_CUR_POS appeared
+    //
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        uring_destroy(ring);
+        return false;
+    }
+
+    ring->sq_entries   = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    const int prot  = PROT_READ | PROT_WRITE;
+    const int flags = MAP_SHARED | MAP_POPULATE;
+    ring->sq_ring   = mmap(NULL, ring->sq_ring_size, prot, flags, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        uring_destroy(ring);
+        return false;
+    }
+    ring->cq_ring = ring->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, prot, flags, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            uring_destroy(ring);
+            return false;
+        }
+    }
+    ring->sqes = mmap(NULL, ring->sqes_size, prot, flags, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return false;
+    }
+
+    char* sq       = ring->sq_ring;
+    char* cq       = ring->cq_ring;
+    ring->sq_head  = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail  = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head  = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail  = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask  = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return true;
+}
+
+// callers never queue more than the ring holds between waits, so there is always an entry
+//
+static struct io_uring_sqe*
+uring_queue(struct uring* ring, uint8_t opcode, int fd, uint64_t user_data)
+{
+    const unsigned tail  = *ring->sq_tail;
+    const unsigned index = tail & *ring->sq_mask;
+
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof *sqe);
+    sqe->opcode           = opcode;
+    sqe->fd               = fd;
+    sqe->user_data        = user_data;
+    ring->sq_array[index] = index;
+    atomic_store_explicit((_Atomic unsigned*)ring->sq_tail, tail + 1, memory_order_release);
+    ring->unsubmitted++;
+    return sqe;
+}
+
+// Submits everything queued and calls `complete` for each of the `count` completions.
+//
+static bool
+uring_submit_and_wait(
+    struct uring* ring,
+    unsigned      count,
+    void (*complete)(struct fs_batch_request*, uint64_t user_data, int result, void* context),
+    struct fs_batch_request* requests,
+    void*                    context
+)
+{
+    while (count > 0) {
+        const int submitted = (int)syscall(
+            __NR_io_uring_enter, ring->fd, ring->unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0
+        );
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        ring->unsubmitted -= (unsigned)submitted;
+
+        unsigned       head = *ring->cq_head;
+        const unsigned tail =
+            atomic_load_explicit((_Atomic unsigned*)ring->cq_tail, memory_order_acquire);
+        for (; head != tail && count > 0; head++, count--) {
+            const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            complete(requests, cqe->user_data, cqe->res, context);
+        }
+        atomic_store_explicit((_Atomic unsigned*)ring->cq_head, head, memory_order_release);
+    }
+    return true;
+}
+
+// Per request state for one window of the batch.
+//
+struct batch_uring_window {
+    int    fds[FS_BATCH_QUEUE_DEPTH];
+    size_t done[FS_BATCH_QUEUE_DEPTH];
+    size_t first;
+};
+
+static void
+batch_uring_opened(struct fs_batch_request* requests, uint64_t index, int result, void* context)
+{
+    struct batch_uring_window* window  = context;
+    struct fs_batch_request*   request = &requests[window->first + index];
+    struct fs_error*           error   = &request->error;
+    if (result < 0) {
+        map_errno("failed to open file", -result, FS_CODE_OPEN_FAILED, request->filepath, error);
+        return;
+    }
+    window->fds[index] = result;
+}
+
+static void
+batch_uring_transferred(
+    struct fs_batch_request* requests, uint64_t index, int result, void* context
+)
+{
+    struct batch_uring_window* window  = context;
+    struct fs_batch_request*   request = &requests[window->first + index];
+    struct fs_error*           error   = &request->error;
+    const bool                 reading = request->operation == FS_BATCH_READ;
+
+    if (result < 0) {
+        if (reading) {
+            map_errno(
+                "failed to read file", -result, FS_CODE_READ_FAILED, request->filepath, error
+            );
+        }
+        else {
+            map_errno(
+                "failed to write file", -result, FS_CODE_WRITE_FAILED, request->filepath, error
+            );
+        }
+        return;
+    }
+    if (result == 0) {
+        // the file shrank since it was sized, what was read is all there is
+        //
+        if (reading) {
+            request->content.size                                 = window->done[index];
+            ((char*)request->content.data)[request->content.size] = '\0';
+        }
+        else {
+            FS_SET_ERRORF(
+                error, FS_CODE_WRITE_FAILED, "failed to write file: %s", request->filepath
+            );
+        }
+        return;
+    }
+    window->done[index] += (size_t)result;
+}
+
+static void
+batch_uring_closed(struct fs_batch_request* requests, uint64_t index, int result, void* context)
+{
+    (void)requests;
+    (void)index;
+    (void)result;
+    (void)context;
+}
+
+static size_t
+batch_uring_remaining(
+    const struct fs_batch_request* request, const struct batch_uring_window* window, size_t index
+)
+{
+    if (window->fds[index] < 0 || request->error.code != FS_CODE_SUCCESS) {
+        return 0;
+    }
+    const size_t size =
+        (request->operation == FS_BATCH_READ) ? request->content.size : request->size;
+    return size - window->done[index];
+}
+
+static void
+batch_uring_run_window(
+    struct uring*              ring,
+    struct batch_uring_window* window,
+    struct fs_batch_request*   requests,
+    size_t                     count,
+    FilesystemAllocator*       allocator
+)
+{
+    // open everything
+    //
+    for (size_t i = 0; i < count; i++) {
+        const struct fs_batch_request* request = &requests[window->first + i];
+        struct io_uring_sqe*           sqe     = uring_queue(ring, IORING_OP_OPENAT, AT_FDCWD, i);
+        sqe->addr = (uint64_t)(uintptr_t)request->filepath;
+        sqe->len  = 0666;
+        sqe->open_flags =
+            (request->operation == FS_BATCH_READ) ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC;
+        sqe->open_flags |= O_CLOEXEC;
+        window->fds[i]  = -1;
+        window->done[i] = 0;
+    }
+    if (!uring_submit_and_wait(ring, (unsigned)count, batch_uring_opened, requests, window)) {
+        for (size_t i = 0; i < count; i++) {
+            struct fs_batch_request* request = &requests[window->first + i];
+            struct fs_error*         error   = &request->error;
+            if (window->fds[i] < 0 && !FS_ERROR_IS_SET(error)) {
+                map_errno(
+                    "failed to open file", errno, FS_CODE_OPEN_FAILED, request->filepath, error
+                );
+            }
+        }
+    }
+
+    // size and allocate the reads here, on the calling thread, so any allocator works
+    //
+    for (size_t i = 0; i < count; i++) {
+        struct fs_batch_request* request = &requests[window->first + i];
+        struct fs_error*         error   = &request->error;
+        if (window->fds[i] < 0 || request->operation != FS_BATCH_READ) {
+            continue;
+        }
+        struct stat st;
+        if (fstat(window->fds[i], &st) != 0) {
+            map_errno(
+                "failed to read file", errno, FS_CODE_SEEK_FAILED, request->filepath, error
+            );
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            map_errno(
+                "failed to read file", EISDIR, FS_CODE_IS_A_DIRECTORY, request->filepath, error
+            );
+            continue;
+        }
+        request->content.size = (size_t)st.st_size;
+        request->content.data = fs_malloc(request->content.size + 1, allocator);
+        if (!request->content.data) {
+            FS_SET_ERRORF(
+                error,
+                FS_CODE_OUT_OF_MEMORY,
+                "failed to allocate %zu bytes for file content: %s",
+                request->content.size,
+                request->filepath
+            );
+            request->content = (struct fs_content){0};
+            continue;
+        }
+        ((char*)request->content.data)[request->content.size] = '\0';
+    }
+
+    // reads and writes can come back short, keep going until each is finished or fails
+    //
+    for (;;) {
+        unsigned queued = 0;
+        for (size_t i = 0; i < count; i++) {
+            struct fs_batch_request* request   = &requests[window->first + i];
+            const size_t             remaining = batch_uring_remaining(request, window, i);
+            if (remaining == 0) {
+                continue;
+            }
+            const bool           reading = request->operation == FS_BATCH_READ;
+            const uint8_t        opcode  = (reading) ? IORING_OP_READ : IORING_OP_WRITE;
+            const char*          buffer  = (reading) ? request->content.data : request->data;
+            struct io_uring_sqe* sqe     = uring_queue(ring, opcode, window->fds[i], i);
+            sqe->addr = (uint64_t)(uintptr_t)(buffer + window->done[i]);
+            sqe->len  = (remaining > (1u << 30)) ? (1u << 30) : (unsigned)remaining;
+            sqe->off  = window->done[i];
+            queued++;
+        }
+        if (queued == 0) {
+            break;
+        }
+        if (!uring_submit_and_wait(ring, queued, batch_uring_transferred, requests, window)) {
+            for (size_t i = 0; i < count; i++) {
+                struct fs_batch_request* request = &requests[window->first + i];
+                struct fs_error*         error   = &request->error;
+                if (batch_uring_remaining(request, window, i) > 0) {
+                    map_errno(
+                        "failed to transfer file",
+                        errno,
+                        FS_CODE_UNSPECIFIED,
+                        request->filepath,
+                        error
+                    );
+                }
+            }
+            break;
+        }
+    }
+
+    // close everything, releasing the contents of reads that failed
+    //
+    unsigned queued = 0;
+    for (size_t i = 0; i < count; i++) {
+        struct fs_batch_request* request = &requests[window->first + i];
+        if (request->error.code != FS_CODE_SUCCESS && request->content.data) {
+            fs_free(request->content.data, allocator);
+            request->content = (struct fs_content){0};
+        }
+        if (window->fds[i] >= 0) {
+            uring_queue(ring, IORING_OP_CLOSE, window->fds[i], i);
+            queued++;
+        }
+    }
+    if (!uring_submit_and_wait(ring, queued, batch_uring_closed, requests, window)) {
+        for (size_t i = 0; i < count; i++) {
+            if (window->fds[i] >= 0) close(window->fds[i]);
+        }
+    }
+}
+
+static bool
+batch_run_uring(struct fs_batch_request* requests, size_t count, FilesystemAllocator* allocator)
+{
+    struct uring ring;
+    if (!uring_init(&ring, FS_BATCH_QUEUE_DEPTH)) {
+        return false;
+    }
+
+    struct batch_uring_window window;
+    for (window.first = 0; window.first < count; window.first += FS_BATCH_QUEUE_DEPTH) {
+        const size_t remaining = count - window.first;
+        const size_t size = (remaining < FS_BATCH_QUEUE_DEPTH) ? remaining : FS_BATCH_QUEUE_DEPTH;
+        batch_uring_run_window(&ring, &window, requests, size, allocator);
+    }
+
+    uring_destroy(&ring);
+    return true;
+}
+
+#endif  // FS_IO_URING
+
+size_t
+fs_batch_run(
+    struct fs_batch_request* requests, size_t count, unsigned flags, FilesystemAllocator* allocator
+)
+{
+    FS_ASSERT(requests || count == 0);
+
+    for (size_t i = 0; i < count; i++) {
+        FS_ASSERT(requests[i].filepath);
+        requests[i].content = (struct fs_content){0};
+        requests[i].error   = (struct fs_error){0};
+    }
+
+    FS_TRACE_BEGIN();
+    bool done = false;
+#ifdef FS_IO_URING
+    if (!(flags & FS_BATCH_THREADS)) {
+        done = batch_run_uring(requests, count, allocator);
+    }
+#else
+    (void)flags;
+#endif
+    if (!done) {
+        batch_run_pool(requests, count, allocator);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        failed += (requests[i].error.code != FS_CODE_SUCCESS);
+    }
+#ifdef FS_STATS
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (requests[i].error.code != FS_CODE_SUCCESS) continue;
+        bytes += (requests[i].operation == FS_BATCH_READ) ? requests[i].content.size
+                                                          : requests[i].size;
+    }
+    FS_TRACE_END(FS_OPERATION_BATCH, (count) ? requests[0].filepath : NULL, bytes);
+#endif
+    return failed;
+}
+
+struct fs_mapping
+fs_map_file(const char* filepath, unsigned flags, struct fs_error* error)
+{
+    FS_ASSERT(filepath);
+    FS_TRACE_BEGIN();
+    struct fs_mapping mapping = platform_map_file(filepath, flags, error);
+    FS_TRACE_END(FS_OPERATION_MAP, filepath, mapping.size);
+    return mapping;
+}
+
+void
+fs_unmap(struct fs_mapping* mapping)
+{
+    if (!mapping || !mapping->data) {
+        return;
+    }
+    platform_unmap_file(mapping);
+    *mapping = (struct fs_mapping){0};
+}
+
+struct fs_stream
+fs_stream_open(
+    const char*          filepath,
+    void*                buffer,
+    size_t               buffer_size,
+    unsigned             flags,
+    FilesystemAllocator* allocator,
+    struct fs_error*     error
+)
+{
+    FS_ASSERT(filepath);
+    FS_ASSERT(buffer == NULL || buffer_size > 0);
+
+    struct fs_stream stream = {.flags = flags, .allocator = allocator};
+    stream.file             = fs_open(filepath, "rb", error);
+    if (FS_ERROR_IS_SET(error)) return (struct fs_stream){0};
+
+    // reads go straight into the stream buffer, stdio buffering would only add a copy
+    //
+    setvbuf(stream.file, NULL, _IONBF, 0);
+
+    if (buffer) {
+        stream.buffer   = buffer;
+        stream.capacity = buffer_size;
+    }
+    else {
+        stream.capacity    = (buffer_size) ? buffer_size : FS_STREAM_DEFAULT_BUFFER_SIZE;
+        stream.buffer      = fs_malloc(stream.capacity, allocator);
+        stream.owns_buffer = true;
+        if (!stream.buffer) {
+            FS_SET_ERRORF(
+                error,
+                FS_CODE_OUT_OF_MEMORY,
+                "failed to allocate %zu bytes for file stream: %s",
+                stream.capacity,
+                filepath
+            );
+            fs_close(stream.file);
+            return (struct fs_stream){0};
+        }
+    }
+    return stream;
+}
+
+static bool
+stream_next(struct fs_stream* stream, struct string_view* chunk, struct fs_error* error)
+{
+    if (!stream->file) {
+        return false;
+    }
+
+    // carry over whatever wasn't yielded last time
+    //
+    if (stream->consumed) {
+        stream->length -= stream->consumed;
+        memmove(stream->buffer, stream->buffer + stream->consumed, stream->length);
+        stream->consumed = 0;
+    }
+
+    while (!stream->eof && stream->length < stream->capacity) {
+        const size_t remaining = stream->capacity - stream->length;
+        const size_t count     = fread(stream->buffer + stream->length, 1, remaining, stream->file);
+        stream->length += count;
+        if (count < remaining) {
+            if (ferror(stream->file)) {
+                FS_SET_ERROR(error, FS_CODE_READ_FAILED, "failed to read from file stream");
+                return false;
+            }
+            stream->eof = true;
+        }
+    }
+
+    if (stream->length == 0) {
+        return false;
+    }
+
+    size_t chunk_length = stream->length;
+    if ((stream->flags & FS_STREAM_LINES) && !stream->eof) {
+        size_t i = stream->length;
+        while (i > 0 && stream->buffer[i - 1] != '\n') {
+            i--;
+        }
+        if (i > 0) chunk_length = i;
     }
-    return platform_iterdir_step(iterator, error);
+
+    stream->consumed = chunk_length;
+    *chunk           = (struct string_view){.length = chunk_length, .data = stream->buffer};
+    return true;
 }
 
 bool
-fs_iterdir_next(struct iterdir* iterator, struct fs_path* outpath, struct fs_error* error)
+fs_stream_next(struct fs_stream* stream, struct string_view* chunk, struct fs_error* error)
 {
-    FS_ASSERT(iterator);
-    FS_ASSERT(outpath);
-
-    const char* filename = NULL;
+    FS_ASSERT(stream);
+    FS_ASSERT(chunk);
 
-    do {
-        filename = fs_iterdir_step(iterator, error);
-        if (!filename || FS_ERROR_IS_SET(error)) {
-            return false;
-        }
-    } while (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0);
-
-    *outpath = fs_path_join(&iterator->directory_path, filename, error);
-    return !FS_ERROR_IS_SET(error);
+    FS_TRACE_BEGIN();
+    const bool more = stream_next(stream, chunk, error);
+    FS_TRACE_END(FS_OPERATION_STREAM, NULL, (more) ? chunk->length : 0);
+    return more;
 }
 
 void
-fs_iterdir_free(struct iterdir* iterator)
+fs_stream_close(struct fs_stream* stream)
 {
-    if (!iterator) {
+    if (!stream) {
         return;
     }
-    platform_iterdir_teardown(iterator);
-    fs_free(iterator, iterator->allocator);
+    fs_close(stream->file);
+    if (stream->owns_buffer) {
+        fs_free(stream->buffer, stream->allocator);
+    }
+    *stream = (struct fs_stream){0};
 }
 
-struct fs_content
-fs_read_file_binary(const char* filepath, FilesystemAllocator* allocator, struct fs_error* error)
+struct fs_stats
+fs_stats(void)
 {
-    FILE* file = fs_open(filepath, "rb", error);
-    if (FS_ERROR_IS_SET(error)) return (struct fs_content){0};
-
-    struct fs_content content = read_fs_content_internal(file, filepath, allocator, error);
-    fs_close(file);
-
-    return content;
+    struct fs_stats stats = {0};
+#ifdef FS_STATS
+    for (size_t i = 0; i < FS_OPERATION_COUNT; i++) {
+        stats.operations[i] = (struct fs_operation_stats){
+            .calls = atomic_load_explicit(&fs_counters[i].calls, memory_order_relaxed),
+            .bytes = atomic_load_explicit(&fs_counters[i].bytes, memory_order_relaxed),
+            .ns    = atomic_load_explicit(&fs_counters[i].ns, memory_order_relaxed),
+        };
+    }
+#endif
+    return stats;
 }
 
-struct fs_content
-fs_read_file_text(const char* filepath, FilesystemAllocator* allocator, struct fs_error* error)
+void
+fs_stats_reset(void)
 {
-    FILE* file = fs_open(filepath, "r", error);
-    if (FS_ERROR_IS_SET(error)) return (struct fs_content){0};
-
-    struct fs_content content = read_fs_content_internal(file, filepath, allocator, error);
-    fs_close(file);
-
-    return content;
+#ifdef FS_STATS
+    for (size_t i = 0; i < FS_OPERATION_COUNT; i++) {
+        atomic_store_explicit(&fs_counters[i].calls, 0, memory_order_relaxed);
+        atomic_store_explicit(&fs_counters[i].bytes, 0, memory_order_relaxed);
+        atomic_store_explicit(&fs_counters[i].ns, 0, memory_order_relaxed);
+    }
+#endif
 }
 
 void
-fs_write_file(const char* filepath, const void* data, size_t data_size, struct fs_error* error)
+fs_set_trace_callback(fs_trace_callback callback, void* user_data)
 {
-    FILE* file = fs_open(filepath, "wb", error);
-    if (FS_ERROR_IS_SET(error)) return;
+#ifdef FS_STATS
+    fs_trace           = callback;
+    fs_trace_user_data = user_data;
+#else
+    (void)callback;
+    (void)user_data;
+#endif
+}
 
-    // write the file data to the file
-    if (fwrite(data, data_size, 1, file) != 1) {
-        FS_SET_ERRORF(
-            error,
-            FS_CODE_WRITE_FAILED,
-            "failed to write %zu bytes to file: %s",
-            data_size,
-            filepath
-        );
-        fs_close(file);
-        return;
+const char*
+fs_operation_name(enum fs_operation operation)
+{
+    switch (operation) {
+        case FS_OPERATION_READ:
+            return "read";
+        case FS_OPERATION_WRITE:
+            return "write";
+        case FS_OPERATION_MAP:
+            return "map";
+        case FS_OPERATION_STREAM:
+            return "stream";
+        case FS_OPERATION_BATCH:
+            return "batch";
+        case FS_OPERATION_ITERDIR:
+            return "iterdir";
+        case FS_OPERATION_ITERDIR_NEXT:
+            return "iterdir_next";
+        case FS_OPERATION_WALK:
+            return "walk";
+        case FS_OPERATION_STAT:
+            return "stat";
+        case FS_OPERATION_MKDIR:
+            return "mkdir";
+        case FS_OPERATION_REMOVE:
+            return "remove";
+        case FS_OPERATION_COUNT:
+            break;
     }
-
-    fs_close(file);
+    return "unknown";
 }
 
 FILE*
@@ -886,12 +2743,106 @@ platform_remove_directory(const char* filepath, struct fs_error* error)
         );
     }
 #else
-    if (remove(filepath) == -1) {
+    if (rmdir(filepath) == -1) {
         map_errno("failed to remove directory", errno, FS_CODE_UNSPECIFIED, filepath, error);
     }
 #endif
 }
 
+static void
+platform_remove_file(const char* filepath, struct fs_error* error)
+{
+#ifdef _WIN32
+    if (!DeleteFileA(filepath)) {
+        map_windows_error(
+            "failed to remove file", GetLastError(), FS_CODE_UNSPECIFIED, filepath, error
+        );
+    }
+#else
+    if (unlink(filepath) == -1) {
+        map_errno("failed to remove file", errno, FS_CODE_UNSPECIFIED, filepath, error);
+    }
+#endif
+}
+
+#ifdef _WIN32
+static enum fs_entry_type
+platform_attributes_type(DWORD attributes)
+{
+    if (attributes & FILE_ATTRIBUTE_REPARSE_POINT) return FS_ENTRY_SYMLINK;
+    if (attributes & FILE_ATTRIBUTE_DIRECTORY) return FS_ENTRY_DIRECTORY;
+    if (attributes & FILE_ATTRIBUTE_DEVICE) return FS_ENTRY_OTHER;
+    return FS_ENTRY_FILE;
+}
+#else
+static enum fs_entry_type
+platform_mode_type(mode_t mode)
+{
+    if (S_ISREG(mode)) return FS_ENTRY_FILE;
+    if (S_ISDIR(mode)) return FS_ENTRY_DIRECTORY;
+    if (S_ISLNK(mode)) return FS_ENTRY_SYMLINK;
+    return FS_ENTRY_OTHER;
+}
+#endif
+
+// The type of the path itself, a symlink is not followed. Unknown when it can't be checked.
+//
+static enum fs_entry_type
+platform_path_type(const char* filepath)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributes(filepath);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return FS_ENTRY_UNKNOWN;
+    }
+    return platform_attributes_type(attributes);
+#else
+    struct stat st;
+    if (lstat(filepath, &st) != 0) {
+        return FS_ENTRY_UNKNOWN;
+    }
+    return platform_mode_type(st.st_mode);
+#endif
+}
+
+// Follows symlinks, a path that doesn't exist is FS_ENTRY_UNKNOWN rather than an error.
+//
+static void
+platform_stat(const char* filepath, struct fs_stat* out, struct fs_error* error)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(filepath, GetFileExInfoStandard, &data)) {
+        const DWORD code = GetLastError();
+        if (code != ERROR_FILE_NOT_FOUND && code != ERROR_PATH_NOT_FOUND) {
+            map_windows_error("failed to stat file", code, FS_CODE_UNSPECIFIED, filepath, error);
+        }
+        return;
+    }
+    const FILETIME mtime = data.ftLastWriteTime;
+    const uint64_t ticks = ((uint64_t)mtime.dwHighDateTime << 32) | mtime.dwLowDateTime;
+    out->type = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? FS_ENTRY_DIRECTORY
+                                                                   : FS_ENTRY_FILE;
+    out->size     = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    out->mtime_ns = ((int64_t)ticks - INT64_C(116444736000000000)) * 100;
+#else
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
+        if (errno != ENOENT && errno != ENOTDIR) {
+            map_errno("failed to stat file", errno, FS_CODE_UNSPECIFIED, filepath, error);
+        }
+        return;
+    }
+    out->type = platform_mode_type(st.st_mode);
+    out->size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+    out->mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    out->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+}
+
 static bool
 platform_path_is_directory(const char* filepath)
 {
@@ -944,17 +2895,18 @@ platform_iterdir_init(struct iterdir* iterator, struct fs_error* error)
 #ifdef _WIN32
     // Add a wildcard at the end of the directory path
     //
-    iterator->search_path = iterator->directory_path;
-    fs_path_append_char(&iterator->search_path, PLATFORM_PATHSEP, error);
-    fs_path_append_char(&iterator->search_path, '*', error);
-    fs_path_append_char(&iterator->search_path, '\0', error);
-    if (FS_ERROR_IS_SET(error)) {
+    struct fs_path* search_path = &iterator->search_path;
+    *search_path                = iterator->directory_path;
+    if (!path_append_segments(
+            search_path->buffer, &search_path->length, sizeof search_path->buffer, "*", 1, '/'
+        )) {
+        FS_SET_ERROR(error, FS_CODE_PATH_TOO_LONG, "fs_path buffer overflow");
         return;
     }
     // Find the first file in the directory
     //
     iterator->find_handle = FindFirstFileA(iterator->search_path.buffer, &iterator->find_data);
-    if (!iterator->find_handle) {
+    if (iterator->find_handle == INVALID_HANDLE_VALUE) {
         map_windows_error(
             "failed to open directory",
             GetLastError(),
@@ -1024,6 +2976,66 @@ platform_iterdir_step(struct iterdir* iterator, struct fs_error* error)
 #endif
 }
 
+static void
+platform_iterdir_entry_info(
+    struct iterdir* iterator, struct fs_entry* entry, unsigned flags, struct fs_error* error
+)
+{
+#ifdef _WIN32
+    // everything comes with the find data, converting from 100ns ticks since 1601
+    //
+    const WIN32_FIND_DATAA* data = &iterator->find_data;
+    (void)flags;
+    (void)error;
+    entry->type = platform_attributes_type(data->dwFileAttributes);
+    entry->size = ((uint64_t)data->nFileSizeHigh << 32) | data->nFileSizeLow;
+    const FILETIME mtime = data->ftLastWriteTime;
+    const uint64_t ticks = ((uint64_t)mtime.dwHighDateTime << 32) | mtime.dwLowDateTime;
+    entry->mtime_ns = ((int64_t)ticks - INT64_C(116444736000000000)) * 100;
+#else
+    switch (iterator->entry->d_type) {
+        case DT_REG:
+            entry->type = FS_ENTRY_FILE;
+            break;
+        case DT_DIR:
+            entry->type = FS_ENTRY_DIRECTORY;
+            break;
+        case DT_LNK:
+            entry->type = FS_ENTRY_SYMLINK;
+            break;
+        case DT_UNKNOWN:
+            entry->type = FS_ENTRY_UNKNOWN;
+            break;
+        default:
+            entry->type = FS_ENTRY_OTHER;
+            break;
+    }
+
+    // some filesystems don't fill in d_type, only then is a stat needed to get the type
+    //
+    if (entry->type != FS_ENTRY_UNKNOWN && !(flags & FS_ENTRY_STAT)) {
+        return;
+    }
+
+    struct stat st;
+    if (fstatat(dirfd(iterator->dir_handle), iterator->entry->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+        map_errno(
+            "failed to stat directory entry", errno, FS_CODE_UNSPECIFIED, entry->path.buffer, error
+        );
+        return;
+    }
+    entry->type = platform_mode_type(st.st_mode);
+    if (flags & FS_ENTRY_STAT) {
+        entry->size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+        entry->mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        entry->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    }
+#endif
+}
+
 static void
 platform_iterdir_teardown(struct iterdir* iterator)
 {
@@ -1034,6 +3046,309 @@ platform_iterdir_teardown(struct iterdir* iterator)
 #endif
 }
 
+// A name next to `filepath` for an atomic write to go through, unique between the threads and
+// processes that might be replacing the same file.
+//
+static bool
+temporary_filepath(const char* filepath, char* buffer, size_t buffer_size, struct fs_error* error)
+{
+    static atomic_uint counter;
+#ifdef _WIN32
+    const unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+    const unsigned long pid = (unsigned long)getpid();
+#endif
+    const unsigned id     = atomic_fetch_add(&counter, 1);
+    const int      length = snprintf(buffer, buffer_size, "%s.tmp.%lu.%u", filepath, pid, id);
+    if (length < 0 || (size_t)length >= buffer_size) {
+        FS_SET_ERRORF(
+            error,
+            FS_CODE_PATH_TOO_LONG,
+            "temporary path for atomic write is too long: %s",
+            filepath
+        );
+        return false;
+    }
+    return true;
+}
+
+static void
+platform_write_filev(
+    const char*            filepath,
+    const struct fs_iovec* iov,
+    size_t                 count,
+    unsigned               flags,
+    struct fs_error*       error
+)
+{
+    const bool  atomic = flags & FS_WRITE_ATOMIC;
+    char        temporary[FS_PATH_MAX + 32];
+    const char* target = filepath;
+    if (atomic) {
+        if (!temporary_filepath(filepath, temporary, sizeof temporary, error)) return;
+        target = temporary;
+    }
+
+#ifdef _WIN32
+    // WriteFileGather only takes page aligned buffers to an unbuffered file, so the buffers are
+    // written one after another instead
+    //
+    HANDLE file = CreateFileA(
+        target,
+        GENERIC_WRITE,
+        0,
+        NULL,
+        (atomic) ? CREATE_NEW : CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        map_windows_error(
+            "failed to open file", GetLastError(), FS_CODE_OPEN_FAILED, filepath, error
+        );
+        return;
+    }
+    for (size_t i = 0; i < count && !FS_ERROR_IS_SET(error); i++) {
+        const char* data      = iov[i].data;
+        size_t      remaining = iov[i].size;
+        while (remaining > 0) {
+            const DWORD chunk   = (remaining > (1u << 30)) ? (1u << 30) : (DWORD)remaining;
+            DWORD       written = 0;
+            if (!WriteFile(file, data, chunk, &written, NULL)) {
+                map_windows_error(
+                    "failed to write file", GetLastError(), FS_CODE_WRITE_FAILED, filepath, error
+                );
+                break;
+            }
+            data += written;
+            remaining -= written;
+        }
+    }
+    if (!FS_ERROR_IS_SET(error) && (flags & FS_WRITE_SYNC) && !FlushFileBuffers(file)) {
+        map_windows_error(
+            "failed to sync file", GetLastError(), FS_CODE_WRITE_FAILED, filepath, error
+        );
+    }
+    CloseHandle(file);
+
+    if (atomic && !FS_ERROR_IS_SET(error)) {
+        const DWORD move_flags =
+            MOVEFILE_REPLACE_EXISTING | ((flags & FS_WRITE_SYNC) ? MOVEFILE_WRITE_THROUGH : 0);
+        if (!MoveFileExA(temporary, filepath, move_flags)) {
+            map_windows_error(
+                "failed to replace file", GetLastError(), FS_CODE_WRITE_FAILED, filepath, error
+            );
+        }
+    }
+    if (atomic && FS_ERROR_IS_SET(error)) {
+        DeleteFileA(temporary);
+    }
+#else
+    const int open_flags = O_WRONLY | O_CREAT | O_CLOEXEC | ((atomic) ? O_EXCL : O_TRUNC);
+    const int fd         = open(target, open_flags, 0666);
+    if (fd == -1) {
+        map_errno("failed to open file", errno, FS_CODE_OPEN_FAILED, filepath, error);
+        return;
+    }
+
+    // writev as many buffers at a time as fit in the batch and pick up after short writes
+    //
+    struct iovec batch[64];
+    size_t       index  = 0;
+    size_t       offset = 0;
+    for (;;) {
+        while (index < count && offset == iov[index].size) {
+            index++;
+            offset = 0;
+        }
+        if (index == count) {
+            break;
+        }
+
+        int batch_count = 0;
+        for (size_t i = index; i < count && batch_count < 64; i++, batch_count++) {
+            const size_t skip           = (i == index) ? offset : 0;
+            batch[batch_count].iov_base = (char*)iov[i].data + skip;
+            batch[batch_count].iov_len  = iov[i].size - skip;
+        }
+        ssize_t written = writev(fd, batch, batch_count);
+        if (written <= 0) {
+            if (written == -1 && errno == EINTR) continue;
+            const int code = (written == 0) ? EIO : errno;
+            map_errno("failed to write file", code, FS_CODE_WRITE_FAILED, filepath, error);
+            break;
+        }
+        while (written > 0) {
+            const size_t available = iov[index].size - offset;
+            if ((size_t)written < available) {
+                offset += (size_t)written;
+                break;
+            }
+            written -= (ssize_t)available;
+            index++;
+            offset = 0;
+        }
+    }
+
+    if (!FS_ERROR_IS_SET(error) && (flags & FS_WRITE_SYNC) && PLATFORM_DATASYNC(fd) != 0) {
+        map_errno("failed to sync file", errno, FS_CODE_WRITE_FAILED, filepath, error);
+    }
+    if (close(fd) != 0 && !FS_ERROR_IS_SET(error)) {
+        map_errno("failed to close file", errno, FS_CODE_WRITE_FAILED, filepath, error);
+    }
+
+    if (atomic && !FS_ERROR_IS_SET(error)) {
+        if (rename(temporary, filepath) != 0) {
+            map_errno("failed to replace file", errno, FS_CODE_WRITE_FAILED, filepath, error);
+        }
+        else if (flags & FS_WRITE_SYNC) {
+            // the rename is only durable once the directory holding it is synced
+            //
+            char        directory[FS_PATH_MAX + 32];
+            const char* separator = strrchr(filepath, PLATFORM_PATHSEP);
+            if (!separator) {
+                strcpy(directory, ".");
+            }
+            else {
+                const size_t length = (separator == filepath) ? 1 : (size_t)(separator - filepath);
+                memcpy(directory, filepath, length);
+                directory[length] = '\0';
+            }
+            const int directory_fd = open(directory, O_RDONLY | O_CLOEXEC);
+            if (directory_fd == -1 || fsync(directory_fd) != 0) {
+                map_errno(
+                    "failed to sync directory", errno, FS_CODE_WRITE_FAILED, directory, error
+                );
+            }
+            if (directory_fd != -1) close(directory_fd);
+        }
+    }
+    if (atomic && FS_ERROR_IS_SET(error)) {
+        unlink(temporary);
+    }
+#endif
+}
+
+static struct fs_mapping
+platform_map_file(const char* filepath, unsigned flags, struct fs_error* error)
+{
+    struct fs_mapping mapping = {0};
+#ifdef _WIN32
+    const DWORD attributes = FILE_ATTRIBUTE_NORMAL |
+                             ((flags & FS_MAP_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN : 0) |
+                             ((flags & FS_MAP_RANDOM) ? FILE_FLAG_RANDOM_ACCESS : 0);
+    HANDLE file =
+        CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, attributes, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        map_windows_error(
+            "failed to map file", GetLastError(), FS_CODE_OPEN_FAILED, filepath, error
+        );
+        return mapping;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        map_windows_error(
+            "failed to map file", GetLastError(), FS_CODE_SEEK_FAILED, filepath, error
+        );
+        CloseHandle(file);
+        return mapping;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return mapping;
+    }
+
+    // the view keeps the mapping alive, so both handles can be closed straight away
+    //
+    HANDLE file_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!file_mapping) {
+        map_windows_error(
+            "failed to map file", GetLastError(), FS_CODE_READ_FAILED, filepath, error
+        );
+        CloseHandle(file);
+        return mapping;
+    }
+    void* view = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        map_windows_error(
+            "failed to map file", GetLastError(), FS_CODE_READ_FAILED, filepath, error
+        );
+    }
+    CloseHandle(file_mapping);
+    CloseHandle(file);
+    if (!view) {
+        return mapping;
+    }
+
+    mapping.size = (size_t)size.QuadPart;
+    mapping.data = view;
+
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    if (flags & FS_MAP_WILLNEED) {
+        WIN32_MEMORY_RANGE_ENTRY range = {.VirtualAddress = view, .NumberOfBytes = mapping.size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+#else
+    const int fd = open(filepath, O_RDONLY);
+    if (fd == -1) {
+        map_errno("failed to map file", errno, FS_CODE_OPEN_FAILED, filepath, error);
+        return mapping;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        map_errno("failed to map file", errno, FS_CODE_SEEK_FAILED, filepath, error);
+        close(fd);
+        return mapping;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        map_errno("failed to map file", EISDIR, FS_CODE_IS_A_DIRECTORY, filepath, error);
+        close(fd);
+        return mapping;
+    }
+
+    // mmap rejects zero length mappings, an empty file is just an empty view
+    //
+    if (st.st_size == 0) {
+        close(fd);
+        return mapping;
+    }
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        map_errno("failed to map file", errno, FS_CODE_READ_FAILED, filepath, error);
+        return mapping;
+    }
+
+    mapping.size = (size_t)st.st_size;
+    mapping.data = view;
+
+    if (flags & FS_MAP_SEQUENTIAL) {
+        posix_madvise(view, mapping.size, POSIX_MADV_SEQUENTIAL);
+    }
+    if (flags & FS_MAP_RANDOM) {
+        posix_madvise(view, mapping.size, POSIX_MADV_RANDOM);
+    }
+    if (flags & FS_MAP_WILLNEED) {
+        posix_madvise(view, mapping.size, POSIX_MADV_WILLNEED);
+    }
+#endif
+    return mapping;
+}
+
+static void
+platform_unmap_file(struct fs_mapping* mapping)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapping->data);
+#else
+    munmap((void*)mapping->data, mapping->size);
+#endif
+}
+
 /*
 ==============================================================================
 OPTION 1 (MIT)
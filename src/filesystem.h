@@ -3,8 +3,12 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "allocator.h"
+#include "string_view.h"
+
 #ifndef FS_ASSERT
 #include <assert.h>
 #define FS_ASSERT assert
@@ -15,6 +19,11 @@
 #define FS_DEFAULT_MALLOC malloc
 #endif
 
+#ifndef FS_DEFAULT_REALLOC
+#include <stdlib.h>
+#define FS_DEFAULT_REALLOC realloc
+#endif
+
 #ifndef FS_DEFAULT_FREE
 #include <stdlib.h>
 #define FS_DEFAULT_FREE free
@@ -24,6 +33,26 @@
 #define FS_PATH_MAX 512
 #endif
 
+#ifndef FS_WALK_DEFAULT_THREAD_COUNT
+#define FS_WALK_DEFAULT_THREAD_COUNT 8
+#endif
+
+#ifndef FS_BATCH_THREAD_COUNT
+#define FS_BATCH_THREAD_COUNT 8
+#endif
+
+#ifndef FS_BATCH_QUEUE_DEPTH
+#define FS_BATCH_QUEUE_DEPTH 64
+#endif
+
+#ifndef FS_STAT_CACHE_MAX_WATCHES
+#define FS_STAT_CACHE_MAX_WATCHES 4096
+#endif
+
+#ifndef FS_STREAM_DEFAULT_BUFFER_SIZE
+#define FS_STREAM_DEFAULT_BUFFER_SIZE (256 * 1024)
+#endif
+
 enum fs_error_code {
     FS_CODE_SUCCESS = 0,
     FS_CODE_OUT_OF_MEMORY,
@@ -59,16 +88,239 @@ struct fs_content {
     void*  data;
 };
 
-typedef void            FilesystemAllocator;
+// A read-only view of a file mapped into memory, see `fs_map_file`.
+//
+struct fs_mapping {
+    size_t      size;
+    const void* data;  // not null terminated, NULL for an empty file
+};
+
+// Access pattern hints for `fs_map_file`, they are only advice to the OS.
+//
+enum fs_map_flags {
+    FS_MAP_SEQUENTIAL = 1 << 0,  // read ahead aggressively, pages can be dropped once read
+    FS_MAP_RANDOM     = 1 << 1,  // don't bother reading ahead
+    FS_MAP_WILLNEED   = 1 << 2,  // start reading the whole file in now
+};
+
+// NULL uses FS_DEFAULT_MALLOC/FS_DEFAULT_FREE, anything else goes through `allocator_malloc`
+// so for example many files can be read into one arena and released together.
+//
+typedef struct allocator FilesystemAllocator;
+
+// Options for `fs_stream_open`.
+//
+enum fs_stream_flags {
+    // chunks end on a '\n' and the partial line after it is carried over into the next chunk,
+    // a line that doesn't fit in the buffer is split at the buffer size
+    //
+    FS_STREAM_LINES = 1 << 0,
+};
+
+// Reads a file in chunks through one fixed size buffer, so memory use doesn't depend on the
+// size of the file. Either the caller supplies the buffer or one is allocated on open.
+//
+struct fs_stream {
+    FILE*                file;
+    char*                buffer;
+    size_t               capacity;
+    size_t               length;    // bytes currently in the buffer
+    size_t               consumed;  // bytes at the front of the buffer already yielded
+    unsigned             flags;
+    bool                 eof;
+    bool                 owns_buffer;
+    FilesystemAllocator* allocator;
+};
+
 typedef struct iterdir* FilesystemDirectoryIterator;
 
+// Builds up absolute paths segment by segment without copying whole paths around, as when
+// walking a tree by pushing a name, using the path and truncating back. It starts out in its
+// own storage and only moves into memory from the allocator when a path outgrows FS_PATH_MAX,
+// so it must not be copied by value.
+//
+struct fs_path_builder {
+    char*                data;  // always null terminated
+    size_t               length;
+    size_t               capacity;
+    FilesystemAllocator* allocator;
+    char                 storage[FS_PATH_MAX];
+};
+
+enum fs_batch_operation {
+    FS_BATCH_READ = 0,
+    FS_BATCH_WRITE,
+};
+
+// One file in an `fs_batch_run`. Reads fill in `content` like `fs_read_file_binary`, writes
+// take `data` and `size` like `fs_write_file`. Each request gets its own error.
+//
+struct fs_batch_request {
+    enum fs_batch_operation operation;
+    const char*             filepath;
+    const void*             data;
+    size_t                  size;
+    struct fs_content       content;
+    struct fs_error         error;
+};
+
+// One buffer of a gather write, see `fs_write_filev`.
+//
+struct fs_iovec {
+    const void* data;
+    size_t      size;
+};
+
+// Options for `fs_write_filev`.
+//
+enum fs_write_flags {
+    // write to a temporary file next to the target then rename it into place, so readers only
+    // ever see the old contents or the new ones
+    //
+    FS_WRITE_ATOMIC = 1 << 0,
+    // flush the data to the device before returning (and the rename too with FS_WRITE_ATOMIC)
+    //
+    FS_WRITE_SYNC = 1 << 1,
+};
+
+// Options for `fs_batch_run`.
+//
+enum fs_batch_flags {
+    FS_BATCH_THREADS = 1 << 0,  // use the thread pool even where io_uring is available
+};
+
+enum fs_entry_type {
+    FS_ENTRY_UNKNOWN = 0,
+    FS_ENTRY_FILE,
+    FS_ENTRY_DIRECTORY,
+    FS_ENTRY_SYMLINK,  // symlinks are reported as themselves, never followed
+    FS_ENTRY_OTHER,    // devices, pipes, sockets...
+};
+
+// Options for `fs_iterdir_next_entry`.
+//
+enum fs_entry_flags {
+    // fill in size and mtime, free on windows but one fstatat per entry elsewhere
+    //
+    FS_ENTRY_STAT = 1 << 0,
+};
+
+// A directory entry with the type the OS reported alongside the name, so walking a tree
+// doesn't need a stat per entry to tell files and directories apart.
+//
+struct fs_entry {
+    struct fs_path     path;
+    enum fs_entry_type type;
+    uint64_t           size;      // only set with FS_ENTRY_STAT
+    int64_t            mtime_ns;  // only set with FS_ENTRY_STAT, nanoseconds since the unix epoch
+};
+
+// What the OS knows about a path, symlinks are followed like `fs_path_is_dir` and friends.
+//
+struct fs_stat {
+    enum fs_entry_type type;  // FS_ENTRY_UNKNOWN when the path doesn't exist
+    uint64_t           size;
+    int64_t            mtime_ns;  // nanoseconds since the unix epoch
+};
+
+// Options for `fs_stat_cache_create`.
+//
+enum fs_stat_cache_flags {
+    // watch the directories of cached paths (inotify) and drop entries when they change, the
+    // watcher runs on its own thread so changes show up shortly after they happen rather than
+    // immediately. Only supported on linux for now.
+    //
+    FS_STAT_CACHE_WATCH = 1 << 0,
+};
+
+typedef struct stat_cache* FilesystemStatCache;
+
+// Counters for the public entry points, only maintained when filesystem.c is built with
+// FS_STATS defined, otherwise they stay at zero and the trace callback is never called.
+//
+enum fs_operation {
+    FS_OPERATION_READ,          // fs_read_file_*, bytes read
+    FS_OPERATION_WRITE,         // fs_write_file*, bytes written
+    FS_OPERATION_MAP,           // fs_map_file, bytes mapped
+    FS_OPERATION_STREAM,        // fs_stream_next, one call per chunk
+    FS_OPERATION_BATCH,         // fs_batch_run, bytes read and written by all requests
+    FS_OPERATION_ITERDIR,       // fs_iterdir, opening the directory
+    FS_OPERATION_ITERDIR_NEXT,  // fs_iterdir_next*, one call per entry, bytes of the names
+    FS_OPERATION_WALK,          // fs_walk
+    FS_OPERATION_STAT,          // fs_path_stat, fs_path_exists/is_dir/is_file
+    FS_OPERATION_MKDIR,         // fs_path_mkdir, once per directory created
+    FS_OPERATION_REMOVE,        // fs_path_rmfile and fs_path_rmdir
+    FS_OPERATION_COUNT,
+};
+
+struct fs_operation_stats {
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t ns;  // wall time spent inside the calls
+};
+
+struct fs_stats {
+    struct fs_operation_stats operations[FS_OPERATION_COUNT];
+};
+
+// Called as each instrumented call returns, from whichever thread made it.
+//
+typedef void (*fs_trace_callback)(
+    enum fs_operation, const char* filepath, uint64_t bytes, uint64_t ns, void* user_data
+);
+
+enum fs_walk_action {
+    FS_WALK_CONTINUE = 0,
+    FS_WALK_PRUNE,  // don't descend into this directory
+    FS_WALK_STOP,   // finish the walk early, without an error
+};
+
+// Called for entries found by `fs_walk`, from several threads at once. The depth of the
+// entries directly inside the root is 1. Setting the error stops the walk and reports it.
+//
+typedef enum fs_walk_action (*fs_walk_visitor)(
+    const struct fs_entry*, size_t depth, void* user_data, struct fs_error* error
+);
+
+struct fs_walk_options {
+    size_t          thread_count;  // 0 uses FS_WALK_DEFAULT_THREAD_COUNT, 1 walks on the caller
+    size_t          max_depth;     // entries deeper than this are not visited, 0 means no limit
+    unsigned        entry_flags;   // passed on to `fs_iterdir_next_entry`
+    fs_walk_visitor post_visit;    // called for a directory once everything in it is visited
+};
+
 // clang-format off
 
 FILE*             fs_open(const char* filepath, const char* mode, struct fs_error*);
 void              fs_close(FILE*);
 struct fs_content fs_read_file_binary(const char* filepath, FilesystemAllocator*, struct fs_error*);
 struct fs_content fs_read_file_text(const char* filepath, FilesystemAllocator*, struct fs_error*);
+
+// Reads the rest of an open stream which doesn't have to be seekable, stdin or a pipe for
+// example. Null terminated like the other reads.
+//
+struct fs_content fs_read_all(FILE*, FilesystemAllocator*, struct fs_error*);
 void              fs_write_file(const char* filepath, const void* data, size_t data_size, struct fs_error*);
+void              fs_write_filev(const char* filepath, const struct fs_iovec*, size_t count, unsigned flags, struct fs_error*);
+
+// Runs many reads and writes at once to keep the device busy, with io_uring on linux and a
+// pool of threads elsewhere. Allocations for reads are serialized, so any allocator works.
+// Returns the number of requests that failed.
+//
+size_t            fs_batch_run(struct fs_batch_request*, size_t count, unsigned flags, FilesystemAllocator*);
+
+// Maps a file into memory rather than copying it, the view stays valid until `fs_unmap`
+// (closing or modifying the file underneath it is not safe).
+//
+struct fs_mapping fs_map_file(const char* filepath, unsigned flags, struct fs_error*);
+void              fs_unmap(struct fs_mapping*);
+
+// A NULL buffer allocates one of `buffer_size` bytes (FS_STREAM_DEFAULT_BUFFER_SIZE if zero)
+// from the allocator. Each chunk from `fs_stream_next` is valid until the next call.
+//
+struct fs_stream  fs_stream_open(const char* filepath, void* buffer, size_t buffer_size, unsigned flags, FilesystemAllocator*, struct fs_error*);
+bool              fs_stream_next(struct fs_stream*, struct string_view* chunk, struct fs_error*);
+void              fs_stream_close(struct fs_stream*);
 
 struct fs_path    fs_path_cwd(struct fs_error*);
 struct fs_path    fs_path_resolve(const char* filepath, struct fs_error*);
@@ -86,23 +338,148 @@ void              fs_path_rmfile(const struct fs_path*, struct fs_error*);
 const char*       fs_path_filename(const struct fs_path*, size_t* length);
 const char*       fs_path_ext(const struct fs_path*, size_t* length);
 void              fs_path_write(const struct fs_path*, void* data, size_t nbytes, struct fs_error*);
+void              fs_path_writev(const struct fs_path*, const struct fs_iovec*, size_t count, unsigned flags, struct fs_error*);
 struct fs_content fs_path_read_text(const struct fs_path*, FilesystemAllocator*, struct fs_error*);
 struct fs_content fs_path_read_binary(const struct fs_path*, FilesystemAllocator*, struct fs_error*);
+void               fs_path_builder_init(struct fs_path_builder*, const struct fs_path* base, FilesystemAllocator*);
+void               fs_path_builder_push(struct fs_path_builder*, struct string_view relative, struct fs_error*);
+void               fs_path_builder_pop(struct fs_path_builder*);
+void               fs_path_builder_truncate(struct fs_path_builder*, size_t length);
+struct string_view fs_path_builder_view(const struct fs_path_builder*);
+struct fs_path     fs_path_builder_to_path(const struct fs_path_builder*, struct fs_error*);
+void               fs_path_builder_free(struct fs_path_builder*);
+
+struct fs_stat    fs_path_stat(const struct fs_path*, struct fs_error*);
+
+// An opt-in cache in front of `fs_path_stat` keyed by path, repeated queries are hash lookups.
+// Without FS_STAT_CACHE_WATCH entries stay until invalidated, `fs_stat_cache_invalidate_all`
+// only bumps a generation counter. A cache is used from one thread at a time.
+//
+FilesystemStatCache fs_stat_cache_create(unsigned flags, FilesystemAllocator*, struct fs_error*);
+void                fs_stat_cache_destroy(FilesystemStatCache);
+struct fs_stat      fs_stat_cache_get(FilesystemStatCache, const struct fs_path*, struct fs_error*);
+bool                fs_stat_cache_exists(FilesystemStatCache, const struct fs_path*);
+bool                fs_stat_cache_is_dir(FilesystemStatCache, const struct fs_path*);
+bool                fs_stat_cache_is_file(FilesystemStatCache, const struct fs_path*);
+void                fs_stat_cache_invalidate(FilesystemStatCache, const struct fs_path*);
+void                fs_stat_cache_invalidate_all(FilesystemStatCache);
+
+struct fs_mapping fs_path_map(const struct fs_path*, unsigned flags, struct fs_error*);
+struct fs_stream  fs_path_stream(const struct fs_path*, void* buffer, size_t buffer_size, unsigned flags, FilesystemAllocator*, struct fs_error*);
 
 FilesystemDirectoryIterator
      fs_iterdir(const struct fs_path*, FilesystemAllocator*, struct fs_error*);
 bool fs_iterdir_next(FilesystemDirectoryIterator, struct fs_path* outpath, struct fs_error*);
+bool fs_iterdir_next_entry(FilesystemDirectoryIterator, struct fs_entry*, unsigned flags, struct fs_error*);
+bool fs_iterdir_next_name(FilesystemDirectoryIterator, struct string_view* name, struct fs_error*);
 void fs_iterdir_free(FilesystemDirectoryIterator);
 
+// Process wide, `fs_set_trace_callback` should not race with instrumented calls. NULL removes
+// the callback.
+//
+struct fs_stats fs_stats(void);
+void            fs_stats_reset(void);
+void            fs_set_trace_callback(fs_trace_callback, void* user_data);
+const char*     fs_operation_name(enum fs_operation);
+
+// Walks the tree under `root` using a pool of threads, each directory is listed by one thread
+// and the subdirectories it finds are shared out through work stealing. NULL options are the
+// defaults. Symlinks are visited but never followed.
+//
+void fs_walk(const struct fs_path* root, fs_walk_visitor visit, void* user_data, const struct fs_walk_options*, struct fs_error*);
+
 // clang-format on
 
 #ifdef FILESYSTEM_TEST_MAIN
 
 #include <string.h>
 #include <assert.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #define TEST_ASSERT(expr) assert(expr)
 #define ASSERT_PATHS_EQUAL(path1, path2) TEST_ASSERT(strcmp((path1).buffer, (path2).buffer) == 0)
 
+#include <stdatomic.h>
+#include <threads.h>
+
+struct trace_test {
+    size_t   calls[FS_OPERATION_COUNT];
+    uint64_t bytes[FS_OPERATION_COUNT];
+};
+
+static void
+trace_test_callback(
+    enum fs_operation operation, const char* filepath, uint64_t bytes, uint64_t ns, void* user_data
+)
+{
+    (void)filepath;
+    (void)ns;
+    struct trace_test* test = user_data;
+    test->calls[operation]++;
+    test->bytes[operation] += bytes;
+}
+
+struct walk_test {
+    atomic_size_t directories;
+    atomic_size_t files;
+    atomic_size_t post_visits;
+    atomic_size_t max_depth;
+    const char*   prune;         // directory name to prune
+    bool          stop;          // stop on the first entry
+    bool          fail;          // fail on the first file
+};
+
+static bool
+walk_test_filename_is(const struct fs_entry* entry, const char* name)
+{
+    size_t      length;
+    const char* filename = fs_path_filename(&entry->path, &length);
+    return length == strlen(name) && memcmp(filename, name, length) == 0;
+}
+
+static enum fs_walk_action
+walk_test_visit(const struct fs_entry* entry, size_t depth, void* user_data, struct fs_error* error)
+{
+    struct walk_test* test = user_data;
+    if (test->stop) {
+        atomic_fetch_add(&test->files, 1);
+        return FS_WALK_STOP;
+    }
+
+    size_t max_depth = atomic_load(&test->max_depth);
+    while (depth > max_depth && !atomic_compare_exchange_weak(&test->max_depth, &max_depth, depth))
+        ;
+
+    if (entry->type == FS_ENTRY_DIRECTORY) {
+        atomic_fetch_add(&test->directories, 1);
+        if (test->prune && walk_test_filename_is(entry, test->prune)) {
+            return FS_WALK_PRUNE;
+        }
+    }
+    else {
+        TEST_ASSERT(entry->type == FS_ENTRY_FILE);
+        atomic_fetch_add(&test->files, 1);
+        if (test->fail) {
+            error->code = FS_CODE_UNSPECIFIED;
+        }
+    }
+    return FS_WALK_CONTINUE;
+}
+
+static enum fs_walk_action
+walk_test_post_visit(
+    const struct fs_entry* entry, size_t depth, void* user_data, struct fs_error* error
+)
+{
+    (void)depth;
+    (void)error;
+    struct walk_test* test = user_data;
+    TEST_ASSERT(entry->type == FS_ENTRY_DIRECTORY);
+    atomic_fetch_add(&test->post_visits, 1);
+    return FS_WALK_CONTINUE;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -148,6 +525,55 @@ main(int argc, char** argv)
         TEST_ASSERT(error.code == FS_CODE_PATH_TOO_LONG);
     }
 
+    // path builder
+    //
+    {
+        struct fs_path         base = fs_path_resolve("build", NULL);
+        struct fs_path_builder builder;
+        fs_path_builder_init(&builder, &base, NULL);
+        TEST_ASSERT(sv_equal(fs_path_builder_view(&builder), SV_CSTR(base.buffer)));
+
+        // segments are normalized as they are pushed
+        //
+        fs_path_builder_push(&builder, SV_LITERAL("a/./b//../c"), NULL);
+        struct fs_path expected = fs_path_join(&base, "a/c", NULL);
+        TEST_ASSERT(strcmp(builder.data, expected.buffer) == 0);
+
+        const size_t mark = builder.length;
+        fs_path_builder_push(&builder, SV_LITERAL("d"), NULL);
+        fs_path_builder_truncate(&builder, mark);
+        TEST_ASSERT(strcmp(builder.data, expected.buffer) == 0);
+
+        fs_path_builder_pop(&builder);
+        expected = fs_path_join(&base, "a", NULL);
+        ASSERT_PATHS_EQUAL(fs_path_builder_to_path(&builder, NULL), expected);
+
+        struct fs_error error = {0};
+        fs_path_builder_push(&builder, SV_CSTR(base.buffer), &error);
+        TEST_ASSERT(error.code == FS_CODE_INVALID_PATH);
+
+        // paths longer than FS_PATH_MAX move into the allocator
+        //
+        struct allocator ARENA_ALLOCATOR(arena, 4096);
+        fs_path_builder_free(&builder);
+        fs_path_builder_init(&builder, &base, &arena);
+        for (size_t i = 0; i < FS_PATH_MAX / 8; i++) {
+            fs_path_builder_push(&builder, SV_LITERAL("segment"), NULL);
+        }
+        TEST_ASSERT(builder.length == base.length + FS_PATH_MAX);
+        TEST_ASSERT(builder.data != builder.storage);
+        TEST_ASSERT(builder.data[builder.length] == '\0');
+
+        error = (struct fs_error){0};
+        fs_path_builder_to_path(&builder, &error);
+        TEST_ASSERT(error.code == FS_CODE_PATH_TOO_LONG);
+
+        fs_path_builder_truncate(&builder, base.length);
+        TEST_ASSERT(strcmp(builder.data, base.buffer) == 0);
+        fs_path_builder_free(&builder);
+        allocator_destroy(&arena);
+    }
+
     // filename
     //
     {
@@ -321,6 +747,270 @@ main(int argc, char** argv)
         TEST_ASSERT(error.code == FS_CODE_IS_A_DIRECTORY);
     }
 
+    // fs_read_all
+    //
+    {
+        struct fs_path path = fs_path_join(&test_dir, "read_all_file", NULL);
+        char           data[100000];
+        for (size_t i = 0; i < sizeof data; i++) {
+            data[i] = (char)('a' + i % 26);
+        }
+        fs_path_write(&path, data, sizeof data, NULL);
+
+        // starts from wherever the stream is
+        //
+        FILE* file = fs_open(path.buffer, "rb", NULL);
+        TEST_ASSERT(fgetc(file) == 'a');
+        struct fs_content content = fs_read_all(file, NULL, NULL);
+        fs_close(file);
+        TEST_ASSERT(content.size == sizeof data - 1);
+        TEST_ASSERT(memcmp(content.data, data + 1, content.size) == 0);
+        TEST_ASSERT(((char*)content.data)[content.size] == '\0');
+        free(content.data);
+
+        fs_path_write(&path, "", 0, NULL);
+        file    = fs_open(path.buffer, "rb", NULL);
+        content = fs_read_all(file, NULL, NULL);
+        fs_close(file);
+        TEST_ASSERT(content.size == 0 && content.data && *(char*)content.data == '\0');
+        free(content.data);
+    }
+
+    // fs_map_file
+    //
+    {
+        struct fs_path path = fs_path_join(&test_dir, "mapped_file", NULL);
+        fs_path_write(&path, "mapped contents", 15, NULL);
+
+        struct fs_mapping mapping = fs_path_map(&path, FS_MAP_SEQUENTIAL | FS_MAP_WILLNEED, NULL);
+        TEST_ASSERT(mapping.size == 15);
+        TEST_ASSERT(memcmp(mapping.data, "mapped contents", 15) == 0);
+        fs_unmap(&mapping);
+        TEST_ASSERT(mapping.data == NULL);
+
+        // empty file
+        //
+        fs_path_write(&path, "", 0, NULL);
+        mapping = fs_path_map(&path, 0, NULL);
+        TEST_ASSERT(mapping.size == 0 && mapping.data == NULL);
+        fs_unmap(&mapping);
+        fs_path_rmfile(&path, NULL);
+
+        // file that does not exist
+        //
+        struct fs_error error = {0};
+        mapping               = fs_path_map(&path, 0, &error);
+        TEST_ASSERT(error.code == FS_CODE_FILE_NOT_FOUND);
+
+        // file that is a directory
+        //
+        error   = (struct fs_error){0};
+        mapping = fs_path_map(&test_dir, 0, &error);
+        TEST_ASSERT(error.code == FS_CODE_IS_A_DIRECTORY);
+    }
+
+    // reading many files into one arena
+    //
+    {
+        struct fs_path dir = fs_path_join(&test_dir, "arena_files", NULL);
+        fs_path_mkdir(&dir, true, NULL);
+
+        char name[32];
+        for (int i = 0; i < 64; i++) {
+            snprintf(name, sizeof(name), "file%d", i);
+            struct fs_path path = fs_path_join(&dir, name, NULL);
+            fs_path_write(&path, name, strlen(name), NULL);
+        }
+
+        struct allocator ARENA_ALLOCATOR(arena, 4096);
+
+        FilesystemDirectoryIterator iterator = fs_iterdir(&dir, &arena, NULL);
+        struct fs_path              path;
+        size_t                      count = 0;
+        while (fs_iterdir_next(iterator, &path, NULL)) {
+            size_t            length;
+            const char*       filename = fs_path_filename(&path, &length);
+            struct fs_content content  = fs_path_read_text(&path, &arena, NULL);
+            TEST_ASSERT(content.size == length && memcmp(content.data, filename, length) == 0);
+            count++;
+        }
+        TEST_ASSERT(count == 64);
+
+        struct allocator_stats stats = allocator_stats(&arena);
+        TEST_ASSERT(stats.live_count == 65);  // the contents and the iterator
+        fs_iterdir_free(iterator);
+        TEST_ASSERT(allocator_stats(&arena).live_count == 64);
+
+        allocator_destroy(&arena);
+        fs_path_rmdir(&dir, true, NULL);
+    }
+
+    // fs_write_filev
+    //
+    {
+        struct fs_path dir = fs_path_join(&test_dir, "writev", NULL);
+        fs_path_mkdir(&dir, true, NULL);
+        struct fs_path path = fs_path_join(&dir, "file", NULL);
+
+        const struct fs_iovec iov[] = {
+            {.data = "hello", .size = 5},
+            {.data = NULL, .size = 0},
+            {.data = ", ", .size = 2},
+            {.data = "world", .size = 5},
+        };
+        fs_path_writev(&path, iov, sizeof iov / sizeof *iov, 0, NULL);
+        struct fs_content content = fs_path_read_text(&path, NULL, NULL);
+        TEST_ASSERT(strcmp(content.data, "hello, world") == 0);
+        free(content.data);
+
+        // more buffers than go to writev at once
+        //
+        struct fs_iovec many[150];
+        for (size_t i = 0; i < 150; i++) {
+            many[i] = (struct fs_iovec){.data = "ab", .size = 2};
+        }
+        fs_path_writev(&path, many, 150, 0, NULL);
+        content = fs_path_read_binary(&path, NULL, NULL);
+        TEST_ASSERT(content.size == 300);
+        TEST_ASSERT(memcmp((char*)content.data + 296, "abab", 4) == 0);
+        free(content.data);
+
+        // atomic replacement leaves nothing else behind in the directory
+        //
+        fs_path_writev(&path, iov + 3, 1, FS_WRITE_ATOMIC | FS_WRITE_SYNC, NULL);
+        content = fs_path_read_text(&path, NULL, NULL);
+        TEST_ASSERT(strcmp(content.data, "world") == 0);
+        free(content.data);
+
+        FilesystemDirectoryIterator iterator = fs_iterdir(&dir, NULL, NULL);
+        struct fs_path              entry;
+        size_t                      count = 0;
+        while (fs_iterdir_next(iterator, &entry, NULL)) {
+            ASSERT_PATHS_EQUAL(entry, path);
+            count++;
+        }
+        TEST_ASSERT(count == 1);
+        fs_iterdir_free(iterator);
+
+        // a directory that doesn't exist
+        //
+        struct fs_error error   = {0};
+        struct fs_path  missing = fs_path_join(&dir, "missing/file", NULL);
+        fs_path_writev(&missing, iov, 1, FS_WRITE_ATOMIC, &error);
+        TEST_ASSERT(error.code == FS_CODE_FILE_NOT_FOUND);
+
+        fs_path_rmdir(&dir, true, NULL);
+    }
+
+    // fs_batch_run, with io_uring where it's available and with the thread pool
+    //
+    for (int use_threads = 0; use_threads < 2; use_threads++) {
+        struct fs_path dir = fs_path_join(&test_dir, "batch_files", NULL);
+        fs_path_mkdir(&dir, true, NULL);
+
+        // more files than FS_BATCH_QUEUE_DEPTH to go through a few windows
+        //
+        enum { COUNT = FS_BATCH_QUEUE_DEPTH * 2 + 3 };
+        const unsigned          flags = (use_threads) ? FS_BATCH_THREADS : 0;
+        struct fs_path          paths[COUNT];
+        char                    contents[COUNT][32];
+        struct fs_batch_request requests[COUNT + 2];
+        for (int i = 0; i < COUNT; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "file%d", i);
+            snprintf(contents[i], sizeof(contents[i]), "contents of file %d", i);
+            paths[i]    = fs_path_join(&dir, name, NULL);
+            requests[i] = (struct fs_batch_request){
+                .operation = FS_BATCH_WRITE,
+                .filepath  = paths[i].buffer,
+                .data      = contents[i],
+                .size      = strlen(contents[i]),
+            };
+        }
+        TEST_ASSERT(fs_batch_run(requests, COUNT, flags, NULL) == 0);
+
+        // reads into an arena, along with a file that doesn't exist and a directory
+        //
+        struct fs_path missing = fs_path_join(&dir, "missing", NULL);
+        for (int i = 0; i < COUNT; i++) {
+            requests[i] = (struct fs_batch_request){.filepath = paths[i].buffer};
+        }
+        requests[COUNT]     = (struct fs_batch_request){.filepath = missing.buffer};
+        requests[COUNT + 1] = (struct fs_batch_request){.filepath = dir.buffer};
+
+        struct allocator ARENA_ALLOCATOR(arena, 4096);
+        TEST_ASSERT(fs_batch_run(requests, COUNT + 2, flags, &arena) == 2);
+        for (int i = 0; i < COUNT; i++) {
+            TEST_ASSERT(requests[i].error.code == FS_CODE_SUCCESS);
+            TEST_ASSERT(requests[i].content.size == strlen(contents[i]));
+            TEST_ASSERT(strcmp(requests[i].content.data, contents[i]) == 0);
+        }
+        TEST_ASSERT(requests[COUNT].error.code == FS_CODE_FILE_NOT_FOUND);
+        TEST_ASSERT(requests[COUNT].content.data == NULL);
+        TEST_ASSERT(requests[COUNT + 1].error.code == FS_CODE_IS_A_DIRECTORY);
+        TEST_ASSERT(allocator_stats(&arena).live_count == COUNT);
+
+        allocator_destroy(&arena);
+        fs_path_rmdir(&dir, true, NULL);
+    }
+
+    // fs_stream
+    //
+    {
+        struct fs_path path     = fs_path_join(&test_dir, "streamed_file", NULL);
+        const char     text[]   = "first line\nsecond\na line that is longer than the buffer\nend";
+        const size_t   text_len = sizeof(text) - 1;
+        fs_path_write(&path, (void*)text, text_len, NULL);
+
+        // plain chunks fill the buffer every time
+        //
+        char             buffer[16];
+        struct fs_stream stream = fs_path_stream(&path, buffer, sizeof(buffer), 0, NULL, NULL);
+        struct string_view chunk;
+        size_t             offset = 0;
+        while (fs_stream_next(&stream, &chunk, NULL)) {
+            TEST_ASSERT(chunk.length == sizeof(buffer) || offset + chunk.length == text_len);
+            TEST_ASSERT(memcmp(chunk.data, text + offset, chunk.length) == 0);
+            offset += chunk.length;
+        }
+        TEST_ASSERT(offset == text_len);
+        fs_stream_close(&stream);
+
+        // line chunks end on a newline unless the line is longer than the buffer
+        //
+        const char* expected[] = {
+            "first line\n",
+            "second\n",
+            "a line that is l",
+            "onger than the b",
+            "uffer\nend",
+        };
+        stream = fs_path_stream(&path, buffer, sizeof(buffer), FS_STREAM_LINES, NULL, NULL);
+        size_t count = 0;
+        while (fs_stream_next(&stream, &chunk, NULL)) {
+            TEST_ASSERT(count < sizeof(expected) / sizeof(*expected));
+            TEST_ASSERT(sv_equal(chunk, SV_CSTR(expected[count])));
+            count++;
+        }
+        TEST_ASSERT(count == sizeof(expected) / sizeof(*expected));
+        fs_stream_close(&stream);
+
+        // an allocated buffer reads the whole file in one chunk
+        //
+        stream = fs_path_stream(&path, NULL, 0, FS_STREAM_LINES, NULL, NULL);
+        TEST_ASSERT(stream.capacity == FS_STREAM_DEFAULT_BUFFER_SIZE);
+        TEST_ASSERT(fs_stream_next(&stream, &chunk, NULL));
+        TEST_ASSERT(chunk.length == text_len);
+        TEST_ASSERT(!fs_stream_next(&stream, &chunk, NULL));
+        fs_stream_close(&stream);
+        fs_path_rmfile(&path, NULL);
+
+        struct fs_error error = {0};
+        stream                = fs_path_stream(&path, NULL, 0, 0, NULL, &error);
+        TEST_ASSERT(error.code == FS_CODE_FILE_NOT_FOUND);
+        TEST_ASSERT(stream.file == NULL && stream.buffer == NULL);
+    }
+
     // iterdir
     //
     {
@@ -354,8 +1044,303 @@ main(int argc, char** argv)
         }
 
         fs_iterdir_free(iterator);
+
+        // names only, without building a path per entry
+        //
+        iterator = fs_iterdir(&test_dir, NULL, NULL);
+        struct string_view name;
+        size_t             count = 0;
+        while (fs_iterdir_next_name(iterator, &name, NULL)) {
+            TEST_ASSERT(name.length > 0 && name.data[name.length] == '\0');
+            count++;
+        }
+        TEST_ASSERT(count >= sizeof paths / sizeof *paths);
+        fs_iterdir_free(iterator);
     }
 
+    // iterdir entries
+    //
+    {
+        bool                        seen_file = false, seen_dir = false;
+        FilesystemDirectoryIterator iterator  = fs_iterdir(&test_dir, NULL, NULL);
+        struct fs_entry             entry;
+
+        while (fs_iterdir_next_entry(iterator, &entry, FS_ENTRY_STAT, NULL)) {
+            size_t      length;
+            const char* filename = fs_path_filename(&entry.path, &length);
+            if (length == 8 && memcmp(filename, "new_file", 8) == 0) {
+                TEST_ASSERT(entry.type == FS_ENTRY_FILE);
+                TEST_ASSERT(entry.size == sizeof(int));
+                TEST_ASSERT(entry.mtime_ns > 0);
+                seen_file = true;
+            }
+            else if (length == 7 && memcmp(filename, "nested1", 7) == 0) {
+                TEST_ASSERT(entry.type == FS_ENTRY_DIRECTORY);
+                seen_dir = true;
+            }
+        }
+        TEST_ASSERT(seen_file && seen_dir);
+        fs_iterdir_free(iterator);
+
+        // the errors come from opening the directory rather than checking beforehand
+        //
+        struct fs_error error = {0};
+        struct fs_path  file  = fs_path_join(&test_dir, "new_file", NULL);
+        TEST_ASSERT(fs_iterdir(&file, NULL, &error) == NULL);
+        TEST_ASSERT(error.code == FS_CODE_NOT_DIRECTORY);
+
+        error                         = (struct fs_error){0};
+        struct fs_path does_not_exist = fs_path_join(&test_dir, "does_not_exist", NULL);
+        TEST_ASSERT(fs_iterdir(&does_not_exist, NULL, &error) == NULL);
+        TEST_ASSERT(error.code == FS_CODE_FILE_NOT_FOUND);
+    }
+
+    // fs_walk
+    //
+    {
+        // 4 directories with 2 files and 3 subdirectories each, the subdirectories have 5 files
+        //
+        struct fs_path root = fs_path_join(&test_dir, "walk", NULL);
+        fs_path_mkdir(&root, false, NULL);
+        char name[32];
+        for (int i = 0; i < 4; i++) {
+            snprintf(name, sizeof(name), "d%d", i);
+            struct fs_path directory = fs_path_join(&root, name, NULL);
+            fs_path_mkdir(&directory, false, NULL);
+            for (int j = 0; j < 2; j++) {
+                snprintf(name, sizeof(name), "f%d", j);
+                struct fs_path file = fs_path_join(&directory, name, NULL);
+                fs_path_write(&file, "x", 1, NULL);
+            }
+            for (int j = 0; j < 3; j++) {
+                snprintf(name, sizeof(name), "s%d", j);
+                struct fs_path subdirectory = fs_path_join(&directory, name, NULL);
+                fs_path_mkdir(&subdirectory, false, NULL);
+                for (int k = 0; k < 5; k++) {
+                    snprintf(name, sizeof(name), "f%d", k);
+                    struct fs_path file = fs_path_join(&subdirectory, name, NULL);
+                    fs_path_write(&file, "x", 1, NULL);
+                }
+            }
+        }
+
+        // everything is visited exactly once, directories are post visited
+        //
+        struct walk_test test = {0};
+        fs_walk(
+            &root,
+            walk_test_visit,
+            &test,
+            &(struct fs_walk_options){.thread_count = 4, .post_visit = walk_test_post_visit},
+            NULL
+        );
+        TEST_ASSERT(test.directories == 16);
+        TEST_ASSERT(test.files == 68);
+        TEST_ASSERT(test.post_visits == 16);
+        TEST_ASSERT(test.max_depth == 3);
+
+        // depth limit
+        //
+        test = (struct walk_test){0};
+        fs_walk(&root, walk_test_visit, &test, &(struct fs_walk_options){.max_depth = 1}, NULL);
+        TEST_ASSERT(test.directories == 4);
+        TEST_ASSERT(test.files == 0);
+
+        // pruning a directory skips everything inside it
+        //
+        test = (struct walk_test){.prune = "d0"};
+        fs_walk(&root, walk_test_visit, &test, NULL, NULL);
+        TEST_ASSERT(test.directories == 13);
+        TEST_ASSERT(test.files == 51);
+
+        // stopping early
+        //
+        test = (struct walk_test){.stop = true};
+        fs_walk(&root, walk_test_visit, &test, &(struct fs_walk_options){.thread_count = 1}, NULL);
+        TEST_ASSERT(test.files == 1);
+
+        // an error from the visitor is reported
+        //
+        test                  = (struct walk_test){.fail = true};
+        struct fs_error error = {0};
+        fs_walk(&root, walk_test_visit, &test, NULL, &error);
+        TEST_ASSERT(error.code == FS_CODE_UNSPECIFIED);
+
+        error                         = (struct fs_error){0};
+        struct fs_path does_not_exist = fs_path_join(&root, "does_not_exist", NULL);
+        fs_walk(&does_not_exist, walk_test_visit, &test, NULL, &error);
+        TEST_ASSERT(error.code == FS_CODE_FILE_NOT_FOUND);
+
+        // a forced rmdir is a parallel walk
+        //
+        fs_path_rmdir(&root, true, NULL);
+        TEST_ASSERT(!fs_path_exists(&root));
+    }
+
+    // instrumentation
+    //
+    {
+        struct fs_path directory = fs_path_join(&test_dir, "stats", NULL);
+        struct fs_path file      = fs_path_join(&directory, "file", NULL);
+
+        struct trace_test trace = {0};
+        fs_stats_reset();
+        fs_set_trace_callback(trace_test_callback, &trace);
+
+        fs_path_mkdir(&directory, false, NULL);
+        fs_path_write(&file, "hello", 5, NULL);
+        struct fs_content content = fs_path_read_binary(&file, NULL, NULL);
+        free(content.data);
+        struct fs_mapping mapping = fs_path_map(&file, 0, NULL);
+        fs_unmap(&mapping);
+        TEST_ASSERT(fs_path_is_file(&file));
+
+        // the thread pool's writes count towards the batch alone, as io_uring's do
+        //
+        struct fs_path          batch_file = fs_path_join(&directory, "batch", NULL);
+        struct fs_batch_request request    = {
+            .operation = FS_BATCH_WRITE,
+            .filepath  = batch_file.buffer,
+            .data      = "abc",
+            .size      = 3,
+        };
+        TEST_ASSERT(fs_batch_run(&request, 1, FS_BATCH_THREADS, NULL) == 0);
+
+        FilesystemDirectoryIterator iterator = fs_iterdir(&directory, NULL, NULL);
+        struct string_view          name;
+        while (fs_iterdir_next_name(iterator, &name, NULL))
+            ;
+        fs_iterdir_free(iterator);
+
+        fs_path_rmdir(&directory, true, NULL);
+        fs_set_trace_callback(NULL, NULL);
+
+        struct fs_stats stats = fs_stats();
+#ifdef FS_STATS
+        const struct fs_operation_stats* operations = stats.operations;
+        TEST_ASSERT(operations[FS_OPERATION_MKDIR].calls == 1);
+        TEST_ASSERT(operations[FS_OPERATION_WRITE].calls == 1);
+        TEST_ASSERT(operations[FS_OPERATION_WRITE].bytes == 5);
+        TEST_ASSERT(operations[FS_OPERATION_READ].calls == 1);
+        TEST_ASSERT(operations[FS_OPERATION_READ].bytes == 5);
+        TEST_ASSERT(operations[FS_OPERATION_MAP].bytes == 5);
+        TEST_ASSERT(operations[FS_OPERATION_ITERDIR].calls >= 1);
+        TEST_ASSERT(operations[FS_OPERATION_ITERDIR_NEXT].bytes >= 4);
+        TEST_ASSERT(operations[FS_OPERATION_STAT].calls >= 2);
+        TEST_ASSERT(operations[FS_OPERATION_REMOVE].calls == 1);
+        TEST_ASSERT(operations[FS_OPERATION_WALK].calls == 1);
+        TEST_ASSERT(operations[FS_OPERATION_BATCH].calls == 1);
+        TEST_ASSERT(operations[FS_OPERATION_BATCH].bytes == 3);
+        for (size_t i = 0; i < FS_OPERATION_COUNT; i++) {
+            TEST_ASSERT(trace.calls[i] == operations[i].calls);
+            TEST_ASSERT(trace.bytes[i] == operations[i].bytes);
+        }
+#else
+        for (size_t i = 0; i < FS_OPERATION_COUNT; i++) {
+            TEST_ASSERT(stats.operations[i].calls == 0);
+            TEST_ASSERT(trace.calls[i] == 0);
+        }
+#endif
+        TEST_ASSERT(strcmp(fs_operation_name(FS_OPERATION_ITERDIR_NEXT), "iterdir_next") == 0);
+    }
+
+    // stat cache
+    //
+    {
+        struct fs_path directory = fs_path_join(&test_dir, "stat_cache", NULL);
+        fs_path_mkdir(&directory, false, NULL);
+        struct fs_path file = fs_path_join(&directory, "file", NULL);
+
+        struct fs_stat stat = fs_path_stat(&directory, NULL);
+        TEST_ASSERT(stat.type == FS_ENTRY_DIRECTORY);
+        TEST_ASSERT(fs_path_stat(&file, NULL).type == FS_ENTRY_UNKNOWN);
+
+        // without a watcher results stay until they're invalidated, missing paths included
+        //
+        FilesystemStatCache cache = fs_stat_cache_create(0, NULL, NULL);
+        TEST_ASSERT(fs_stat_cache_is_dir(cache, &directory));
+        TEST_ASSERT(!fs_stat_cache_exists(cache, &file));
+        fs_path_write(&file, "12345", 5, NULL);
+        TEST_ASSERT(!fs_stat_cache_exists(cache, &file));
+        fs_stat_cache_invalidate(cache, &file);
+        TEST_ASSERT(fs_stat_cache_is_file(cache, &file));
+        TEST_ASSERT(fs_stat_cache_get(cache, &file, NULL).size == 5);
+
+        fs_path_rmfile(&file, NULL);
+        TEST_ASSERT(fs_stat_cache_is_file(cache, &file));
+        fs_stat_cache_invalidate_all(cache);
+        TEST_ASSERT(!fs_stat_cache_exists(cache, &file));
+        TEST_ASSERT(fs_stat_cache_is_dir(cache, &directory));
+
+        // enough paths to grow the table
+        //
+        for (int i = 0; i < 1000; i++) {
+            char name[32];
+            snprintf(name, sizeof name, "missing%d", i);
+            struct fs_path missing = fs_path_join(&directory, name, NULL);
+            TEST_ASSERT(!fs_stat_cache_exists(cache, &missing));
+        }
+        TEST_ASSERT(fs_stat_cache_is_dir(cache, &directory));
+        fs_stat_cache_destroy(cache);
+
+#ifdef __linux__
+        // with a watcher changes show up on their own, shortly after they happen
+        //
+        cache = fs_stat_cache_create(FS_STAT_CACHE_WATCH, NULL, NULL);
+        TEST_ASSERT(!fs_stat_cache_exists(cache, &file));
+        fs_path_write(&file, "12345", 5, NULL);
+        for (int i = 0; i < 1000 && !fs_stat_cache_exists(cache, &file); i++) {
+            thrd_sleep(&(struct timespec){.tv_nsec = 1000000}, NULL);
+        }
+        TEST_ASSERT(fs_stat_cache_is_file(cache, &file));
+
+        fs_path_rmfile(&file, NULL);
+        for (int i = 0; i < 1000 && fs_stat_cache_exists(cache, &file); i++) {
+            thrd_sleep(&(struct timespec){.tv_nsec = 1000000}, NULL);
+        }
+        TEST_ASSERT(!fs_stat_cache_exists(cache, &file));
+        fs_stat_cache_destroy(cache);
+#else
+        struct fs_error error = {0};
+        TEST_ASSERT(!fs_stat_cache_create(FS_STAT_CACHE_WATCH, NULL, &error));
+        TEST_ASSERT(error.code == FS_CODE_UNSPECIFIED);
+#endif
+
+        fs_path_rmdir(&directory, true, NULL);
+    }
+
+#ifndef _WIN32
+    // a forced rmdir removes symlinks without following them
+    //
+    {
+        struct fs_path target = fs_path_join(&test_dir, "symlink_target", NULL);
+        fs_path_mkdir(&target, false, NULL);
+        struct fs_path target_file = fs_path_join(&target, "keep", NULL);
+        fs_path_write(&target_file, "keep", 4, NULL);
+
+        struct fs_path directory = fs_path_join(&test_dir, "symlink_directory", NULL);
+        fs_path_mkdir(&directory, false, NULL);
+        struct fs_path link = fs_path_join(&directory, "link", NULL);
+        TEST_ASSERT(symlink(target.buffer, link.buffer) == 0);
+
+        FilesystemDirectoryIterator iterator = fs_iterdir(&directory, NULL, NULL);
+        struct fs_entry             entry;
+        TEST_ASSERT(fs_iterdir_next_entry(iterator, &entry, 0, NULL));
+        TEST_ASSERT(entry.type == FS_ENTRY_SYMLINK);
+        TEST_ASSERT(!fs_iterdir_next_entry(iterator, &entry, 0, NULL));
+        fs_iterdir_free(iterator);
+
+        struct fs_error error = {0};
+        fs_path_rmdir(&link, true, &error);
+        TEST_ASSERT(error.code == FS_CODE_NOT_DIRECTORY);
+
+        fs_path_rmdir(&directory, true, NULL);
+        TEST_ASSERT(!fs_path_exists(&directory));
+        TEST_ASSERT(fs_path_is_file(&target_file));
+        fs_path_rmdir(&target, true, NULL);
+    }
+#endif
+
     // rmdir
     //
     {
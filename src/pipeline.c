@@ -0,0 +1,504 @@
+#include "pipeline.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#define PIPELINE_FATAL_ERRORF(fmt, ...)                                                            \
+    do {                                                                                           \
+        fprintf(stderr, "[PIPELINE FATAL ERROR]: ");                                               \
+        fprintf(stderr, fmt, __VA_ARGS__);                                                         \
+        fprintf(stderr, "\n");                                                                     \
+        exit(EXIT_FAILURE);                                                                        \
+    } while (0)
+
+#define PIPELINE_SET_ERRORF(error, error_code, fmt, ...)                                           \
+    do {                                                                                           \
+        if (!(error)) {                                                                            \
+            PIPELINE_FATAL_ERRORF(fmt, __VA_ARGS__);                                               \
+        }                                                                                          \
+        (error)->code = (error_code);                                                              \
+        if (snprintf((error)->reason, sizeof(error)->reason, fmt, __VA_ARGS__) >=                  \
+            (int)sizeof(error)->reason) {                                                          \
+            memcpy((error)->reason + sizeof(error)->reason - 3, "..", 3);                          \
+        }                                                                                          \
+    } while (0)
+
+static void*
+pipeline_malloc(size_t size, PipelineAllocator* allocator)
+{
+    if (!allocator) {
+        return PIPELINE_DEFAULT_MALLOC(size);
+    }
+    return allocator_malloc(allocator, size);
+}
+
+static void*
+pipeline_realloc(void* ptr, size_t size, PipelineAllocator* allocator)
+{
+    if (!allocator) {
+        return PIPELINE_DEFAULT_REALLOC(ptr, size);
+    }
+    return allocator_realloc(allocator, ptr, size);
+}
+
+static void
+pipeline_free(void* ptr, PipelineAllocator* allocator)
+{
+    if (!ptr) {
+        return;
+    }
+    if (!allocator) {
+        PIPELINE_DEFAULT_FREE(ptr);
+        return;
+    }
+    allocator_free(allocator, ptr);
+}
+
+struct pipeline_file {
+    struct fs_path path;
+    uint64_t       size;
+};
+
+// The walk and the workers meet at a bounded queue of files. The first error is kept here and
+// `failed` tells every stage to wind down without taking the lock.
+//
+struct pipeline {
+    pipeline_callback       callback;
+    void*                   user_data;
+    struct pipeline_options options;
+    PipelineAllocator*      allocator;
+
+    mtx_t                 lock;
+    cnd_t                 not_empty;
+    cnd_t                 not_full;
+    struct pipeline_file* queue;  // PIPELINE_QUEUE_DEPTH slots
+    size_t                head;
+    size_t                count;
+    bool                  closed;
+    atomic_bool           failed;
+    struct pipeline_error error;
+};
+
+struct pipeline_worker {
+    struct pipeline*      pipeline;
+    size_t                index;
+    struct allocator      scratch;
+    struct string_view*   lines;  // reused for every batch, grown as needed
+    size_t                capacity;
+    struct pipeline_stats stats;
+};
+
+// A file ready to be split, mapped or read into the worker's scratch allocator.
+//
+struct pipeline_source {
+    struct string_view content;
+    struct fs_mapping  mapping;  // NULL data unless mapped
+};
+
+static bool
+pipeline_failed(struct pipeline* pipeline)
+{
+    return atomic_load_explicit(&pipeline->failed, memory_order_relaxed);
+}
+
+static void
+pipeline_fail(struct pipeline* pipeline, const struct pipeline_error* error)
+{
+    mtx_lock(&pipeline->lock);
+    if (!atomic_load_explicit(&pipeline->failed, memory_order_relaxed)) {
+        pipeline->error = *error;
+        atomic_store_explicit(&pipeline->failed, true, memory_order_relaxed);
+    }
+    cnd_broadcast(&pipeline->not_empty);
+    cnd_broadcast(&pipeline->not_full);
+    mtx_unlock(&pipeline->lock);
+}
+
+static void
+pipeline_failf(struct pipeline* pipeline, enum pipeline_error_code code, const char* fmt, ...)
+{
+    struct pipeline_error error = {.code = code};
+    va_list               args;
+    va_start(args, fmt);
+    if (vsnprintf(error.reason, sizeof error.reason, fmt, args) >= (int)sizeof error.reason) {
+        memcpy(error.reason + sizeof error.reason - 3, "..", 3);
+    }
+    va_end(args);
+    pipeline_fail(pipeline, &error);
+}
+
+static bool
+pipeline_push(struct pipeline* pipeline, const struct fs_path* path, uint64_t size)
+{
+    mtx_lock(&pipeline->lock);
+    while (pipeline->count == PIPELINE_QUEUE_DEPTH && !pipeline_failed(pipeline)) {
+        cnd_wait(&pipeline->not_full, &pipeline->lock);
+    }
+    const bool pushed = !pipeline_failed(pipeline);
+    if (pushed) {
+        const size_t slot     = (pipeline->head + pipeline->count++) % PIPELINE_QUEUE_DEPTH;
+        pipeline->queue[slot] = (struct pipeline_file){.path = *path, .size = size};
+        cnd_signal(&pipeline->not_empty);
+    }
+    mtx_unlock(&pipeline->lock);
+    return pushed;
+}
+
+// Waits for a file, false once the walk has finished and the queue is empty or the run failed.
+//
+static bool
+pipeline_pop(struct pipeline* pipeline, struct pipeline_file* file)
+{
+    mtx_lock(&pipeline->lock);
+    while (!pipeline->count && !pipeline->closed && !pipeline_failed(pipeline)) {
+        cnd_wait(&pipeline->not_empty, &pipeline->lock);
+    }
+    const bool popped = pipeline->count && !pipeline_failed(pipeline);
+    if (popped) {
+        *file          = pipeline->queue[pipeline->head];
+        pipeline->head = (pipeline->head + 1) % PIPELINE_QUEUE_DEPTH;
+        pipeline->count--;
+        cnd_signal(&pipeline->not_full);
+    }
+    mtx_unlock(&pipeline->lock);
+    return popped;
+}
+
+static void
+pipeline_close(struct pipeline* pipeline)
+{
+    mtx_lock(&pipeline->lock);
+    pipeline->closed = true;
+    cnd_broadcast(&pipeline->not_empty);
+    mtx_unlock(&pipeline->lock);
+}
+
+static enum fs_walk_action
+pipeline_visit(const struct fs_entry* entry, size_t depth, void* user_data, struct fs_error* error)
+{
+    (void)depth;
+    (void)error;
+    struct pipeline* pipeline = user_data;
+
+    if (pipeline_failed(pipeline)) {
+        return FS_WALK_STOP;
+    }
+    if (entry->type != FS_ENTRY_FILE) {
+        return FS_WALK_CONTINUE;
+    }
+    if (pipeline->options.filter && !pipeline->options.filter(entry, pipeline->user_data)) {
+        return FS_WALK_CONTINUE;
+    }
+    return (pipeline_push(pipeline, &entry->path, entry->size)) ? FS_WALK_CONTINUE : FS_WALK_STOP;
+}
+
+static bool
+pipeline_should_map(const struct pipeline* pipeline, const struct pipeline_file* file)
+{
+    return file->size >= pipeline->options.map_threshold;
+}
+
+static bool
+pipeline_open(
+    struct pipeline_worker* worker, const struct pipeline_file* file, struct pipeline_source* source
+)
+{
+    struct pipeline* pipeline = worker->pipeline;
+    struct fs_error  fs_error = {0};
+
+    *source = (struct pipeline_source){0};
+    if (pipeline_failed(pipeline)) {
+        return false;
+    }
+    if (pipeline_should_map(pipeline, file)) {
+        source->mapping = fs_path_map(&file->path, FS_MAP_SEQUENTIAL | FS_MAP_WILLNEED, &fs_error);
+        source->content = (struct string_view){
+            .length = source->mapping.size,
+            .data   = source->mapping.data,
+        };
+    }
+    else {
+        struct fs_content content = fs_path_read_binary(&file->path, &worker->scratch, &fs_error);
+        source->content = (struct string_view){.length = content.size, .data = content.data};
+    }
+
+    if (fs_error.code != FS_CODE_SUCCESS) {
+        pipeline_failf(
+            pipeline,
+            PIPELINE_CODE_READ_FAILED,
+            "failed to read %s: %s",
+            file->path.buffer,
+            fs_error.reason
+        );
+        return false;
+    }
+    return true;
+}
+
+static void
+pipeline_release(struct pipeline_source* source)
+{
+    fs_unmap(&source->mapping);
+    *source = (struct pipeline_source){0};
+}
+
+// Takes whole lines of up to `batch_size` bytes off the front of `rest`, along with the newline
+// after them. A line longer than `batch_size` is taken whole.
+//
+static struct string_view
+pipeline_take_batch(struct string_view* rest, size_t batch_size)
+{
+    struct string_view batch = *rest;
+    if (batch.length > batch_size) {
+        batch.length = batch_size;
+        if (!sv_rchop_by_delim(&batch, '\n').data) {
+            struct string_view after = {
+                .length = rest->length - batch_size,
+                .data   = rest->data + batch_size,
+            };
+            const struct string_view line_end = sv_lchop_by_delim(&after, '\n');
+            batch.length = (line_end.data) ? batch_size + line_end.length : rest->length;
+        }
+    }
+    else if (batch.data[batch.length - 1] == '\n') {
+        batch.length--;
+    }
+    sv_ldiscard(rest, batch.length + (batch.length < rest->length));
+    return batch;
+}
+
+static void
+pipeline_process(
+    struct pipeline_worker* worker, const struct pipeline_file* file, struct string_view content
+)
+{
+    struct pipeline* pipeline = worker->pipeline;
+
+    // a small file was read into the scratch allocator, everything after it is the callback's
+    //
+    const struct allocator_mark mark = allocator_mark(&worker->scratch);
+    struct string_view          rest = content;
+    size_t                      line = 0;
+    while (rest.length && !pipeline_failed(pipeline)) {
+        const struct string_view text = pipeline_take_batch(&rest, pipeline->options.batch_size);
+
+        size_t count = sv_split_into(text, SV_LITERAL("\n"), worker->lines, worker->capacity);
+        if (count > worker->capacity) {
+            const size_t capacity = (count > worker->capacity * 2) ? count : worker->capacity * 2;
+            struct string_view* lines =
+                pipeline_realloc(worker->lines, capacity * sizeof *lines, pipeline->allocator);
+            if (!lines) {
+                pipeline_failf(
+                    pipeline,
+                    PIPELINE_CODE_OUT_OF_MEMORY,
+                    "failed to allocate %zu lines for %s",
+                    count,
+                    file->path.buffer
+                );
+                return;
+            }
+            worker->lines    = lines;
+            worker->capacity = capacity;
+            sv_split_into(text, SV_LITERAL("\n"), worker->lines, worker->capacity);
+        }
+
+        const struct pipeline_batch batch = {
+            .path       = &file->path,
+            .first_line = line,
+            .line_count = count,
+            .lines      = worker->lines,
+            .scratch    = &worker->scratch,
+            .worker     = worker->index,
+        };
+        struct pipeline_error error = {0};
+        pipeline->callback(&batch, pipeline->user_data, &error);
+        allocator_rewind(&worker->scratch, mark);
+
+        worker->stats.batches++;
+        worker->stats.lines += count;
+        line += count;
+        if (error.code != PIPELINE_CODE_SUCCESS) {
+            pipeline_fail(pipeline, &error);
+            return;
+        }
+    }
+}
+
+static int
+pipeline_worker_main(void* arg)
+{
+    struct pipeline_worker* worker   = arg;
+    struct pipeline*        pipeline = worker->pipeline;
+
+    // two files in flight, the one being processed and the next which is mapped ahead of time
+    // when it's large enough. Small files are only read once they're current since they go in
+    // the scratch allocator, which is reset between files.
+    //
+    struct pipeline_file   files[2];
+    struct pipeline_source sources[2] = {0};
+    bool                   opened[2]  = {false, false};
+    size_t                 current    = 0;
+    bool                   has_file   = pipeline_pop(pipeline, &files[current]);
+    while (has_file) {
+        const size_t next     = current ^ 1;
+        const bool   has_next = pipeline_pop(pipeline, &files[next]);
+        if (has_next && pipeline_should_map(pipeline, &files[next])) {
+            opened[next] = pipeline_open(worker, &files[next], &sources[next]);
+        }
+
+        if (!opened[current]) {
+            opened[current] = pipeline_open(worker, &files[current], &sources[current]);
+        }
+        if (opened[current]) {
+            worker->stats.files++;
+            worker->stats.mapped_files += sources[current].mapping.data != NULL;
+            worker->stats.bytes += sources[current].content.length;
+            pipeline_process(worker, &files[current], sources[current].content);
+        }
+        pipeline_release(&sources[current]);
+        opened[current] = false;
+        allocator_reset(&worker->scratch);
+
+        current  = next;
+        has_file = has_next;
+    }
+    return 0;
+}
+
+struct pipeline_stats
+pipeline_run(
+    const struct fs_path*          root,
+    pipeline_callback              callback,
+    void*                          user_data,
+    const struct pipeline_options* options,
+    PipelineAllocator*             allocator,
+    struct pipeline_error*         error
+)
+{
+    PIPELINE_ASSERT(root);
+    PIPELINE_ASSERT(callback);
+
+    struct pipeline pipeline = {
+        .callback  = callback,
+        .user_data = user_data,
+        .options   = (options) ? *options : (struct pipeline_options){0},
+        .allocator = allocator,
+    };
+    if (!pipeline.options.thread_count) {
+        pipeline.options.thread_count = PIPELINE_DEFAULT_THREAD_COUNT;
+    }
+    if (!pipeline.options.batch_size) {
+        pipeline.options.batch_size = PIPELINE_DEFAULT_BATCH_SIZE;
+    }
+    if (!pipeline.options.map_threshold) {
+        pipeline.options.map_threshold = PIPELINE_DEFAULT_MAP_THRESHOLD;
+    }
+    const size_t thread_count = pipeline.options.thread_count;
+
+    struct pipeline_stats stats = {0};
+    pipeline.queue = pipeline_malloc(PIPELINE_QUEUE_DEPTH * sizeof *pipeline.queue, allocator);
+    struct pipeline_worker* workers = pipeline_malloc(thread_count * sizeof *workers, allocator);
+    thrd_t*                 threads = pipeline_malloc(thread_count * sizeof *threads, allocator);
+    if (!pipeline.queue || !workers || !threads) {
+        pipeline_free(pipeline.queue, allocator);
+        pipeline_free(workers, allocator);
+        pipeline_free(threads, allocator);
+        PIPELINE_SET_ERRORF(
+            error, PIPELINE_CODE_OUT_OF_MEMORY, "failed to start pipeline: %s", root->buffer
+        );
+        return stats;
+    }
+
+    mtx_init(&pipeline.lock, mtx_plain);
+    cnd_init(&pipeline.not_empty);
+    cnd_init(&pipeline.not_full);
+    atomic_init(&pipeline.failed, false);
+
+    // small files are read into the scratch allocator, so a page always has room for one and
+    // the callback's allocations besides
+    //
+    for (size_t i = 0; i < thread_count; i++) {
+        workers[i] = (struct pipeline_worker){.pipeline = &pipeline, .index = i};
+        SCRATCH_ALLOCATOR(
+            workers[i].scratch, PIPELINE_SCRATCH_PAGE_SIZE + pipeline.options.map_threshold
+        );
+    }
+
+    size_t started = 0;
+    for (; started < thread_count; started++) {
+        const int result = thrd_create(&threads[started], pipeline_worker_main, &workers[started]);
+        if (result != thrd_success) {
+            break;
+        }
+    }
+
+    // the calling thread is the walk stage, filling the queue while the workers drain it
+    //
+    if (!started) {
+        pipeline_failf(
+            &pipeline, PIPELINE_CODE_THREAD_FAILED, "failed to start workers: %s", root->buffer
+        );
+    }
+    else {
+        struct fs_error      fs_error = {0};
+        const struct fs_stat stat     = fs_path_stat(root, &fs_error);
+        if (fs_error.code == FS_CODE_SUCCESS && stat.type == FS_ENTRY_FILE) {
+            pipeline_push(&pipeline, root, stat.size);
+        }
+        else if (fs_error.code == FS_CODE_SUCCESS && stat.type == FS_ENTRY_DIRECTORY) {
+            const struct fs_walk_options walk_options = {
+                .thread_count = pipeline.options.walk_thread_count,
+                .max_depth    = pipeline.options.max_depth,
+                .entry_flags  = FS_ENTRY_STAT,
+            };
+            fs_walk(root, pipeline_visit, &pipeline, &walk_options, &fs_error);
+        }
+        else if (fs_error.code == FS_CODE_SUCCESS) {
+            pipeline_failf(
+                &pipeline,
+                PIPELINE_CODE_WALK_FAILED,
+                "failed to walk %s: not a file or directory",
+                root->buffer
+            );
+        }
+        if (fs_error.code != FS_CODE_SUCCESS) {
+            pipeline_failf(
+                &pipeline,
+                PIPELINE_CODE_WALK_FAILED,
+                "failed to walk %s: %s",
+                root->buffer,
+                fs_error.reason
+            );
+        }
+    }
+    pipeline_close(&pipeline);
+
+    for (size_t i = 0; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        stats.files += workers[i].stats.files;
+        stats.mapped_files += workers[i].stats.mapped_files;
+        stats.bytes += workers[i].stats.bytes;
+        stats.lines += workers[i].stats.lines;
+        stats.batches += workers[i].stats.batches;
+        pipeline_free(workers[i].lines, allocator);
+        allocator_destroy(&workers[i].scratch);
+    }
+
+    cnd_destroy(&pipeline.not_full);
+    cnd_destroy(&pipeline.not_empty);
+    mtx_destroy(&pipeline.lock);
+    pipeline_free(threads, allocator);
+    pipeline_free(workers, allocator);
+    pipeline_free(pipeline.queue, allocator);
+
+    if (pipeline_failed(&pipeline)) {
+        PIPELINE_SET_ERRORF(error, pipeline.error.code, "%s", pipeline.error.reason);
+    }
+    return stats;
+}
@@ -0,0 +1,379 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "filesystem.h"
+#include "string_view.h"
+
+#ifndef PIPELINE_ASSERT
+#include <assert.h>
+#define PIPELINE_ASSERT assert
+#endif
+
+#ifndef PIPELINE_DEFAULT_MALLOC
+#include <stdlib.h>
+#define PIPELINE_DEFAULT_MALLOC malloc
+#endif
+
+#ifndef PIPELINE_DEFAULT_REALLOC
+#include <stdlib.h>
+#define PIPELINE_DEFAULT_REALLOC realloc
+#endif
+
+#ifndef PIPELINE_DEFAULT_FREE
+#include <stdlib.h>
+#define PIPELINE_DEFAULT_FREE free
+#endif
+
+#ifndef PIPELINE_DEFAULT_THREAD_COUNT
+#define PIPELINE_DEFAULT_THREAD_COUNT 8
+#endif
+
+#ifndef PIPELINE_DEFAULT_BATCH_SIZE
+#define PIPELINE_DEFAULT_BATCH_SIZE (1024 * 1024)
+#endif
+
+#ifndef PIPELINE_DEFAULT_MAP_THRESHOLD
+#define PIPELINE_DEFAULT_MAP_THRESHOLD (64 * 1024)
+#endif
+
+// files found by the walk but not yet taken by a worker, the walk waits when it's full
+//
+#ifndef PIPELINE_QUEUE_DEPTH
+#define PIPELINE_QUEUE_DEPTH 256
+#endif
+
+#ifndef PIPELINE_SCRATCH_PAGE_SIZE
+#define PIPELINE_SCRATCH_PAGE_SIZE (256 * 1024)
+#endif
+
+enum pipeline_error_code {
+    PIPELINE_CODE_SUCCESS = 0,
+    PIPELINE_CODE_OUT_OF_MEMORY,
+    PIPELINE_CODE_THREAD_FAILED,
+    PIPELINE_CODE_WALK_FAILED,
+    PIPELINE_CODE_READ_FAILED,
+    PIPELINE_CODE_CALLBACK_FAILED,  // for callbacks, though any code a callback sets stops the run
+};
+
+struct pipeline_error {
+    enum pipeline_error_code code;
+    char                     reason[256];
+};
+
+// NULL uses PIPELINE_DEFAULT_MALLOC/REALLOC/FREE. Workers allocate from it at the same time, so
+// anything else has to be thread safe, a CONCURRENT_ARENA for example.
+//
+typedef struct allocator PipelineAllocator;
+
+// Consecutive lines of one file, split on '\n' (which isn't part of a line) and pointing into
+// the file's content, which is only valid until the callback returns. `scratch` is the
+// worker's own allocator for anything the callback needs for the batch, it's released in one
+// go after the callback returns.
+//
+struct pipeline_batch {
+    const struct fs_path*     path;
+    size_t                    first_line;  // of the file, counted from 0
+    size_t                    line_count;
+    const struct string_view* lines;
+    PipelineAllocator*        scratch;
+    size_t                    worker;  // from 0 to thread_count - 1, for per thread state
+};
+
+// Called from several worker threads at once, the batches of one file are handed to the same
+// worker in order. Setting the error stops the run and reports it.
+//
+typedef void (*pipeline_callback)(
+    const struct pipeline_batch*, void* user_data, struct pipeline_error* error
+);
+
+// Returning false leaves the file out, called from the walk's threads.
+//
+typedef bool (*pipeline_filter)(const struct fs_entry*, void* user_data);
+
+struct pipeline_options {
+    size_t          thread_count;       // workers, 0 uses PIPELINE_DEFAULT_THREAD_COUNT
+    size_t          walk_thread_count;  // passed on to `fs_walk`
+    size_t          max_depth;          // passed on to `fs_walk`
+    size_t          batch_size;     // bytes of lines per batch, 0 uses PIPELINE_DEFAULT_BATCH_SIZE
+    size_t          map_threshold;  // smaller files are read, 0 uses PIPELINE_DEFAULT_MAP_THRESHOLD
+    pipeline_filter filter;         // NULL takes every file
+};
+
+struct pipeline_stats {
+    uint64_t files;
+    uint64_t mapped_files;
+    uint64_t bytes;
+    uint64_t lines;
+    uint64_t batches;
+};
+
+// Feeds every line of every file under `root` (or of `root` itself when it's a file) to
+// `callback` in batches. Stages overlap rather than running one after the other: the calling
+// thread walks the tree with `fs_walk` and queues the files it finds, while the workers take
+// files off the queue and split them into batches with `sv_split_into`. Files of at least
+// `map_threshold` bytes are mapped and the rest are read into the worker's scratch allocator.
+// A worker takes its next file before processing the current one, so a mapped file is already
+// being read in (FS_MAP_WILLNEED) while the callbacks for the one before are running.
+//
+// A batch is at most `batch_size` bytes of whole lines, only a line longer than that gets a
+// batch of its own above the limit. Symlinks aren't followed, as with `fs_walk`.
+//
+struct pipeline_stats pipeline_run(
+    const struct fs_path*          root,
+    pipeline_callback              callback,
+    void*                          user_data,
+    const struct pipeline_options* options,
+    PipelineAllocator*             allocator,
+    struct pipeline_error*         error
+);
+
+#ifdef PIPELINE_TEST_MAIN
+
+#ifndef TEST_ASSERT
+#include <assert.h>
+#define TEST_ASSERT assert
+#endif  // TEST_ASSERT
+
+#include <stdio.h>
+#include <string.h>
+
+// Every line starts with its own line number so a batch can be checked against where it says
+// it starts. Counters are kept per worker, so the callback needs no locking.
+//
+struct test_pipeline {
+    size_t   stop_at_line;  // 0 never stops
+    uint64_t lines[PIPELINE_DEFAULT_THREAD_COUNT];
+    uint64_t line_bytes[PIPELINE_DEFAULT_THREAD_COUNT];
+};
+
+static void
+test_pipeline_callback(
+    const struct pipeline_batch* batch, void* user_data, struct pipeline_error* error
+)
+{
+    struct test_pipeline* test = user_data;
+    TEST_ASSERT(batch->worker < PIPELINE_DEFAULT_THREAD_COUNT);
+    TEST_ASSERT(batch->line_count > 0);
+
+    // scratch memory only lasts for the batch
+    //
+    uint64_t* numbers = allocator_malloc(batch->scratch, batch->line_count * sizeof *numbers);
+    TEST_ASSERT(numbers);
+    for (size_t i = 0; i < batch->line_count; i++) {
+        struct string_view line = batch->lines[i];
+        TEST_ASSERT(sv_parse_u64(&line, &numbers[i], NULL) > 0);
+        TEST_ASSERT(numbers[i] == batch->first_line + i);
+        test->lines[batch->worker]++;
+        test->line_bytes[batch->worker] += batch->lines[i].length;
+    }
+
+    const size_t last_line = batch->first_line + batch->line_count - 1;
+    if (test->stop_at_line && batch->first_line <= test->stop_at_line &&
+        test->stop_at_line <= last_line) {
+        error->code = PIPELINE_CODE_CALLBACK_FAILED;
+        snprintf(error->reason, sizeof error->reason, "stopped at line %zu", test->stop_at_line);
+    }
+}
+
+static bool
+test_pipeline_filter(const struct fs_entry* entry, void* user_data)
+{
+    (void)user_data;
+    size_t      length;
+    const char* ext = fs_path_ext(&entry->path, &length);
+    return length != 4 || memcmp(ext, "skip", 4) != 0;
+}
+
+// writes `line_count` numbered lines padded out to various lengths, returns the file's size
+//
+static size_t
+test_pipeline_write(
+    const struct fs_path* path, size_t line_count, size_t padding, bool trailing_newline
+)
+{
+    struct sv_builder builder = {0};
+    for (size_t i = 0; i < line_count; i++) {
+        sv_builder_append_u64(&builder, i, NULL);
+        for (size_t j = 0; j < (i * 7 + padding) % (padding + 1); j++) {
+            sv_builder_append_char(&builder, 'x', NULL);
+        }
+        if (i + 1 < line_count || trailing_newline) {
+            sv_builder_append_char(&builder, '\n', NULL);
+        }
+    }
+    const size_t size = builder.length;
+    fs_path_write(path, builder.data, size, NULL);
+    sv_builder_free(&builder);
+    return size;
+}
+
+int
+main(void)
+{
+    struct fs_path directory = fs_path_resolve("build/test_pipeline_directory", NULL);
+    if (fs_path_exists(&directory)) {
+        fs_path_rmdir(&directory, true, NULL);
+    }
+    fs_path_mkdir(&directory, true, NULL);
+    struct fs_path nested = fs_path_join(&directory, "nested/deeper", NULL);
+    fs_path_mkdir(&nested, true, NULL);
+
+    // small files which are read, one big enough to be mapped, a line longer than a batch,
+    // an empty file and one the filter leaves out
+    //
+    size_t file_count  = 0;
+    size_t total_lines = 0;
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < 24; i++) {
+        char name[32];
+        snprintf(name, sizeof name, "file%zu.txt", i);
+        struct fs_path path = fs_path_join((i % 3) ? &directory : &nested, name, NULL);
+        total_bytes += test_pipeline_write(&path, 1 + i * 13, i, i % 2);
+        total_lines += 1 + i * 13;
+        file_count++;
+    }
+    struct fs_path big = fs_path_join(&directory, "big.txt", NULL);
+    total_bytes += test_pipeline_write(&big, 20000, 30, true);
+    total_lines += 20000;
+    file_count++;
+
+    struct fs_path long_line = fs_path_join(&nested, "long.txt", NULL);
+    total_bytes += test_pipeline_write(&long_line, 3, 3000, false);
+    total_lines += 3;
+    file_count++;
+
+    struct fs_path empty = fs_path_join(&directory, "empty.txt", NULL);
+    fs_write_file(empty.buffer, "", 0, NULL);
+    file_count++;
+
+    struct fs_path skipped = fs_path_join(&nested, "bad.skip", NULL);
+    fs_write_file(skipped.buffer, "not a number\n", 13, NULL);
+
+    const struct pipeline_options options = {
+        .thread_count      = 4,
+        .walk_thread_count = 2,
+        .batch_size        = 512,
+        .map_threshold     = 4096,
+        .filter            = test_pipeline_filter,
+    };
+
+    // every line of every file once, in order within each file
+    //
+    {
+        struct test_pipeline  test  = {0};
+        struct pipeline_error error = {0};
+        struct pipeline_stats stats =
+            pipeline_run(&directory, test_pipeline_callback, &test, &options, NULL, &error);
+        TEST_ASSERT(error.code == PIPELINE_CODE_SUCCESS);
+        TEST_ASSERT(stats.files == file_count);
+        TEST_ASSERT(stats.mapped_files >= 2);
+        TEST_ASSERT(stats.bytes == total_bytes);
+        TEST_ASSERT(stats.lines == total_lines);
+        TEST_ASSERT(stats.batches > stats.files);
+
+        uint64_t lines      = 0;
+        uint64_t line_bytes = 0;
+        for (size_t i = 0; i < options.thread_count; i++) {
+            lines += test.lines[i];
+            line_bytes += test.line_bytes[i];
+        }
+        TEST_ASSERT(lines == total_lines);
+        TEST_ASSERT(line_bytes < total_bytes && line_bytes > total_bytes - total_lines);
+    }
+
+    // an error from the callback stops the run
+    //
+    {
+        struct test_pipeline  test  = {.stop_at_line = 10000};
+        struct pipeline_error error = {0};
+        struct pipeline_stats stats =
+            pipeline_run(&directory, test_pipeline_callback, &test, &options, NULL, &error);
+        TEST_ASSERT(error.code == PIPELINE_CODE_CALLBACK_FAILED);
+        TEST_ASSERT(strcmp(error.reason, "stopped at line 10000") == 0);
+        TEST_ASSERT(stats.lines < total_lines);
+    }
+
+    // a file as the root, with the default options
+    //
+    {
+        struct test_pipeline  test  = {0};
+        struct pipeline_error error = {0};
+        struct pipeline_stats stats =
+            pipeline_run(&big, test_pipeline_callback, &test, NULL, NULL, &error);
+        TEST_ASSERT(error.code == PIPELINE_CODE_SUCCESS);
+        TEST_ASSERT(stats.files == 1 && stats.lines == 20000 && stats.batches == 1);
+    }
+
+    // a root which doesn't exist
+    //
+    {
+        struct fs_path        missing = fs_path_join(&directory, "missing", NULL);
+        struct pipeline_error error   = {0};
+        pipeline_run(&missing, test_pipeline_callback, NULL, &options, NULL, &error);
+        TEST_ASSERT(error.code == PIPELINE_CODE_WALK_FAILED);
+        TEST_ASSERT(strstr(error.reason, "missing"));
+    }
+
+    fs_path_rmdir(&directory, true, NULL);
+    printf("%s tests passed\n", __FILE__);
+    return 0;
+}
+
+#endif  // PIPELINE_TEST_MAIN
+
+#endif  // PIPELINE_H
+
+
+/*
+==============================================================================
+OPTION 1 (MIT)
+==============================================================================
+
+Copyright (c) 2023, Jeffrey Pepin.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+
+==============================================================================
+OPTION 2 (Public Domain)
+==============================================================================
+
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
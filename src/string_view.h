@@ -3,13 +3,58 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "allocator.h"
+
+#ifndef SV_ASSERT
+#include <assert.h>
+#define SV_ASSERT assert
+#endif
+
+#ifndef SV_DEFAULT_MALLOC
+#include <stdlib.h>
+#define SV_DEFAULT_MALLOC malloc
+#endif
+
+#ifndef SV_DEFAULT_REALLOC
+#include <stdlib.h>
+#define SV_DEFAULT_REALLOC realloc
+#endif
+
+#ifndef SV_DEFAULT_FREE
+#include <stdlib.h>
+#define SV_DEFAULT_FREE free
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SV_PRINTF_FORMAT(fmt_index, args_index)                                                    \
+    __attribute__((format(printf, fmt_index, args_index)))
+#else
+#define SV_PRINTF_FORMAT(fmt_index, args_index)
+#endif
+
+typedef struct allocator StringViewAllocator;
+
 struct string_view {
     size_t      length;
     const char* data;
 };
 
+enum sv_error_code {
+    SV_CODE_SUCCESS = 0,
+    SV_CODE_OUT_OF_MEMORY,
+    SV_CODE_INVALID_NUMBER,
+    SV_CODE_OUT_OF_RANGE,
+    SV_CODE_INVALID_FORMAT,
+};
+
+struct sv_error {
+    enum sv_error_code code;
+    char               reason[128];
+};
+
 int  sv_compare(struct string_view, struct string_view);
 bool sv_equal(struct string_view, struct string_view);
 
@@ -43,6 +88,133 @@ bool sv_contains_cstr(struct string_view str, const char* other);
 
 char sv_char_at(struct string_view, int index);
 
+// Parse a number from the start of the view and discard it, returning how many bytes it took.
+// Nothing is consumed on error. Integers are an optional sign and decimal digits, floats also
+// take a fraction, an exponent, "inf", "infinity" and "nan"; the decimal point is always '.'
+// whatever the locale. Leading whitespace is not skipped.
+//
+size_t sv_parse_i64(struct string_view*, int64_t* value, struct sv_error*);
+size_t sv_parse_u64(struct string_view*, uint64_t* value, struct sv_error*);
+size_t sv_parse_f64(struct string_view*, double* value, struct sv_error*);
+
+// Splits a whole buffer in one pass on any of the `delimiters` characters, as a loop of
+// `sv_lchop_by_delim` would but without stopping at each field. Every delimiter ends a field,
+// so n delimiters give n + 1 fields, some of which may be empty. The byte after a field (when
+// it isn't the last) is the delimiter that ended it, which tells records from fields when
+// splitting on both "\t" and "\n" for example.
+//
+// `sv_split_into` writes up to `capacity` fields and returns how many there are in total,
+// `sv_split` allocates an array of exactly the right size.
+//
+size_t sv_split_into(
+    struct string_view  str,
+    struct string_view  delimiters,
+    struct string_view* fields,
+    size_t              capacity
+);
+struct string_view* sv_split(
+    struct string_view   str,
+    struct string_view   delimiters,
+    size_t*              count,
+    StringViewAllocator* allocator,
+    struct sv_error*     error
+);
+
+// A set of patterns compiled into one automaton (Aho-Corasick) so that a haystack is searched
+// for all of them in a single pass, the cost doesn't depend on how many patterns there are.
+// Empty patterns never match. A needle set is read only once created and can be shared
+// between threads.
+//
+typedef struct sv_needle_set* StringViewNeedleSet;
+
+struct sv_match {
+    size_t pattern;  // index into the patterns the set was created from
+    size_t offset;   // of the first byte of the match in the haystack
+};
+
+// Return false to stop the scan.
+//
+typedef bool (*sv_match_callback)(struct sv_match, void* user_data);
+
+StringViewNeedleSet sv_needle_set_create(
+    const struct string_view* patterns, size_t count, StringViewAllocator*, struct sv_error*
+);
+void sv_needle_set_free(StringViewNeedleSet);
+
+// true as soon as any pattern matches
+//
+bool sv_needle_set_matches(StringViewNeedleSet, struct string_view haystack);
+
+// Reports every match, including overlapping ones, in the order they end. Matches which end at
+// the same byte are reported longest first. Returns how many were reported.
+//
+size_t sv_needle_set_scan(
+    StringViewNeedleSet, struct string_view haystack, sv_match_callback, void* user_data
+);
+
+// A view with its hash computed once, unequal hashes or lengths reject a comparison without
+// reading the strings.
+//
+struct sv_hashed {
+    struct string_view view;
+    uint64_t           hash;
+};
+
+uint64_t         sv_hash(struct string_view);
+struct sv_hashed sv_hash_view(struct string_view);
+bool             sv_hashed_equal(struct sv_hashed, struct sv_hashed);
+
+// Interning stores one copy of each distinct string and hands out the same entry for it every
+// time, so interned strings are equal exactly when their entries are the same pointer. Entries
+// and their (null terminated) strings live in an arena owned by the table and stay valid
+// until the table is freed, however much it grows. A table isn't safe to modify from several
+// threads at once.
+//
+typedef struct sv_intern_table* StringViewInternTable;
+
+StringViewInternTable sv_intern_table_create(StringViewAllocator*, struct sv_error*);
+void                  sv_intern_table_free(StringViewInternTable);
+size_t                sv_intern_table_count(StringViewInternTable);
+
+const struct sv_hashed* sv_intern(StringViewInternTable, struct string_view, struct sv_error*);
+const struct sv_hashed* sv_intern_hashed(StringViewInternTable, struct sv_hashed, struct sv_error*);
+
+// NULL when the string hasn't been interned
+//
+const struct sv_hashed* sv_intern_lookup(StringViewInternTable, struct sv_hashed);
+
+// A growable string, zero initialize it with an allocator (or NULL for the default) and
+// append to it. Capacity at least doubles each time it runs out, built in an arena the
+// allocation is usually extended in place. The content is always null terminated and
+// `sv_builder_view` returns it without copying, the view is valid until the next append.
+//
+struct sv_builder {
+    StringViewAllocator* allocator;
+    char*                data;
+    size_t               length;
+    size_t               capacity;  // not counting the null terminator
+};
+
+bool sv_builder_reserve(struct sv_builder*, size_t additional, struct sv_error*);
+bool sv_builder_append(struct sv_builder*, struct string_view, struct sv_error*);
+bool sv_builder_append_char(struct sv_builder*, char, struct sv_error*);
+
+// the error comes before the format here, the format arguments have to be last
+//
+bool sv_builder_appendf(struct sv_builder*, struct sv_error*, const char* fmt, ...)
+    SV_PRINTF_FORMAT(3, 4);
+
+// Decimal formatting without printf. Floats are written with the fewest digits that
+// `sv_parse_f64` reads back as the same value, "0.1" rather than "0.10000000000000001".
+//
+bool sv_builder_append_i64(struct sv_builder*, int64_t, struct sv_error*);
+bool sv_builder_append_u64(struct sv_builder*, uint64_t, struct sv_error*);
+bool sv_builder_append_f64(struct sv_builder*, double, struct sv_error*);
+
+struct string_view sv_builder_view(const struct sv_builder*);
+void               sv_builder_clear(struct sv_builder*);
+void               sv_builder_free(struct sv_builder*);
+
 #define SV_LITERAL(literal)                                                                        \
     (struct string_view)                                                                           \
     {                                                                                              \
@@ -67,9 +239,30 @@ char sv_char_at(struct string_view, int index);
 #ifdef STRING_VIEW_TEST_MAIN
 
 #include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #define TEST_ASSERT assert
 
+struct match_test {
+    struct sv_match matches[16];
+    size_t          count;
+    size_t          stop_after;  // 0 never stops
+};
+
+static bool
+match_test_collect(struct sv_match match, void* user_data)
+{
+    struct match_test* test = user_data;
+    if (test->count < sizeof test->matches / sizeof *test->matches) {
+        test->matches[test->count] = match;
+    }
+    test->count++;
+    return test->count != test->stop_after;
+}
+
 int
 main(void)
 {
@@ -575,6 +768,714 @@ main(void)
     TEST_ASSERT(!sv_contains_cstr(SV_LITERAL(""), "abcdefghi"));
     TEST_ASSERT(!sv_contains_cstr(SV_LITERAL(""), ""));
 
+    // the vector kernels agree with plain loops at every length and alignment
+    //
+    {
+        char     buffer[300];
+        uint64_t random_state = 0x9E3779B97F4A7C15ull;
+        for (size_t iteration = 0; iteration < 20000; iteration++) {
+            random_state ^= random_state >> 12;
+            random_state ^= random_state << 25;
+            random_state ^= random_state >> 27;
+            const uint64_t random = random_state * 0x2545F4914F6CDD1Dull;
+
+            // few distinct characters so that partial matches are common
+            //
+            const size_t length = random % 200;
+            const size_t offset = (random >> 8) % 32;
+            for (size_t i = 0; i < length; i++) {
+                buffer[offset + i] = " \tab\n"[(random >> (i % 48)) % 5];
+            }
+            const struct string_view str = {.length = length, .data = buffer + offset};
+
+            const size_t       needle_length = 1 + (random >> 16) % 6;
+            struct string_view needle        = {.length = needle_length, .data = "ab aab\tba"};
+            needle.data += (random >> 24) % 4;
+            bool expected = false;
+            for (size_t i = 0; !expected && i + needle.length <= str.length; i++) {
+                expected = memcmp(str.data + i, needle.data, needle.length) == 0;
+            }
+            TEST_ASSERT(sv_contains(str, needle) == expected);
+
+            size_t last = str.length;
+            for (size_t i = str.length; i > 0 && last == str.length; i--) {
+                if (str.data[i - 1] == 'b') last = i - 1;
+            }
+            struct string_view chopped = str;
+            struct string_view right   = sv_rchop_by_delim(&chopped, 'b');
+            if (last == str.length) {
+                TEST_ASSERT(chopped.length == str.length && right.length == 0);
+            }
+            else {
+                TEST_ASSERT(chopped.length == last);
+                TEST_ASSERT(right.data == str.data + last + 1);
+            }
+
+            size_t leading = 0;
+            while (leading < str.length && isspace((unsigned char)str.data[leading])) {
+                leading++;
+            }
+            size_t trailing = 0;
+            while (trailing < str.length - leading &&
+                   isspace((unsigned char)str.data[str.length - 1 - trailing])) {
+                trailing++;
+            }
+            struct string_view stripped = str;
+            sv_strip(&stripped);
+            TEST_ASSERT(stripped.length == str.length - leading - trailing);
+            TEST_ASSERT(stripped.length == 0 || stripped.data == str.data + leading);
+        }
+    }
+
+    // long runs of whitespace
+    //
+    {
+        char buffer[256];
+        for (size_t padding = 0; padding < 120; padding++) {
+            for (size_t i = 0; i < padding; i++) {
+                buffer[i]               = " \t\n\v\f\r"[i % 6];
+                buffer[padding + 1 + i] = " \t\n\v\f\r"[(i + 3) % 6];
+            }
+            buffer[padding] = 'x';
+
+            struct string_view view = {.length = 2 * padding + 1, .data = buffer};
+            sv_strip(&view);
+            TEST_ASSERT(sv_equal(view, SV_LITERAL("x")));
+
+            struct string_view spaces = {.length = padding, .data = buffer};
+            sv_lstrip(&spaces);
+            TEST_ASSERT(spaces.length == 0);
+            spaces = (struct string_view){.length = padding, .data = buffer};
+            sv_rstrip(&spaces);
+            TEST_ASSERT(spaces.length == 0);
+        }
+    }
+
+    // a delimiter in the first position is found
+    //
+    {
+        struct string_view view  = SV_LITERAL(",hello");
+        struct string_view right = sv_rchop_by_delim(&view, ',');
+        TEST_ASSERT(sv_equal(right, SV_LITERAL("hello")));
+        TEST_ASSERT(view.length == 0);
+    }
+
+    // splitting
+    //
+    {
+        struct string_view fields[8];
+        TEST_ASSERT(sv_split_into(SV_LITERAL("a,b,,c"), SV_LITERAL(","), fields, 8) == 4);
+        TEST_ASSERT(sv_equal(fields[0], SV_LITERAL("a")));
+        TEST_ASSERT(sv_equal(fields[1], SV_LITERAL("b")));
+        TEST_ASSERT(sv_equal(fields[2], SV_LITERAL("")));
+        TEST_ASSERT(sv_equal(fields[3], SV_LITERAL("c")));
+
+        // the byte after a field says which delimiter ended it
+        //
+        const struct string_view tsv = SV_LITERAL("x\ty\nz\tw\n");
+        TEST_ASSERT(sv_split_into(tsv, SV_LITERAL("\t\n"), fields, 8) == 5);
+        TEST_ASSERT(sv_equal(fields[1], SV_LITERAL("y")) && fields[1].data[1] == '\n');
+        TEST_ASSERT(sv_equal(fields[2], SV_LITERAL("z")) && fields[2].data[1] == '\t');
+        TEST_ASSERT(sv_equal(fields[4], SV_LITERAL("")));
+
+        // a short array still gets the total
+        //
+        TEST_ASSERT(sv_split_into(tsv, SV_LITERAL("\t\n"), fields, 2) == 5);
+        TEST_ASSERT(sv_split_into(tsv, SV_LITERAL("\t\n"), NULL, 0) == 5);
+        TEST_ASSERT(sv_split_into(SV_LITERAL(""), SV_LITERAL(","), fields, 8) == 1);
+        TEST_ASSERT(fields[0].length == 0);
+        TEST_ASSERT(sv_split_into(SV_LITERAL("a,b"), SV_LITERAL(""), fields, 8) == 1);
+        TEST_ASSERT(sv_equal(fields[0], SV_LITERAL("a,b")));
+
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 4096);
+        size_t              count;
+        struct string_view* split =
+            sv_split(SV_LITERAL("1 2 3"), SV_LITERAL(" "), &count, &arena, NULL);
+        TEST_ASSERT(count == 3);
+        TEST_ASSERT(sv_equal(split[2], SV_LITERAL("3")));
+        allocator_destroy(&arena);
+    }
+
+    // splitting agrees with a loop of sv_lchop_by_delim, with each size of delimiter set
+    //
+    {
+        static char        buffer[600];
+        static const char  delimiters[] = ",;\t\n|:#@ !";
+        struct string_view fields[600];
+        uint64_t           random_state = 0x9E3779B97F4A7C15ull;
+        for (size_t iteration = 0; iteration < 5000; iteration++) {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            const struct string_view delimiter_set = {
+                .length = 1 + random_state % (sizeof delimiters - 1),
+                .data   = delimiters,
+            };
+            const struct string_view str = {.length = (random_state >> 8) % 590, .data = buffer};
+            for (size_t i = 0; i < str.length; i++) {
+                random_state ^= random_state << 13;
+                random_state ^= random_state >> 7;
+                random_state ^= random_state << 17;
+                const size_t delimiter = (random_state >> 4) % (sizeof delimiters - 1);
+                buffer[i]              = (random_state % 4) ? 'a' : delimiters[delimiter];
+            }
+
+            const size_t count = sv_split_into(str, delimiter_set, fields, 600);
+            size_t       index = 0;
+            size_t       start = 0;
+            for (size_t i = 0; i <= str.length; i++) {
+                const struct string_view set = delimiter_set;
+                if (i < str.length && !memchr(set.data, str.data[i], set.length)) {
+                    continue;
+                }
+                TEST_ASSERT(index < count);
+                TEST_ASSERT(fields[index].data == str.data + start);
+                TEST_ASSERT(fields[index].length == i - start);
+                index++;
+                start = i + 1;
+            }
+            TEST_ASSERT(index == count);
+        }
+        for (size_t iteration = 0; iteration < 100; iteration++) {
+            struct string_view view = {.length = iteration * 5, .data = buffer};
+            for (size_t i = 0; i < view.length; i++) {
+                buffer[i] = (i % 7 == 3) ? ',' : 'b';
+            }
+            const size_t count = sv_split_into(view, SV_LITERAL(","), fields, 600);
+            for (size_t i = 0; i + 1 < count; i++) {
+                TEST_ASSERT(sv_equal(fields[i], sv_lchop_by_delim(&view, ',')));
+            }
+            TEST_ASSERT(sv_equal(fields[count - 1], view));
+        }
+    }
+
+    // needle sets
+    //
+    {
+        const struct string_view patterns[] = {
+            SV_LITERAL("he"),
+            SV_LITERAL("she"),
+            SV_LITERAL("his"),
+            SV_LITERAL("hers"),
+            SV_LITERAL(""),
+        };
+        StringViewNeedleSet set = sv_needle_set_create(patterns, 5, NULL, NULL);
+
+        struct match_test test = {0};
+        TEST_ASSERT(sv_needle_set_scan(set, SV_LITERAL("ushers"), match_test_collect, &test) == 3);
+        TEST_ASSERT(test.matches[0].pattern == 1 && test.matches[0].offset == 1);
+        TEST_ASSERT(test.matches[1].pattern == 0 && test.matches[1].offset == 2);
+        TEST_ASSERT(test.matches[2].pattern == 3 && test.matches[2].offset == 2);
+
+        test = (struct match_test){.stop_after = 1};
+        TEST_ASSERT(sv_needle_set_scan(set, SV_LITERAL("ushers"), match_test_collect, &test) == 1);
+
+        TEST_ASSERT(sv_needle_set_matches(set, SV_LITERAL("this")));
+        TEST_ASSERT(!sv_needle_set_matches(set, SV_LITERAL("hxs sh")));
+        TEST_ASSERT(!sv_needle_set_matches(set, SV_LITERAL("")));
+        sv_needle_set_free(set);
+
+        // no patterns matches nothing
+        //
+        set = sv_needle_set_create(NULL, 0, NULL, NULL);
+        TEST_ASSERT(!sv_needle_set_matches(set, SV_LITERAL("anything")));
+        sv_needle_set_free(set);
+
+        // every byte value used, so no byte is left to share the absent class
+        //
+        char every_byte[256];
+        for (size_t i = 0; i < sizeof every_byte; i++) {
+            every_byte[i] = (char)i;
+        }
+        const struct string_view every_byte_patterns[] = {
+            {.data = every_byte, .length = sizeof every_byte},
+            SV_LITERAL("\xff\xff"),
+        };
+        const struct string_view zeros = {.data = "\0\0", .length = 2};
+        set = sv_needle_set_create(every_byte_patterns, 2, NULL, NULL);
+        TEST_ASSERT(!sv_needle_set_matches(set, zeros));
+        TEST_ASSERT(sv_needle_set_matches(set, SV_LITERAL("a\xff\xff")));
+        TEST_ASSERT(sv_needle_set_matches(set, every_byte_patterns[0]));
+        test = (struct match_test){0};
+        TEST_ASSERT(
+            sv_needle_set_scan(set, every_byte_patterns[0], match_test_collect, &test) == 1
+        );
+        TEST_ASSERT(test.matches[0].pattern == 0 && test.matches[0].offset == 0);
+        sv_needle_set_free(set);
+    }
+
+    // a needle set agrees with sv_contains on every pattern
+    //
+    {
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 64 * 1024);
+
+        char               pattern_data[64][4];
+        struct string_view patterns[64];
+        uint64_t           random_state = 0x2545F4914F6CDD1Dull;
+        for (size_t i = 0; i < 64; i++) {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            patterns[i].length = 1 + random_state % 4;
+            for (size_t j = 0; j < patterns[i].length; j++) {
+                pattern_data[i][j] = "abcd"[(random_state >> (8 + 2 * j)) % 4];
+            }
+            patterns[i].data = pattern_data[i];
+        }
+        StringViewNeedleSet set = sv_needle_set_create(patterns, 64, &arena, NULL);
+
+        char haystack_data[24];
+        for (size_t iteration = 0; iteration < 2000; iteration++) {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            const struct string_view haystack = {
+                .length = random_state % 24,
+                .data   = haystack_data,
+            };
+            for (size_t i = 0; i < haystack.length; i++) {
+                haystack_data[i] = "abcdx"[(random_state >> (i * 2 + 5)) % 5];
+            }
+
+            bool   any      = false;
+            size_t expected = 0;
+            for (size_t i = 0; i < 64; i++) {
+                any |= sv_contains(haystack, patterns[i]);
+                for (size_t offset = 0; offset + patterns[i].length <= haystack.length; offset++) {
+                    expected +=
+                        memcmp(haystack.data + offset, patterns[i].data, patterns[i].length) == 0;
+                }
+            }
+            struct match_test test = {0};
+            TEST_ASSERT(sv_needle_set_matches(set, haystack) == any);
+            TEST_ASSERT(sv_needle_set_scan(set, haystack, match_test_collect, &test) == expected);
+        }
+        sv_needle_set_free(set);
+        allocator_destroy(&arena);
+    }
+
+    // integer parsing
+    //
+    {
+        struct sv_error    error = {0};
+        struct string_view str   = SV_LITERAL("-9223372036854775808 rest");
+        int64_t            i64   = 0;
+        TEST_ASSERT(sv_parse_i64(&str, &i64, &error) == 20);
+        TEST_ASSERT(i64 == INT64_MIN);
+        TEST_ASSERT(sv_equal(str, SV_LITERAL(" rest")));
+
+        str = SV_LITERAL("+9223372036854775807");
+        TEST_ASSERT(sv_parse_i64(&str, &i64, &error) == 20);
+        TEST_ASSERT(i64 == INT64_MAX && str.length == 0);
+
+        str = SV_LITERAL("0000000000000000000000000012");
+        TEST_ASSERT(sv_parse_i64(&str, &i64, &error) == 28);
+        TEST_ASSERT(i64 == 12);
+
+        str = SV_LITERAL("9223372036854775808");
+        TEST_ASSERT(sv_parse_i64(&str, &i64, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_OUT_OF_RANGE);
+        TEST_ASSERT(str.length == 19);
+
+        str = SV_LITERAL("-9223372036854775809");
+        TEST_ASSERT(sv_parse_i64(&str, &i64, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_OUT_OF_RANGE);
+
+        uint64_t u64 = 0;
+        str          = SV_LITERAL("18446744073709551615,");
+        TEST_ASSERT(sv_parse_u64(&str, &u64, &error) == 20);
+        TEST_ASSERT(u64 == UINT64_MAX);
+        TEST_ASSERT(sv_equal(str, SV_LITERAL(",")));
+
+        str = SV_LITERAL("18446744073709551616");
+        TEST_ASSERT(sv_parse_u64(&str, &u64, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_OUT_OF_RANGE);
+
+        str = SV_LITERAL("184467440737095516150");
+        TEST_ASSERT(sv_parse_u64(&str, &u64, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_OUT_OF_RANGE);
+
+        str = SV_LITERAL("-1");
+        TEST_ASSERT(sv_parse_u64(&str, &u64, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_OUT_OF_RANGE);
+
+        // a sign without digits is invalid rather than out of range, signed or not
+        //
+        const struct string_view invalid[] = {
+            SV_LITERAL(""),
+            SV_LITERAL("-"),
+            SV_LITERAL("-abc"),
+            SV_LITERAL("+x"),
+            SV_LITERAL(" 1"),
+            SV_LITERAL("x1"),
+        };
+        for (size_t i = 0; i < sizeof invalid / sizeof *invalid; i++) {
+            str = invalid[i];
+            TEST_ASSERT(sv_parse_i64(&str, &i64, &error) == 0);
+            TEST_ASSERT(error.code == SV_CODE_INVALID_NUMBER);
+            TEST_ASSERT(sv_equal(str, invalid[i]));
+            TEST_ASSERT(sv_parse_u64(&str, &u64, &error) == 0);
+            TEST_ASSERT(error.code == SV_CODE_INVALID_NUMBER);
+            TEST_ASSERT(sv_equal(str, invalid[i]));
+        }
+
+        // the eight digit path handles every position a non digit can interrupt it
+        //
+        char digits[32];
+        for (size_t length = 1; length <= 19; length++) {
+            for (size_t i = 0; i < length; i++) {
+                digits[i] = (char)('1' + i % 9);
+            }
+            digits[length] = 'x';
+            str            = (struct string_view){.length = length + 1, .data = digits};
+            digits[length + 1] = '\0';
+            TEST_ASSERT(sv_parse_u64(&str, &u64, &error) == length);
+            TEST_ASSERT(u64 == strtoull(digits, NULL, 10));
+        }
+    }
+
+    // float parsing matches strtod bit for bit
+    //
+    {
+        struct sv_error error = {0};
+        const char*     cases[] = {
+            "0",
+            "-0",
+            "1",
+            "1.5",
+            ".5",
+            "5.",
+            "1e10",
+            "1E-10",
+            "123.456e+3",
+            "0.000000000000000000000000000001",
+            "1e308",
+            "1.7976931348623157e308",
+            "2.2250738585072014e-308",
+            "2.2250738585072011e-308",
+            "4.9406564584124654e-324",
+            "2.4703282292062328e-324",
+            "2.4703282292062327e-324",
+            "1e-400",
+            "9007199254740993",
+            "9007199254740992.5",
+            "123456789012345678901234567890",
+            "0.1000000000000000055511151231257827021181583404541015625",
+            "0.1000000000000000055511151231257827021181583404541015626",
+            "7.038531e-26",
+            "3.14159265358979323846264338327950288",
+            "1448997445238699",
+            "0e99999999",
+            "00000000000000000000000000000001.00000000000000000000000000000",
+        };
+        for (size_t i = 0; i < sizeof cases / sizeof *cases; i++) {
+            struct string_view str   = SV_CSTR(cases[i]);
+            double             value = 0;
+            TEST_ASSERT(sv_parse_f64(&str, &value, &error) == strlen(cases[i]));
+            const double expected = strtod(cases[i], NULL);
+            TEST_ASSERT(memcmp(&value, &expected, sizeof value) == 0);
+        }
+
+        struct string_view str   = SV_LITERAL("1.25e,");
+        double             value = 0;
+        TEST_ASSERT(sv_parse_f64(&str, &value, &error) == 4);
+        TEST_ASSERT(value == 1.25 && sv_equal(str, SV_LITERAL("e,")));
+
+        str = SV_LITERAL("-Infinity");
+        TEST_ASSERT(sv_parse_f64(&str, &value, &error) == 9 && value < 0 && isinf(value));
+        str = SV_LITERAL("nan");
+        TEST_ASSERT(sv_parse_f64(&str, &value, &error) == 3 && value != value);
+
+        str = SV_LITERAL("1e309");
+        TEST_ASSERT(sv_parse_f64(&str, &value, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_OUT_OF_RANGE);
+
+        str = SV_LITERAL(".e1");
+        TEST_ASSERT(sv_parse_f64(&str, &value, &error) == 0);
+        TEST_ASSERT(error.code == SV_CODE_INVALID_NUMBER);
+
+        // just above a halfway point by a digit far past any stack buffer, only an exact parse
+        // rounds this up
+        //
+        char long_number[2048];
+        memset(long_number, '0', sizeof long_number);
+        memcpy(long_number, "9007199254740993.", 17);
+        long_number[sizeof long_number - 1] = '1';
+        str = (struct string_view){.data = long_number, .length = sizeof long_number};
+        TEST_ASSERT(sv_parse_f64(&str, &value, &error) == sizeof long_number);
+        TEST_ASSERT(value == 9007199254740994.0 && str.length == 0);
+
+        uint64_t random_state = 0x9E3779B97F4A7C15ull;
+        char     buffer[64];
+        for (size_t iteration = 0; iteration < 200000; iteration++) {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            uint64_t     bits = random_state;
+            const size_t mantissa_digits = 1 + bits % 24;
+            bits /= 24;
+            size_t length = 0;
+            if (bits & 1) buffer[length++] = '-';
+            bits >>= 1;
+            const size_t point = bits % (mantissa_digits + 1);
+            bits /= mantissa_digits + 1;
+            for (size_t i = 0; i < mantissa_digits; i++) {
+                if (i == point) buffer[length++] = '.';
+                random_state ^= random_state << 13;
+                random_state ^= random_state >> 7;
+                random_state ^= random_state << 17;
+                buffer[length++] = (char)('0' + random_state % 10);
+            }
+            if (bits & 1) {
+                length += (size_t)snprintf(
+                    buffer + length, sizeof buffer - length, "e%d", (int)(bits % 661) - 340
+                );
+            }
+            buffer[length] = '\0';
+
+            const double expected = strtod(buffer, NULL);
+            if (isinf(expected)) continue;
+            struct string_view str   = {.length = length, .data = buffer};
+            double             value = 0;
+            TEST_ASSERT(sv_parse_f64(&str, &value, &error) == length);
+            TEST_ASSERT(memcmp(&value, &expected, sizeof value) == 0);
+        }
+    }
+
+    // hashing
+    //
+    {
+        char buffer[128];
+        for (size_t i = 0; i < sizeof buffer; i++) {
+            buffer[i] = (char)('a' + i % 26);
+        }
+        // every length takes the path it would for any other content
+        //
+        for (size_t length = 0; length <= 100; length++) {
+            char copy[128];
+            memcpy(copy, buffer, length);
+            const struct string_view original = {.length = length, .data = buffer};
+            const struct string_view same     = {.length = length, .data = copy};
+            TEST_ASSERT(sv_hash(original) == sv_hash(same));
+            TEST_ASSERT(sv_hashed_equal(sv_hash_view(original), sv_hash_view(same)));
+            if (length) {
+                copy[length - 1] ^= 1;
+                TEST_ASSERT(sv_hash(original) != sv_hash(same));
+                TEST_ASSERT(!sv_hashed_equal(sv_hash_view(original), sv_hash_view(same)));
+                copy[0] ^= 2;
+                TEST_ASSERT(sv_hash(original) != sv_hash(same));
+            }
+            const struct string_view longer = {.length = length + 1, .data = buffer};
+            TEST_ASSERT(sv_hash(original) != sv_hash(longer));
+        }
+        TEST_ASSERT(sv_hash((struct string_view){0}) == sv_hash(SV_LITERAL("")));
+    }
+
+    // interning
+    //
+    {
+        StringViewInternTable table = sv_intern_table_create(NULL, NULL);
+
+        const struct sv_hashed* hello = sv_intern(table, SV_LITERAL("hello"), NULL);
+        TEST_ASSERT(sv_equal(hello->view, SV_LITERAL("hello")));
+        TEST_ASSERT(hello->view.data[hello->view.length] == '\0');
+        TEST_ASSERT(hello->hash == sv_hash(SV_LITERAL("hello")));
+
+        char copy[] = "hello";
+        TEST_ASSERT(sv_intern(table, SV_CSTR(copy), NULL) == hello);
+        TEST_ASSERT(sv_intern(table, SV_LITERAL("hell"), NULL) != hello);
+        TEST_ASSERT(sv_intern_lookup(table, sv_hash_view(SV_LITERAL("hello"))) == hello);
+        TEST_ASSERT(!sv_intern_lookup(table, sv_hash_view(SV_LITERAL("world"))));
+        TEST_ASSERT(sv_intern_table_count(table) == 2);
+
+        // the empty string and strings with embedded nulls are interned like any other
+        //
+        const struct sv_hashed* empty = sv_intern(table, (struct string_view){0}, NULL);
+        TEST_ASSERT(empty->view.length == 0 && empty->view.data);
+        TEST_ASSERT(sv_intern(table, SV_LITERAL(""), NULL) == empty);
+        const struct sv_hashed* nulls = sv_intern(table, SV_LITERAL("a\0b"), NULL);
+        TEST_ASSERT(nulls != sv_intern(table, SV_LITERAL("a\0c"), NULL));
+        TEST_ASSERT(nulls == sv_intern(table, SV_LITERAL("a\0b"), NULL));
+
+        // entries keep their addresses as the table grows
+        //
+        const struct sv_hashed* entries[5000];
+        char                    name[32];
+        for (size_t i = 0; i < 5000; i++) {
+            snprintf(name, sizeof name, "identifier_%zu", i);
+            entries[i] = sv_intern(table, SV_CSTR(name), NULL);
+        }
+        TEST_ASSERT(sv_intern_table_count(table) == 5005);
+        TEST_ASSERT(sv_intern(table, SV_LITERAL("hello"), NULL) == hello);
+        for (size_t i = 0; i < 5000; i++) {
+            snprintf(name, sizeof name, "identifier_%zu", i);
+            TEST_ASSERT(sv_intern(table, SV_CSTR(name), NULL) == entries[i]);
+            TEST_ASSERT(sv_equal(entries[i]->view, SV_CSTR(name)));
+        }
+        TEST_ASSERT(sv_intern_table_count(table) == 5005);
+        sv_intern_table_free(table);
+
+        // the slots come from the given allocator
+        //
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 4096);
+        table = sv_intern_table_create(&arena, NULL);
+        for (size_t i = 0; i < 1000; i++) {
+            snprintf(name, sizeof name, "%zu", i % 100);
+            const struct sv_hashed* entry = sv_intern(table, SV_CSTR(name), NULL);
+            TEST_ASSERT(sv_equal(entry->view, SV_CSTR(name)));
+        }
+        TEST_ASSERT(sv_intern_table_count(table) == 100);
+        sv_intern_table_free(table);
+        allocator_destroy(&arena);
+    }
+
+    // string builder
+    //
+    {
+        struct sv_builder builder = {0};
+        TEST_ASSERT(sv_equal(sv_builder_view(&builder), SV_LITERAL("")));
+        TEST_ASSERT(*sv_builder_view(&builder).data == '\0');
+
+        sv_builder_append(&builder, SV_LITERAL("hello"), NULL);
+        sv_builder_append_char(&builder, ',', NULL);
+        sv_builder_appendf(&builder, NULL, " %s %d", "world", 42);
+        TEST_ASSERT(sv_equal(sv_builder_view(&builder), SV_LITERAL("hello, world 42")));
+        TEST_ASSERT(strcmp(builder.data, "hello, world 42") == 0);
+
+        // a formatted append bigger than the spare capacity
+        //
+        sv_builder_appendf(&builder, NULL, "%0200d", 7);
+        TEST_ASSERT(builder.length == 215 && builder.data[214] == '7' && builder.data[16] == '0');
+
+        // a format vsnprintf refuses (a width past INT_MAX) leaves the builder as it was
+        //
+        char too_wide[32];
+        snprintf(too_wide, sizeof too_wide, "%%%lud", 2147483648ul);
+        struct sv_error format_error = {0};
+        TEST_ASSERT(!sv_builder_appendf(&builder, &format_error, too_wide, 7));
+        TEST_ASSERT(format_error.code == SV_CODE_INVALID_FORMAT);
+        TEST_ASSERT(builder.length == 215 && builder.data[215] == '\0');
+
+        sv_builder_clear(&builder);
+        TEST_ASSERT(sv_builder_view(&builder).length == 0 && builder.data[0] == '\0');
+        for (size_t i = 0; i < 10000; i++) {
+            sv_builder_append_char(&builder, (char)('a' + i % 26), NULL);
+        }
+        TEST_ASSERT(builder.length == 10000 && builder.data[10000] == '\0');
+        TEST_ASSERT(builder.data[9999] == 'a' + 9999 % 26);
+        sv_builder_free(&builder);
+        TEST_ASSERT(!builder.data && !builder.length);
+
+        // the only allocation in an arena grows without moving
+        //
+        struct allocator arena;
+        ARENA_ALLOCATOR(arena, 64 * 1024);
+        builder = (struct sv_builder){.allocator = &arena};
+        sv_builder_append(&builder, SV_LITERAL("x"), NULL);
+        const char* first = builder.data;
+        for (size_t i = 0; i < 1000; i++) {
+            sv_builder_append(&builder, SV_LITERAL("0123456789"), NULL);
+        }
+        TEST_ASSERT(builder.data == first && builder.length == 10001);
+        sv_builder_free(&builder);
+        allocator_destroy(&arena);
+        builder = (struct sv_builder){0};
+
+        const int64_t integers[] = {
+            0, 1, -1, 9, 10, 99, 100, 12345, -987654321, INT64_MAX, INT64_MIN,
+        };
+        char          expected[32];
+        for (size_t i = 0; i < sizeof integers / sizeof *integers; i++) {
+            sv_builder_clear(&builder);
+            sv_builder_append_i64(&builder, integers[i], NULL);
+            snprintf(expected, sizeof expected, "%lld", (long long)integers[i]);
+            TEST_ASSERT(strcmp(builder.data, expected) == 0);
+        }
+        for (uint64_t nines = 9; nines < UINT64_MAX / 10; nines = nines * 10 + 9) {
+            sv_builder_clear(&builder);
+            sv_builder_append_u64(&builder, nines, NULL);
+            snprintf(expected, sizeof expected, "%llu", (unsigned long long)nines);
+            TEST_ASSERT(strcmp(builder.data, expected) == 0);
+        }
+        sv_builder_clear(&builder);
+        sv_builder_append_u64(&builder, UINT64_MAX, NULL);
+        TEST_ASSERT(strcmp(builder.data, "18446744073709551615") == 0);
+
+        const struct {
+            double      value;
+            const char* text;
+        } floats[] = {
+            {0.0, "0"},
+            {-0.0, "-0"},
+            {1.0, "1"},
+            {-1.5, "-1.5"},
+            {0.1, "0.1"},
+            {0.3, "0.3"},
+            {0.1 + 0.2, "0.30000000000000004"},
+            {100.0, "100"},
+            {123.456, "123.456"},
+            {1e20, "100000000000000000000"},
+            {1e21, "1e+21"},
+            {0.000001, "0.000001"},
+            {1.5e-7, "1.5e-7"},
+            {5e-324, "5e-324"},
+            {2.2250738585072014e-308, "2.2250738585072014e-308"},
+            {1.7976931348623157e308, "1.7976931348623157e+308"},
+            {9007199254740993.0, "9007199254740992"},
+            {HUGE_VAL, "inf"},
+            {-HUGE_VAL, "-inf"},
+            {NAN, "nan"},
+        };
+        for (size_t i = 0; i < sizeof floats / sizeof *floats; i++) {
+            sv_builder_clear(&builder);
+            sv_builder_append_f64(&builder, floats[i].value, NULL);
+            TEST_ASSERT(strcmp(builder.data, floats[i].text) == 0);
+        }
+
+        // random doubles come back from the parser unchanged, with as few digits as printf
+        // needs to do the same
+        //
+        uint64_t random_state = 0x9E3779B97F4A7C15ull;
+        for (size_t iteration = 0; iteration < 100000; iteration++) {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            double value;
+            memcpy(&value, &random_state, sizeof value);
+            if (isnan(value) || isinf(value)) continue;
+
+            sv_builder_clear(&builder);
+            sv_builder_append_f64(&builder, value, NULL);
+            struct string_view text   = sv_builder_view(&builder);
+            double             parsed = 0;
+            TEST_ASSERT(sv_parse_f64(&text, &parsed, NULL) == builder.length);
+            TEST_ASSERT(memcmp(&parsed, &value, sizeof value) == 0);
+
+            // significant digits, without leading or trailing zeros
+            //
+            char   significant[32];
+            size_t digits = 0;
+            for (size_t i = 0; i < builder.length && builder.data[i] != 'e'; i++) {
+                if (isdigit((unsigned char)builder.data[i]) && (digits || builder.data[i] != '0')) {
+                    significant[digits++] = builder.data[i];
+                }
+            }
+            while (digits && significant[digits - 1] == '0') {
+                digits--;
+            }
+            int precision = 1;
+            for (; precision < 17; precision++) {
+                snprintf(expected, sizeof expected, "%.*e", precision - 1, value);
+                if (strtod(expected, NULL) == value) break;
+            }
+            TEST_ASSERT(digits == (size_t)precision);
+        }
+        sv_builder_free(&builder);
+    }
+
     printf("%s tests passed\n", __FILE__);
 }
 